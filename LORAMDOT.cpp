@@ -15,6 +15,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "LoRamDot.h"
+#include "LoRamDotAirtime.h"
 
 // LoRa Constructor
 // Wrapper library for the Multitech mDot LoRaWan module with version 2.0.x firmware.
@@ -35,29 +36,953 @@ void LoRamDot::begin(Stream &serial)
 	_Serial = &serial;
 }
 
-// Set Timeout on Serial Stream.
+// Set Timeout on Serial Stream. The timeout is used for every command, so the timeout profiles are turned off.
 // 0 disables the timeout (no timeout - WARNING: May loop forever).
-// -1 disables the timeout and the response is not retrieved. 
 void LoRamDot::setTimeout(unsigned long timeout)
 {
 	_timeout = timeout;
+	_timeoutProfiles = false;
 	_Serial->setTimeout(_timeout);
 }
 
+// Times each command by its class (TIMEOUT_CLASS_*) rather than with the single setTimeout() timeout. This is the default,
+// so quick commands time out after TIMEOUT_QUICK rather than the single 15 second timeout used before the profiles.
+// The radio classes are derived from the receive windows (JoinDelay(), ReceiveDelay()), the join retries and acknowledgment
+// attempts (JoinRetries(), RequireAcknowledgment()) and the time on air at the current data rate.
+// adaptive: Also tightens each class's timeout to the smoothed latency plus four smoothed deviations (as TCP times its
+// retransmissions) once TIMEOUT_ADAPTIVE_SAMPLES responses have been seen. A timeout doubles the learned timeout.
+// The learned timeout never exceeds the derived one.
+void LoRamDot::setTimeoutProfiles(boolean enabled, boolean adaptive)
+{
+	_timeoutProfiles = enabled;
+	_timeoutAdaptive = adaptive;
+}
+
+// Returns the timeout in milliseconds used for commands of the class (TIMEOUT_CLASS_*).
+// This is the setTimeout() timeout while the timeout profiles are off.
+unsigned long LoRamDot::CommandTimeout(byte timeoutClass)
+{
+	if (!_timeoutProfiles)
+		return _timeout;
+
+	if (timeoutClass >= TIMEOUT_CLASS_COUNT)
+		timeoutClass = TIMEOUT_CLASS_QUICK;
+
+	unsigned long l_timeout = ProfileTimeout(timeoutClass);
+
+	if (_timeoutAdaptive && _latencySamples[timeoutClass] >= TIMEOUT_ADAPTIVE_SAMPLES)
+	{
+		unsigned long l_mean = _latencyMean[timeoutClass] >> 3;
+		unsigned long l_spread = _latencyDeviation[timeoutClass];
+		unsigned long l_learned = l_mean + ((l_spread > TIMEOUT_ADAPTIVE_MINIMUM) ? l_spread : TIMEOUT_ADAPTIVE_MINIMUM);
+
+		if (l_learned < l_timeout)
+			l_timeout = l_learned;
+	}
+
+	return l_timeout;
+}
+
+// Returns the timeout of a class derived from the receive windows and retries.
+unsigned long LoRamDot::ProfileTimeout(byte timeoutClass)
+{
+	// The slowest data rate is assumed while the data rate is unknown
+	byte l_dataRate = (_dataRate == DATA_RATE_UNKNOWN) ? 0 : _dataRate;
+	byte l_receiveDelay = (_receiveDelay == CONFIG_UNSET) ? RECEIVE_DELAY_DEFAULT : _receiveDelay;
+
+	// From the end of the uplink to the close of the second receive window (opened a second after the first)
+	unsigned long l_receive = (l_receiveDelay + 1) * 1000UL + TIMEOUT_RECEIVE_WINDOW + TIMEOUT_MARGIN;
+
+	switch (timeoutClass)
+	{
+	case TIMEOUT_CLASS_REPORT:
+		return TIMEOUT_REPORT;
+
+	case TIMEOUT_CLASS_STORE:
+		return TIMEOUT_STORE;
+
+	case TIMEOUT_CLASS_SEND:
+	{
+		// Confirmed uplinks are sent up to ackAttempts times, each waiting for the acknowledgment timeout
+		byte l_acks = (_shadow.ackAttempts == CONFIG_UNSET) ? 0 : _shadow.ackAttempts;
+		unsigned long l_attempt = LoRaWANTimeOnAir(_frequencyBand, l_dataRate, MaxPayload(), _codingRate) + l_receive;
+
+		return (l_acks == 0) ? l_attempt : l_acks * (l_attempt + TIMEOUT_ACK);
+	}
+
+	case TIMEOUT_CLASS_LINK:
+		return LoRaWANTimeOnAir(_frequencyBand, l_dataRate, 0, _codingRate) + l_receive;
+
+	case TIMEOUT_CLASS_JOIN:
+	{
+		byte l_attempts = (_shadow.joinRetries == CONFIG_UNSET) ? JOIN_RETRIES_DEFAULT : _shadow.joinRetries;
+		byte l_joinDelay = (_joinDelay == CONFIG_UNSET) ? JOIN_DELAY_DEFAULT : _joinDelay;
+
+		// The join request (23 bytes on air, 10 beyond the uplink overhead) is timed at the slowest data rate
+		unsigned long l_attempt = LoRaWANTimeOnAir(_frequencyBand, 0, 10, _codingRate)
+			+ (l_joinDelay + 1) * 1000UL + TIMEOUT_RECEIVE_WINDOW + TIMEOUT_MARGIN;
+
+		return ((l_attempts == 0) ? 1 : l_attempts) * l_attempt;
+	}
+
+	default:
+		return TIMEOUT_QUICK;
+	}
+}
+
+// Adds the current command's latency to its class's smoothed latency and deviation.
+// A timeout is not a latency. It doubles the learned timeout instead, up to the derived timeout.
+void LoRamDot::LearnLatency(int statusId)
+{
+	byte l_class = _commandClass;
+
+	if (statusId == COMMAND_STATUS_ID_TIMED_OUT)
+	{
+		// Taking the timeout as both the mean and four deviations makes the next timeout twice as long
+		if (_latencySamples[l_class] >= TIMEOUT_ADAPTIVE_SAMPLES)
+		{
+			uint32_t l_timeout = CommandTimeout(l_class);
+
+			_latencyMean[l_class] = l_timeout << 3;
+			_latencyDeviation[l_class] = l_timeout;
+		}
+
+		return;
+	}
+
+	unsigned long l_latency = millis() - _commandStart;
+
+	if (_latencySamples[l_class] == 0)
+	{
+		// The first latency is the mean, with half of it as the deviation
+		_latencyMean[l_class] = l_latency << 3;
+		_latencyDeviation[l_class] = l_latency << 1;
+	}
+	else
+	{
+		// mean += (latency - mean) / 8, deviation += (|latency - mean| - deviation) / 4
+		long l_error = (long)l_latency - (long)(_latencyMean[l_class] >> 3);
+
+		_latencyMean[l_class] = (uint32_t)((long)_latencyMean[l_class] + l_error);
+		_latencyDeviation[l_class] += ((l_error < 0) ? -l_error : l_error) - (_latencyDeviation[l_class] >> 2);
+	}
+
+	if (_latencySamples[l_class] < 255)
+		_latencySamples[l_class]++;
+}
+
+// Returns the number of characters of the command name (up to any '=' or '?').
+static int CommandNameLength(const char *command)
+{
+	int l_length = 0;
+
+	while (command[l_length] != '\0' && command[l_length] != '=' && command[l_length] != '?')
+		l_length++;
+
+	return l_length;
+}
+
+// Returns true if the command name of length characters is name.
+static boolean CommandIs(const char *command, int length, const char *name)
+{
+	return (int)strlen(name) == length && strncmp(command, name, length) == 0;
+}
+
+// Returns the timeout class (TIMEOUT_CLASS_*) of a command, e.g. TIMEOUT_CLASS_SEND for "AT+SEND=...".
+byte LoRamDot::TimeoutClass(const char *command)
+{
+	int l_length = CommandNameLength(command);
+
+	if (CommandIs(command, l_length, "AT+SEND") || CommandIs(command, l_length, "AT+SENDB"))
+		return TIMEOUT_CLASS_SEND;
+	if (CommandIs(command, l_length, "AT+JOIN"))
+		return TIMEOUT_CLASS_JOIN;
+	if (CommandIs(command, l_length, "AT+PING") || CommandIs(command, l_length, "AT+NLC"))
+		return TIMEOUT_CLASS_LINK;
+	if (CommandIs(command, l_length, "AT&W") || CommandIs(command, l_length, "AT+SS") || CommandIs(command, l_length, "ATZ"))
+		return TIMEOUT_CLASS_STORE;
+	if (CommandIs(command, l_length, "AT&V") || CommandIs(command, l_length, "AT&S") || CommandIs(command, l_length, "ATI"))
+		return TIMEOUT_CLASS_REPORT;
+
+	return TIMEOUT_CLASS_QUICK;
+}
+
+// Sets the frequency band (FREQUENCY_BAND_US_AU or FREQUENCY_BAND_EU) used to look up payload sizes.
+// The band is also learned from the FrequencyBand() response.
+void LoRamDot::setFrequencyBand(byte band)
+{
+	_frequencyBand = band;
+}
+
 // Private Methods //////////////////////////////////////////////////////////////
 
+// Maximum payload (bytes) per data rate
+static const byte MAX_PAYLOAD_US_AU[] = { 11, 53, 129, 242, 242 };				// DR0-DR4
+static const byte MAX_PAYLOAD_EU[] = { 51, 51, 51, 115, 242, 242, 242, 50 };	// DR0-DR7
+
+// Returns the data rate in text such as "DR2", "DR2 - SF8BW125", "SF_8" or "8" (spreading factor).
+// Spreading factors are converted to the data rate of the frequency band. Returns DATA_RATE_UNKNOWN if none is found.
+static byte ParseDataRate(const char *text, byte band)
+{
+	for (const char *l_text = text; *l_text != '\0'; l_text++)
+	{
+		if (l_text[0] == 'D' && l_text[1] == 'R' && isDigit(l_text[2]))
+			return (byte)atoi(l_text + 2);
+	}
+
+	// Spreading factor (SF_7-SF_12 or 7-12)
+	const char *l_sf = strstr(text, "SF");
+
+	if (l_sf != NULL)
+		l_sf += (l_sf[2] == '_') ? 3 : 2;
+	else if (isDigit(text[0]))
+		l_sf = text;
+	else
+		return DATA_RATE_UNKNOWN;
+
+	int l_spreadingFactor = atoi(l_sf);
+
+	if (band == FREQUENCY_BAND_EU && l_spreadingFactor >= 7 && l_spreadingFactor <= 12)
+		return 12 - l_spreadingFactor;
+	if (band == FREQUENCY_BAND_US_AU && l_spreadingFactor >= 7 && l_spreadingFactor <= 10)
+		return 10 - l_spreadingFactor;
+
+	return DATA_RATE_UNKNOWN;
+}
+
+// Upper case hex digit for each nibble value
+static const char HEX_DIGITS[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+
+// Prints the bytes as two hex digits each (leading zeros kept).
+// The digits are staged in a small stack buffer so the stream receives a few bulk writes instead of one call per digit.
+static size_t PrintHex(Print &out, const uint8_t *data, size_t length)
+{
+	char l_hex[32];
+	size_t l_written = 0;
+
+	while (length > 0)
+	{
+		size_t l_count = 0;
+
+		while (length > 0 && l_count < sizeof(l_hex))
+		{
+			l_hex[l_count++] = HEX_DIGITS[*data >> 4];
+			l_hex[l_count++] = HEX_DIGITS[*data & 0x0F];
+			data++;
+			length--;
+		}
+
+		l_written += out.write((const uint8_t *)l_hex, l_count);
+	}
+
+	return l_written;
+}
+
+// Print adapter that hex encodes every byte printed to it onto another Print.
+class HexEncoder : public Print
+{
+public:
+	HexEncoder(Print &out) : _out(out) {}
+
+	size_t write(uint8_t value)
+	{
+		return (PrintHex(_out, &value, 1) == 2) ? 1 : 0;
+	}
+
+	size_t write(const uint8_t *buffer, size_t size)
+	{
+		return PrintHex(_out, buffer, size) / 2;
+	}
+
+private:
+	Print &_out;
+};
+
+// Print adapter that only counts the bytes printed to it.
+class ByteCounter : public Print
+{
+public:
+	size_t count = 0;
+
+	size_t write(uint8_t)
+	{
+		count++;
+		return 1;
+	}
+
+	size_t write(const uint8_t *, size_t size)
+	{
+		count += size;
+		return size;
+	}
+};
+
+// Response terminators (a bit each in _lineCandidates). OK and ERROR must match a whole line, the failure line only its start.
+static const byte TERMINATOR_NONE = 0;					// The response continues
+static const byte TERMINATOR_OK = 1;					// "OK"
+static const byte TERMINATOR_ERROR = 2;					// RESPONSE_ERROR_LINE
+static const byte TERMINATOR_FAILURE = 4;				// The command's failure line (while its start is being matched)
+static const byte TERMINATOR_FAILURE_LINE = 8;			// The command's failure line (start matched, the rest of the line is ignored)
+
+// Empties the response buffer.
+void LoRamDot::ResetResponse()
+{
+	_responseHead = 0;
+	_responseLength = 0;
+	_lineMatched = 0;
+	_lineCandidates = TERMINATOR_OK | TERMINATOR_ERROR | ((_failureLine != NULL) ? TERMINATOR_FAILURE : 0);
+	_failureSeen = false;
+}
+
+// Stores a received byte in the response ring buffer and advances the terminator match.
+// Once the buffer is full the oldest bytes are overwritten so the end of the response (and the terminator) is kept.
+// Each line is matched against every terminator as it arrives, so the response ends as soon as the line ending it
+// ("OK", "ERROR" or the command's failure line) is complete.
+// Returns the terminator (TERMINATOR_*) once a line ending the response has been received, TERMINATOR_NONE until then.
+byte LoRamDot::ProcessResponseByte(char c)
+{
+	_responseBuffer[_responseHead] = c;
+
+	if (++_responseHead == LORAMDOT_RESPONSE_BUFFER_SIZE)
+		_responseHead = 0;
+
+	if (_responseLength < LORAMDOT_RESPONSE_BUFFER_SIZE)
+		_responseLength++;
+
+	if (c == '\n')
+	{
+		byte l_terminator = TERMINATOR_NONE;
+
+		if ((_lineCandidates & TERMINATOR_OK) != 0 && RESPONSE_TERMINATOR[_lineMatched] == '\r')
+			l_terminator = TERMINATOR_OK;
+		else if ((_lineCandidates & TERMINATOR_ERROR) != 0 && RESPONSE_ERROR_LINE[_lineMatched] == '\0')
+			l_terminator = TERMINATOR_ERROR;
+		else if ((_lineCandidates & TERMINATOR_FAILURE_LINE) != 0 || ((_lineCandidates & TERMINATOR_FAILURE) != 0 && _failureLine[_lineMatched] == '\0'))
+			l_terminator = TERMINATOR_FAILURE_LINE;
+
+		_lineMatched = 0;
+		_lineCandidates = TERMINATOR_OK | TERMINATOR_ERROR | ((_failureLine != NULL) ? TERMINATOR_FAILURE : 0);
+
+		return l_terminator;
+	}
+
+	// Lines that can no longer end the response are not matched any further
+	if (c == '\r' || (_lineCandidates & (TERMINATOR_OK | TERMINATOR_ERROR | TERMINATOR_FAILURE)) == 0)
+		return TERMINATOR_NONE;
+
+	// A candidate is dropped at its first mismatch (or at the end of its text) so it is never read beyond its end
+	if ((_lineCandidates & TERMINATOR_OK) != 0 && RESPONSE_TERMINATOR[_lineMatched] != c)
+		_lineCandidates &= ~TERMINATOR_OK;
+
+	if ((_lineCandidates & TERMINATOR_ERROR) != 0 && RESPONSE_ERROR_LINE[_lineMatched] != c)
+		_lineCandidates &= ~TERMINATOR_ERROR;
+
+	if ((_lineCandidates & TERMINATOR_FAILURE) != 0 && _failureLine[_lineMatched] != c)
+		_lineCandidates &= ~TERMINATOR_FAILURE;
+
+	_lineMatched++;
+
+	if ((_lineCandidates & TERMINATOR_FAILURE) != 0 && _failureLine[_lineMatched] == '\0')
+		_lineCandidates = TERMINATOR_FAILURE_LINE;
+
+	return TERMINATOR_NONE;
+}
+
+// Returns true if the line of length characters is text.
+static boolean LineIs(const char *line, int length, const char *text)
+{
+	return (int)strlen(text) == length && strncmp(line, text, length) == 0;
+}
+
+// Returns the detail of a failed response: the line starting with failureLine (if not NULL) or else the last line
+// that is not the command echo, OK or ERROR (e.g. "No channel available"). Returns RESPONSE_ERROR_LINE if there is none.
+static String ErrorDetail(const String &response, const char *failureLine)
+{
+	const char *l_text = response.c_str();
+	int l_end = response.length();
+	int l_detailStart = -1;
+	int l_detailEnd = -1;
+
+	while (l_end > 0)
+	{
+		int l_start = l_end;
+
+		while (l_start > 0 && l_text[l_start - 1] != '\n')
+			l_start--;
+
+		int l_lineEnd = l_end;
+
+		while (l_lineEnd > l_start && isspace(l_text[l_lineEnd - 1]))
+			l_lineEnd--;
+
+		const char *l_line = l_text + l_start;
+		int l_length = l_lineEnd - l_start;
+
+		if (failureLine != NULL && strncmp(l_line, failureLine, strlen(failureLine)) == 0)
+			return response.substring(l_start, l_lineEnd);
+
+		if (l_detailStart < 0 && l_length > 0 && strncmp(l_line, "AT", 2) != 0 && !LineIs(l_line, l_length, "OK") && !LineIs(l_line, l_length, RESPONSE_ERROR_LINE))
+		{
+			l_detailStart = l_start;
+			l_detailEnd = l_lineEnd;
+		}
+
+		l_end = l_start - 1;
+	}
+
+	return (l_detailStart < 0) ? String(RESPONSE_ERROR_LINE) : response.substring(l_detailStart, l_detailEnd);
+}
+
+// Returns the byte received index bytes before the last one (0 if it is no longer held in the buffer).
+char LoRamDot::ResponseByteFromEnd(unsigned int index)
+{
+	if (index >= _responseLength)
+		return 0;
+
+	return _responseBuffer[(_responseHead + LORAMDOT_RESPONSE_BUFFER_SIZE - 1 - index) % LORAMDOT_RESPONSE_BUFFER_SIZE];
+}
+
+// Echo of the receive command followed by the blank line the mDot sends in front of a raw payload
+static const char RECEIVE_PREFIX[] = "AT+RECV\r\n\r\n";
+static const byte RECEIVE_PREFIX_LENGTH = 11;
+static const byte RECEIVE_PREFIX_BLANK_LINE = 9;		// Index of the blank line in RECEIVE_PREFIX
+
+// Hex payload line states
+static const byte PAYLOAD_NIBBLE_PENDING = 0x10;		// Added to a pending high nibble
+static const byte PAYLOAD_LINE_NOT_HEX = 0xFF;			// The current line is not payload (echo, OK, ...)
+
+// Returns the value of a hex digit or -1 if c is not a hex digit.
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	return -1;
+}
+
+// Starts decoding the current command's payload into the buffer.
+void LoRamDot::CapturePayload(uint8_t *buffer, size_t capacity)
+{
+	_payloadBuffer = buffer;
+	_payloadCapacity = capacity;
+	_payloadLength = 0;
+	_payloadLineStart = 0;
+	_payloadReceived = 0;
+	_payloadState = 0;
+}
+
+// Decodes a received byte into the payload buffer.
+// Hex: Only lines made entirely of hex digit pairs are payload. Any other line (command echo, OK) is dropped
+// when its end is reached, so the bytes are decoded as they arrive without holding the text.
+// Raw: The bytes are stored as is after skipping the command echo and blank line. The trailing framing is removed by FinishPayload().
+void LoRamDot::DecodePayloadByte(char c)
+{
+	if (_receiveFormat == DATA_FORMAT_RAW)
+	{
+		if (_payloadState < RECEIVE_PREFIX_LENGTH)
+		{
+			// Echo disabled so only the blank line is expected
+			if (_payloadState == 0 && c != RECEIVE_PREFIX[0])
+				_payloadState = RECEIVE_PREFIX_BLANK_LINE;
+
+			if (c == RECEIVE_PREFIX[_payloadState])
+			{
+				_payloadState++;
+				return;
+			}
+
+			// Not framing after all so the characters matched so far are payload
+			for (byte i = (_payloadState >= RECEIVE_PREFIX_BLANK_LINE) ? RECEIVE_PREFIX_BLANK_LINE : 0; i < _payloadState; i++)
+				StoreRawPayloadByte(RECEIVE_PREFIX[i]);
+
+			_payloadState = RECEIVE_PREFIX_LENGTH;
+		}
+
+		StoreRawPayloadByte(c);
+		return;
+	}
+
+	if (c == '\r' || c == '\n')
+	{
+		// Keep the line only if it was complete hex digit pairs
+		if (_payloadState != 0)
+			_payloadLength = _payloadLineStart;
+
+		_payloadLineStart = _payloadLength;
+		_payloadState = 0;
+		return;
+	}
+
+	if (_payloadState == PAYLOAD_LINE_NOT_HEX)
+		return;
+
+	int l_nibble = HexValue(c);
+
+	if (l_nibble < 0)
+		_payloadState = PAYLOAD_LINE_NOT_HEX;
+	else if (_payloadState == 0)
+		_payloadState = PAYLOAD_NIBBLE_PENDING + l_nibble;
+	else
+	{
+		if (_payloadLength < _payloadCapacity)
+			_payloadBuffer[_payloadLength++] = ((_payloadState - PAYLOAD_NIBBLE_PENDING) << 4) | l_nibble;
+
+		_payloadState = 0;
+	}
+}
+
+// Stores a raw payload byte (or only counts it if the buffer is full).
+void LoRamDot::StoreRawPayloadByte(char c)
+{
+	if (_payloadLength < _payloadCapacity)
+		_payloadBuffer[_payloadLength++] = c;
+
+	_payloadReceived++;
+}
+
+// Removes the raw response framing (the CR LF pairs and "OK\r\n" after the payload) and stops capturing.
+void LoRamDot::FinishPayload()
+{
+	if (_payloadBuffer != NULL && _receiveFormat == DATA_FORMAT_RAW)
+	{
+		// The framing is at the end of the response buffer
+		unsigned int l_framing = RESPONSE_TERMINATOR_LENGTH;
+
+		for (byte i = 0; i < 2 && ResponseByteFromEnd(l_framing) == '\n' && ResponseByteFromEnd(l_framing + 1) == '\r'; i++)
+			l_framing += 2;
+
+		size_t l_payload = (_payloadReceived > l_framing) ? _payloadReceived - l_framing : 0;
+
+		if (l_payload < _payloadLength)
+			_payloadLength = l_payload;
+	}
+
+	_payloadBuffer = NULL;
+}
+
+// Returns the number at the start of the first response line that is not the command echo (0 if there is none).
+static unsigned long ParseResponseNumber(const char *response)
+{
+	const char *l_line = response;
+
+	while (*l_line != '\0')
+	{
+		if (isDigit(*l_line))
+			return strtoul(l_line, NULL, 10);
+
+		// Skip the rest of the line (command echo)
+		while (*l_line != '\0' && *l_line != '\n')
+			l_line++;
+
+		while (*l_line == '\r' || *l_line == '\n')
+			l_line++;
+	}
+
+	return 0;
+}
+
+// FNV-1a hash parameters
+static const uint32_t HASH_OFFSET = 2166136261UL;
+static const uint32_t HASH_PRIME = 16777619UL;
+
+// Adds c to a hash of hex digits. Characters that are not hex digits (separators) are ignored and case does not matter.
+static uint32_t HashHexStep(uint32_t hash, char c)
+{
+	int l_value = HexValue(c);
+
+	return (l_value < 0) ? hash : (uint32_t)((hash ^ (uint32_t)l_value) * HASH_PRIME);
+}
+
+// Returns the completed hash of hex digits. Never returns 0 (used for unknown).
+static uint32_t HashHexFinish(uint32_t hash)
+{
+	return (hash == 0) ? 1 : hash;
+}
+
+// Returns a hash of the hex digits in text, ignoring case and separators, so keys written as
+// 0011AABB, 00:11:aa:bb or 00-11-AA-BB hash the same. Never returns 0 (used for unknown).
+static uint32_t HashHex(const char *text)
+{
+	uint32_t l_hash = HASH_OFFSET;
+
+	for (; *text != '\0'; text++)
+		l_hash = HashHexStep(l_hash, *text);
+
+	return HashHexFinish(l_hash);
+}
+
+// Sends a setting and records it in the shadow (unknown if the command failed).
+boolean LoRamDot::SendSetting(const char *prefix, byte value, byte *shadow)
+{
+	boolean l_result = SendCommandValue(prefix, value);
+
+	*shadow = (l_result) ? value : CONFIG_UNSET;
+
+	return l_result;
+}
+
+// Reverses the characters between first and last (exclusive) in place.
+static void ReverseBuffer(char *first, char *last)
+{
+	while (first < last && first < --last)
+	{
+		char l_swap = *first;
+		*first++ = *last;
+		*last = l_swap;
+	}
+}
+
+// Copies the trimmed response buffer into _lastResponse.
+void LoRamDot::FinishResponse()
+{
+	// Rotate a wrapped buffer so the oldest byte is first
+	if (_responseLength == LORAMDOT_RESPONSE_BUFFER_SIZE && _responseHead != 0)
+	{
+		ReverseBuffer(_responseBuffer, _responseBuffer + _responseHead);
+		ReverseBuffer(_responseBuffer + _responseHead, _responseBuffer + LORAMDOT_RESPONSE_BUFFER_SIZE);
+		ReverseBuffer(_responseBuffer, _responseBuffer + LORAMDOT_RESPONSE_BUFFER_SIZE);
+		_responseHead = 0;
+	}
+
+	// Trim leading and trailing white space
+	unsigned int l_start = 0;
+	unsigned int l_end = _responseLength;
+
+	while (l_start < l_end && isspace(_responseBuffer[l_start]))
+		l_start++;
+
+	while (l_end > l_start && isspace(_responseBuffer[l_end - 1]))
+		l_end--;
+
+	_responseBuffer[l_end] = '\0';
+
+	_lastResponse = &_responseBuffer[l_start];
+}
+
+// Ends the current command with the given status and calls the command callback (if set).
+void LoRamDot::CompleteCommand(int statusId, const char *statusMessage)
+{
+	_commandState = COMMAND_STATE_COMPLETE;
+
+	// A signal reading fails if its four values were not all received
+	if (_signal != NULL)
+	{
+		if (statusId == COMMAND_STATUS_ID_OK && _signalFields < 4)
+		{
+			statusId = COMMAND_STATUS_INPUT_OUT_OF_RANGE;
+			statusMessage = "INPUT-OUT-OF-RANGE";
+		}
+
+		_signal = NULL;
+	}
+
+	_lastCommandStatus = (statusId == COMMAND_STATUS_ID_OK);
+	_lastCommandStatusMessage = statusMessage;
+	_lastCommandStatusId = statusId;
+
+	if (_snapshot != NULL)
+		FinishSnapshot();
+
+	_statistics = NULL;
+
+#if LORAMDOT_METRICS
+	CloseMetrics(statusId);
+#endif
+
+	if (_timeoutAdaptive)
+		LearnLatency(statusId);
+
+	if (statusId == COMMAND_STATUS_ID_OK && _commandClass == TIMEOUT_CLASS_SEND && _uplinksSinceSave < 0xFFFF)
+		_uplinksSinceSave++;
+
+	if (_commandCallback != NULL)
+		_commandCallback(statusId);
+}
+
+#if LORAMDOT_METRICS
+/////////////////////////////////////////////
+// Command Metrics
+/////////////////////////////////////////////
+
+// Returns the latency histogram bucket of a latency in milliseconds.
+static byte LatencyBucket(unsigned long latency)
+{
+	byte l_bucket = 0;
+
+	while (latency > 0 && l_bucket < METRICS_LATENCY_BUCKETS - 1)
+	{
+		latency >>= 1;
+		l_bucket++;
+	}
+
+	return l_bucket;
+}
+
+// Adds one to a count that stops at its maximum.
+static void SaturatingIncrement(uint16_t *count)
+{
+	if (*count != 0xFFFF)
+		(*count)++;
+}
+
+// Starts recording the command named by prefix (the text before any '=' or '?').
+// written: Bytes of the prefix written.
+void LoRamDot::OpenMetrics(const char *prefix, size_t written)
+{
+	char l_name[LORAMDOT_METRICS_NAME_SIZE + 1];
+	byte l_length = 0;
+
+	while (l_length < LORAMDOT_METRICS_NAME_SIZE && prefix[l_length] != '\0' && prefix[l_length] != '=' && prefix[l_length] != '?')
+	{
+		l_name[l_length] = prefix[l_length];
+		l_length++;
+	}
+
+	l_name[l_length] = '\0';
+
+	byte l_index = 0;
+
+	while (l_index < _metricsCount && strcmp(_metrics[l_index].command, l_name) != 0)
+		l_index++;
+
+	if (l_index == _metricsCount)
+	{
+		if (_metricsCount < LORAMDOT_METRICS_COMMANDS - 1)
+			strcpy(_metrics[_metricsCount++].command, l_name);
+		else
+		{
+			// The last entry counts every command that does not fit
+			l_index = LORAMDOT_METRICS_COMMANDS - 1;
+
+			if (_metricsCount < LORAMDOT_METRICS_COMMANDS)
+			{
+				strcpy(_metrics[l_index].command, "*");
+				_metricsCount = LORAMDOT_METRICS_COMMANDS;
+			}
+		}
+	}
+
+	_commandMetrics = &_metrics[l_index];
+	_commandMetrics->calls++;
+	_commandMetrics->bytesWritten += written;
+}
+
+// Records the outcome and latency of the current command.
+void LoRamDot::CloseMetrics(int statusId)
+{
+	if (_commandMetrics == NULL)
+		return;
+
+	unsigned long l_latency = millis() - _metricsStart;
+
+	if (statusId == COMMAND_STATUS_ID_TIMED_OUT)
+		SaturatingIncrement(&_commandMetrics->timeouts);
+	else if (statusId != COMMAND_STATUS_ID_OK)
+		SaturatingIncrement(&_commandMetrics->errors);
+
+	_commandMetrics->totalMs += l_latency;
+
+	if (l_latency > _commandMetrics->maximumMs)
+		_commandMetrics->maximumMs = l_latency;
+
+	SaturatingIncrement(&_commandMetrics->latency[LatencyBucket(l_latency)]);
+
+	// A response restarted with ReceiveResponse() is not counted again
+	_commandMetrics = NULL;
+}
+
+// Returns the number of commands with metrics.
+byte LoRamDot::CommandMetricsCount()
+{
+	return _metricsCount;
+}
+
+// Returns the metrics of the command at index (0 to CommandMetricsCount() - 1) or NULL.
+const LoRamDotCommandMetrics *LoRamDot::CommandMetrics(byte index)
+{
+	return (index < _metricsCount) ? &_metrics[index] : NULL;
+}
+
+// Returns the metrics of the command (e.g. "AT+SENDB") or NULL if it has not been sent.
+const LoRamDotCommandMetrics *LoRamDot::CommandMetrics(const char *command)
+{
+	for (byte i = 0; i < _metricsCount; i++)
+	{
+		if (strncmp(_metrics[i].command, command, LORAMDOT_METRICS_NAME_SIZE) == 0)
+			return &_metrics[i];
+	}
+
+	return NULL;
+}
+
+// Clears the metrics of every command.
+void LoRamDot::ClearCommandMetrics()
+{
+	for (byte i = 0; i < _metricsCount; i++)
+		_metrics[i] = LoRamDotCommandMetrics();
+
+	_metricsCount = 0;
+	_commandMetrics = NULL;
+}
+
+// Returns the shortest latency in milliseconds counted by a histogram bucket.
+unsigned long LoRamDot::LatencyBucketMs(byte bucket)
+{
+	if (bucket >= METRICS_LATENCY_BUCKETS)
+		bucket = METRICS_LATENCY_BUCKETS - 1;
+
+	return (bucket == 0) ? 0 : 1UL << (bucket - 1);
+}
+
+// Returns the latency in milliseconds that percent of the commands did not exceed. The histogram only
+// holds powers of two, so this is the top of the bucket the percentile falls in, limited to maximumMs.
+unsigned long LoRamDot::LatencyPercentileMs(const LoRamDotCommandMetrics &metrics, byte percent)
+{
+	uint32_t l_total = 0;
+
+	for (byte i = 0; i < METRICS_LATENCY_BUCKETS; i++)
+		l_total += metrics.latency[i];
+
+	if (l_total == 0)
+		return 0;
+
+	// Rank of the percentile command (rounded up, at least the first)
+	uint32_t l_rank = (l_total * ((percent > 100) ? 100 : percent) + 99) / 100;
+	uint32_t l_count = 0;
+
+	if (l_rank == 0)
+		l_rank = 1;
+
+	for (byte i = 0; i < METRICS_LATENCY_BUCKETS - 1; i++)
+	{
+		l_count += metrics.latency[i];
+
+		if (l_count >= l_rank)
+		{
+			unsigned long l_top = LatencyBucketMs(i + 1) - 1;
+
+			return (l_top < metrics.maximumMs) ? l_top : metrics.maximumMs;
+		}
+	}
+
+	return metrics.maximumMs;
+}
+#endif
+
+// Polls until the current command completes.
+// In an event callback raised while the command's response is read it returns at once: the callback runs inside
+// Poll(), so reading on would take bytes of that response. The command that follows then fails with BUSY.
+void LoRamDot::WaitForCommand()
+{
+	if (_inCallback)
+		return;
+
+	while (Poll() == COMMAND_STATE_WAITING);
+}
+
+// Polls until the current command completes and copies the response.
+// Returns true if the response was received otherwise returns false.
+boolean LoRamDot::WaitForResponse(String *response)
+{
+	WaitForCommand();
+
+	if (_lastCommandStatusId == COMMAND_STATUS_ID_OK)
+	{
+		if (response != &_lastResponse)
+			*response = _lastResponse;
+
+		return true;
+	}
+
+	// No response so return an empty string
+	if (response != &_lastResponse)
+		*response = "";
+
+	return false;
+}
+
 // Protected Methods ////////////////////////////////////////////////////////////
 
+// Send a command that instructs the mDot to send the data and wait for the "OK" response.
+boolean LoRamDot::SendCommand(const char *command)
+{
+	return SendCommand(command, &_lastResponse);
+}
+
+// Send a command that instructs the mDot to send the command and wait for the respnse string.
+// Returns true if response received otherwise returns false.
+boolean LoRamDot::SendCommand(const char *command, String *response)
+{
+	// Finish any asynchronous command still waiting for its response
+	WaitForCommand();
+
+	if (OpenCommand(command))
+		CloseCommand();
+
+	return WaitForResponse(response);
+}
+
 // Send a command that instructs the mDot to send the data and wait for the "OK" response.
 boolean LoRamDot::SendCommand(String command)
 {
-	return SendCommand(command, & _lastResponse);
+	return SendCommand(command.c_str(), &_lastResponse);
 }
 
 // Send a command that instructs the mDot to send the command and wait for the respnse string.
 // Returns true if response received otherwise returns false.
 boolean LoRamDot::SendCommand(String command, String *response)
 {
+	return SendCommand(command.c_str(), response);
+}
+
+// Read the the serial response.
+// The timeout is given separately from the command's class timeout (See CommandTimeout()). 0 waits with no timeout.
+boolean LoRamDot::ReceiveResponse(String *response, unsigned long timeout)
+{
+	// Restart the wait for the response with the given timeout
+	// If timeout = 0 there is no timeout (may loop forever)
+	if (_inCallback)
+	{
+		_lastCommandStatus = false;
+		_lastCommandStatusMessage = "BUSY";
+		_lastCommandStatusId = COMMAND_STATUS_ID_BUSY;
+		*response = "";
+
+		return false;
+	}
+
+	if (_commandState != COMMAND_STATE_WAITING)
+		ResetResponse();
+
+	_commandState = COMMAND_STATE_WAITING;
+	_commandStart = millis();
+	_commandTimeout = timeout;
+
+	return WaitForResponse(response);
+}
+
+/////////////////////////////////////////////
+// Asynchronous Commands
+/////////////////////////////////////////////
+
+// Starts a command and writes its prefix to the serial stream. The arguments are printed by the caller followed by CloseCommand().
+// failureLine: Start of a line that ends the response as failed (besides ERROR), e.g. JOIN_FAILURE_LINE. NULL for none.
+// Returns false (BUSY) if the previous command is still waiting for its response.
+boolean LoRamDot::OpenCommand(const char *prefix, const char *failureLine)
+{
+	if (_commandState == COMMAND_STATE_WAITING)
+	{
+		_lastCommandStatus = false;
+		_lastCommandStatusMessage = "BUSY";
+		_lastCommandStatusId = COMMAND_STATUS_ID_BUSY;
+
+		return false;
+	}
+
 	// Clear the buffers and last response
 	_Serial->flush();
 
@@ -66,52 +991,215 @@ boolean LoRamDot::SendCommand(String command, String *response)
 	_lastCommandStatusId = 0;
 	_lastCommandStatusMessage = "";
 	_lastResponse = "";
+	_failureLine = failureLine;
+	_commandClass = TimeoutClass(prefix);
+	ResetResponse();
+	_eventLineLength = 0;
 
 	// Send the AT command
-	_Serial->println(command);
+#if LORAMDOT_METRICS
+	_metricsStart = millis();
+	OpenMetrics(prefix, _Serial->print(prefix));
+#else
+	_Serial->print(prefix);
+#endif
 
-	// If timeout is >= 0 get the response
-	// if < 0 return imediately and get the response using ReceiveResponse(*response)
-	if (_timeout >= 0)
-		return ReceiveResponse(response, _timeout);
-	else
-		return true;
+	return true;
 }
 
-// Read the the serial response.
-// The timeout is set seperately to enable the use of -1 in SendCommand
-boolean LoRamDot::ReceiveResponse(String *response, unsigned long timeout)
+// Ends the command line and starts waiting for the response.
+// written: Bytes of arguments the caller printed after the prefix (for the command metrics). lineEnd: false for a
+// sequence without CR LF (SERIAL_DATA_ESCAPE).
+void LoRamDot::CloseCommand(size_t written, boolean lineEnd)
 {
-	// Timeout time
-	unsigned long l_timeout = millis() + timeout;
+	if (lineEnd)
+		written += _Serial->print("\r\n");
 
-	// Get the LoRaWAN data
-	// If timeout = 0 there is no timeout (may loop forever)
-	while (millis() < l_timeout || timeout == 0)
+#if LORAMDOT_METRICS
+	if (_commandMetrics != NULL)
+		_commandMetrics->bytesWritten += written;
+#endif
+
+	_commandState = COMMAND_STATE_WAITING;
+	_commandStart = millis();
+	_commandTimeout = CommandTimeout(_commandClass);
+}
+
+// Sends a command and returns immediately. Call Poll() from loop() until the command completes.
+// Returns false (BUSY) if the previous command is still waiting for its response.
+boolean LoRamDot::BeginCommand(const char *command)
+{
+	if (!OpenCommand(command))
+		return false;
+
+	CloseCommand();
+
+	return true;
+}
+
+// Sends a command and returns immediately. Call Poll() from loop() until the command completes.
+// Returns false (BUSY) if the previous command is still waiting for its response.
+boolean LoRamDot::BeginCommand(String command)
+{
+	return BeginCommand(command.c_str());
+}
+
+// Reads the available response data and returns the command state (COMMAND_STATE_IDLE, _WAITING or _COMPLETE).
+// Never blocks. The command callback is called once when the command completes or times out.
+byte LoRamDot::Poll()
+{
+	// Called from an event callback raised while the response is read: the rest of it is read when the callback returns
+	if (_inCallback)
+		return _commandState;
+
+	if (_commandState != COMMAND_STATE_WAITING)
 	{
-		if (_Serial->available())
+		// Lines received between commands are unsolicited. A callback may start a command, which ends the loop.
+		while (_eventsEnabled && _commandState != COMMAND_STATE_WAITING && _Serial->available())
+			ProcessEventByte((char)_Serial->read());
+
+		return _commandState;
+	}
+
+	while (_Serial->available())
+	{
+		char l_received = (char)_Serial->read();
+
+#if LORAMDOT_METRICS
+		if (_commandMetrics != NULL)
+			_commandMetrics->bytesRead++;
+#endif
+
+		if (_eventsEnabled)
+			ProcessEventByte(l_received);
+
+		if (_payloadBuffer != NULL)
+			DecodePayloadByte(l_received);
+		else if (_snapshot != NULL || _statistics != NULL)
+			ParseSnapshotByte(l_received);
+		else if (_signal != NULL)
+			ParseSignalByte(l_received);
+
+		byte l_terminator = ProcessResponseByte(l_received);
+
+		if (l_terminator == TERMINATOR_FAILURE_LINE)
 		{
-			_lastResponse += (char)_Serial->read();
-			
-			if (_lastResponse.endsWith("OK\r\n"))
-			{
-				_lastResponse.trim();
-				*response = _lastResponse;
+			// The mDot normally follows the failure line with ERROR. It is read as part of this response
+			// (if it arrives within FAILURE_LINE_SETTLE) so it is not taken as the next command's response.
+			_failureSeen = true;
+			_failureTime = millis();
+		}
+		else if (l_terminator != TERMINATOR_NONE)
+		{
+			FinishResponse();
 
-				_lastCommandStatusMessage = "OK";
-				_lastCommandStatusId = COMMAND_STATUS_ID_OK;
+			if (l_terminator == TERMINATOR_OK)
+				CompleteCommand(COMMAND_STATUS_ID_OK, "OK");
+			else
+				CompleteCommand(COMMAND_STATUS_ID_ERROR, ErrorDetail(_lastResponse, (_failureSeen) ? _failureLine : NULL).c_str());
 
-				return true;
-			}
+			return _commandState;
 		}
 	}
 
-	// No data available so return an empty string
-	*response = "";
-	_lastCommandStatusMessage = "TIMED-OUT";
-	_lastCommandStatusId = COMMAND_STATUS_ID_TIMED_OUT;
+	if (_failureSeen && (millis() - _failureTime) >= FAILURE_LINE_SETTLE)
+	{
+		FinishResponse();
+		CompleteCommand(COMMAND_STATUS_ID_ERROR, ErrorDetail(_lastResponse, _failureLine).c_str());
 
-	return false;
+		return _commandState;
+	}
+
+	// If the timeout = 0 there is no timeout (may wait forever)
+	// The partial response is kept in the last response
+	if (_commandTimeout != 0 && (millis() - _commandStart) >= _commandTimeout)
+	{
+		FinishResponse();
+		CompleteCommand(COMMAND_STATUS_ID_TIMED_OUT, "TIMED-OUT");
+	}
+
+	return _commandState;
+}
+
+// Returns the event raised by a received line or EVENT_COUNT if it raises none.
+// inCommand: The line is part of a command response (only lines with a known meaning raise an event).
+static byte ClassifyLine(const char *line, boolean inCommand)
+{
+	if (strcmp(line, "RECV") == 0)
+		return EVENT_DOWNLINK;
+	if (strncmp(line, "Successfully joined", 19) == 0)
+		return EVENT_JOINED;
+	if (strncmp(line, "Failed to join", 14) == 0 || strncmp(line, "Join Error", 10) == 0)
+		return EVENT_JOIN_FAILED;
+	if (strncmp(line, "MultiTech", 9) == 0)
+		return EVENT_RESET;
+	if (strncmp(line, "ERROR", 5) == 0 || strncmp(line, "Error", 5) == 0)
+		return EVENT_ERROR;
+	if (!inCommand && strcmp(line, "OK") != 0)
+		return EVENT_UNSOLICITED;
+
+	return EVENT_COUNT;
+}
+
+// Adds a received byte to the current line and dispatches the line's event once it ends.
+// Characters beyond LORAMDOT_EVENT_LINE_SIZE are dropped so only the start of a long line is classified.
+void LoRamDot::ProcessEventByte(char c)
+{
+	if (c == '\r')
+		return;
+
+	if (c != '\n')
+	{
+		if (_eventLineLength < LORAMDOT_EVENT_LINE_SIZE)
+			_eventLine[_eventLineLength++] = c;
+
+		return;
+	}
+
+	if (_eventLineLength == 0)
+		return;
+
+	_eventLine[_eventLineLength] = '\0';
+	_eventLineLength = 0;
+
+	byte l_event = ClassifyLine(_eventLine, _commandState == COMMAND_STATE_WAITING);
+
+	if (l_event < EVENT_COUNT && _eventCallbacks[l_event] != NULL)
+	{
+		// While a command waits its response is still being read, so the callback can neither read nor send a command
+		_inCallback = (_commandState == COMMAND_STATE_WAITING);
+		_eventCallbacks[l_event](l_event, _eventLine);
+		_inCallback = false;
+	}
+}
+
+// Sets the function called when a line raising event (EVENT_*) is received. NULL disables the callback.
+// Once a callback is set Poll() also reads the serial stream between commands so unsolicited lines are seen as they arrive.
+void LoRamDot::setEventCallback(byte event, EventCallback callback)
+{
+	if (event >= EVENT_COUNT)
+		return;
+
+	_eventCallbacks[event] = callback;
+	_eventsEnabled = false;
+
+	for (byte i = 0; i < EVENT_COUNT; i++)
+	{
+		if (_eventCallbacks[i] != NULL)
+			_eventsEnabled = true;
+	}
+}
+
+// Returns the command state without reading from the serial stream.
+byte LoRamDot::CommandState()
+{
+	return _commandState;
+}
+
+// Sets the function called when a command completes. NULL disables the callback.
+void LoRamDot::setCommandCallback(CommandCallback callback)
+{
+	_commandCallback = callback;
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
@@ -128,7 +1216,7 @@ String LoRamDot::LastCommandStatusMessage()
 	return _lastCommandStatusMessage;
 }
 
-// Returns the status message ID of the last command (0:OK, 1:TIMED-OUT, 2:INPUT-OUT-OF-RANGE).
+// Returns the status message ID of the last command (0:OK, 1:TIMED-OUT, 2:INPUT-OUT-OF-RANGE, 3:BUSY, 4:ERROR).
 int LoRamDot::LastCommandStatusId()
 {
 	return _lastCommandStatusId;
@@ -160,6 +1248,9 @@ String LoRamDot::RequestID()
 // Resets the CPU, the same way as pressing the reset button. The program is reloaded from flash and begins execution at the main function.Reset takes about 3 seconds.
 boolean LoRamDot::ResetCPU()
 {
+	// Unsaved settings are lost
+	ForgetConfiguration();
+
 	return SendCommand("ATZ");
 }
 
@@ -167,7 +1258,7 @@ boolean LoRamDot::ResetCPU()
 boolean LoRamDot::EchoMode(boolean mode)
 {
 	if (mode == 0 || mode == 1)
-		return SendCommand("ATE=" + (mode) ? "1" : "0");
+		return SendCommandValue("ATE=", (mode) ? 1 : 0);
 	else
 	{
 		_lastCommandStatus = false;
@@ -182,7 +1273,7 @@ boolean LoRamDot::EchoMode(boolean mode)
 boolean LoRamDot::VerbosMode(boolean mode)
 {
 	if (mode == 0 || mode == 1)
-		return SendCommand("ATV=" + (mode) ? "1" : "0");
+		return SendCommandValue("ATV=", (mode) ? 1 : 0);
 	else
 	{
 		_lastCommandStatus = false;
@@ -196,21 +1287,14 @@ boolean LoRamDot::VerbosMode(boolean mode)
 // Enable or disable hardware flow control. Hardware flow control is useful in serial data mode to keep from overflowing the input buffers.
 boolean LoRamDot::HardWareFlowControl(boolean mode)
 {
-	if (mode == 3 || mode == 0)
-		return SendCommand("AT&K=" + (mode) ? "3" : "0");
-	else
-	{
-		_lastCommandStatus = false;
-		_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
-		_lastCommandStatusId = COMMAND_STATUS_INPUT_OUT_OF_RANGE;
-
-		return false;
-	}
+	return SendCommandValue("AT&K=", (mode) ? 3 : 0);
 }
 
 // Reset to Factory Defaults changes the current settings to the factory defaults, but does not store them.
 boolean LoRamDot::ResetToFactory()
 {
+	ForgetConfiguration();
+
 	return SendCommand("AT&F");
 }
 
@@ -224,7 +1308,7 @@ boolean LoRamDot::SaveConfiguration()
 boolean LoRamDot::WakePin(byte pin)
 {
 	if (pin >= 1 && pin <= 8)
-		return SendCommand("AT+WP=" + String(pin));
+		return SendCommandValue("AT+WP=", pin);
 	else
 	{
 		_lastCommandStatus = false;
@@ -236,11 +1320,11 @@ boolean LoRamDot::WakePin(byte pin)
 }
 
 // Sets serial baud rate for interface on header pins 2 and 3. Changes to this setting take effect after a save and reboot of the Dot.
-boolean LoRamDot::SerialSpeed(int speed)
+boolean LoRamDot::SerialSpeed(unsigned long speed)
 {
 	// Check if the level is within the valid range
-	if ((speed == 1200) | (speed == 2400) | (speed == 4800) | (speed == 9600) | (speed == 19200) | (speed == 38400) | (speed == 57600) | (speed == 115200) | (speed == 230500) | (speed == 460800) | (speed == 921600))
-		return SendCommand("AT+IPR=" + String(speed));
+	if ((speed == 1200) | (speed == 2400) | (speed == 4800) | (speed == 9600) | (speed == 19200) | (speed == 38400) | (speed == 57600) | (speed == 115200) | (speed == 230400) | (speed == 460800) | (speed == 921600))
+		return SendCommandValue("AT+IPR=", speed);
 	else
 	{
 		_lastCommandStatus = false;
@@ -252,11 +1336,11 @@ boolean LoRamDot::SerialSpeed(int speed)
 }
 
 // Sets debug serial baud rate for interface on DEBUG header pins 30 and 31. Changes to this setting take effect after a save and reboot of the Dot.power - cycle or reset.
-boolean LoRamDot::DebugSerialSpeed(int speed)
+boolean LoRamDot::DebugSerialSpeed(unsigned long speed)
 {
 	// Check if the level is within the valid range
-	if (speed == 2400 | speed == 4800 | speed == 9600 | speed == 19200 | speed == 38400 | speed == 57600 | speed == 115200 | speed == 230500 | speed == 460800 | speed == 921600)
-		return SendCommand("AT+DIPR=" + String(speed));
+	if ((speed == 2400) | (speed == 4800) | (speed == 9600) | (speed == 19200) | (speed == 38400) | (speed == 57600) | (speed == 115200) | (speed == 230400) | (speed == 460800) | (speed == 921600))
+		return SendCommandValue("AT+DIPR=", speed);
 	else
 	{
 		_lastCommandStatus = false;
@@ -267,12 +1351,163 @@ boolean LoRamDot::DebugSerialSpeed(int speed)
 	}
 }
 
+/////////////////////////////////////////////
+// Baud Rate Negotiation
+/////////////////////////////////////////////
+
+// mDot serial baud rates, fastest first
+static const unsigned long BAUD_RATES[] = { 921600, 460800, 230400, 115200, 57600, 38400, 19200, 9600, 4800, 2400, 1200 };
+static const byte BAUD_RATE_COUNT = sizeof(BAUD_RATES) / sizeof(BAUD_RATES[0]);
+
+// Sends AT and waits up to timeout for OK. Input already received is discarded first as it may have been
+// received at the wrong baud rate.
+boolean LoRamDot::ProbeAttention(unsigned long timeout)
+{
+	WaitForCommand();
+
+	while (_Serial->available())
+		_Serial->read();
+
+	if (OpenCommand("AT"))
+	{
+		CloseCommand();
+		_commandTimeout = timeout;
+	}
+
+	return WaitForResponse(&_lastResponse);
+}
+
+// Finds the mDot's baud rate by trying each rate up to maximum (fastest first) until it answers AT.
+// setBaudRate: Reopens the host serial port at the rate given. It is left at the rate found.
+// Returns the rate or 0 if the mDot never answers.
+unsigned long LoRamDot::ProbeBaudRate(BaudRateCallback setBaudRate, unsigned long maximum)
+{
+	_baudRate = 0;
+
+	for (byte i = 0; i < BAUD_RATE_COUNT && _baudRate == 0; i++)
+	{
+		if (BAUD_RATES[i] > maximum)
+			continue;
+
+		setBaudRate(BAUD_RATES[i]);
+
+		for (byte j = 0; j < BAUD_PROBE_ATTEMPTS && _baudRate == 0; j++)
+		{
+			if (ProbeAttention(BAUD_PROBE_TIMEOUT))
+				_baudRate = BAUD_RATES[i];
+		}
+	}
+
+	return _baudRate;
+}
+
+// Reopens the host serial port at baudRate and waits (up to BAUD_RESTART_TIMEOUT) until the mDot answers AT.
+boolean LoRamDot::WaitForRestart(BaudRateCallback setBaudRate, unsigned long baudRate)
+{
+	unsigned long l_start = millis();
+
+	setBaudRate(baudRate);
+
+	do
+	{
+		if (ProbeAttention(BAUD_PROBE_TIMEOUT))
+			return true;
+	} while ((millis() - l_start) < BAUD_RESTART_TIMEOUT);
+
+	return false;
+}
+
+// Checks the link is error free at baudRate: BAUD_VERIFY_COMMANDS ATs and an AT&V (the longest response) that reports the rate.
+boolean LoRamDot::VerifyBaudRate(unsigned long baudRate)
+{
+	for (byte i = 0; i < BAUD_VERIFY_COMMANDS; i++)
+	{
+		if (!Attention())
+			return false;
+	}
+
+	LoRamDotSnapshot l_snapshot;
+
+	return ReadSnapshot(l_snapshot) && l_snapshot.serialBaudRate == baudRate;
+}
+
+// Saves the baud rate (AT+IPR, AT&W), restarts the mDot (ATZ) and verifies the link at the new rate.
+// The mDot only changes its rate when it restarts with the rate saved.
+boolean LoRamDot::ChangeBaudRate(BaudRateCallback setBaudRate, unsigned long baudRate)
+{
+	if (!SerialSpeed(baudRate) || !SaveConfiguration())
+		return false;
+
+	// The OK may be lost as the mDot restarts
+	ResetCPU();
+
+	return WaitForRestart(setBaudRate, baudRate) && VerifyBaudRate(baudRate);
+}
+
+// Returns the mDot to baudRate after a failed change to rejected. The commands are sent whether or not they are
+// acknowledged, as a link with errors may still carry them. Between attempts the host port is reopened at rejected
+// in case the mDot is still using it.
+boolean LoRamDot::RevertBaudRate(BaudRateCallback setBaudRate, unsigned long baudRate, unsigned long rejected)
+{
+	for (byte i = 0; i < BAUD_FALLBACK_ATTEMPTS; i++)
+	{
+		SerialSpeed(baudRate);
+		SaveConfiguration();
+		ResetCPU();
+
+		if (WaitForRestart(setBaudRate, baudRate) && VerifyBaudRate(baudRate))
+			return true;
+
+		setBaudRate(rejected);
+	}
+
+	return false;
+}
+
+// Probes the baud rate, then steps the mDot up one rate at a time to the fastest rate up to maximum that passes an error
+// free check (BAUD_VERIFY_COMMANDS ATs and an AT&V). Each step saves the rate and restarts the mDot (about 3 seconds).
+// The first rate that fails is reverted to the last good rate. If even that fails the rates are probed again.
+// setBaudRate: Reopens the host serial port at the rate given, e.g. Serial1.begin(baudRate).
+// maximum: Fastest rate to try (the host UART may not reach BAUD_RATE_MAX).
+// Returns the rate in use or 0 if the mDot was not found.
+unsigned long LoRamDot::NegotiateBaudRate(BaudRateCallback setBaudRate, unsigned long maximum)
+{
+	unsigned long l_rate = ProbeBaudRate(setBaudRate, maximum);
+
+	if (l_rate == 0)
+		return 0;
+
+	for (int i = BAUD_RATE_COUNT - 1; i >= 0; i--)
+	{
+		if (BAUD_RATES[i] <= l_rate || BAUD_RATES[i] > maximum)
+			continue;
+
+		if (!ChangeBaudRate(setBaudRate, BAUD_RATES[i]))
+		{
+			if (RevertBaudRate(setBaudRate, l_rate, BAUD_RATES[i]))
+				return _baudRate = l_rate;
+
+			return ProbeBaudRate(setBaudRate, BAUD_RATE_MAX);
+		}
+
+		l_rate = BAUD_RATES[i];
+	}
+
+	return _baudRate = l_rate;
+}
+
+// Returns the baud rate found by the last probe or negotiation (0 if unknown).
+unsigned long LoRamDot::BaudRate()
+{
+	return _baudRate;
+}
+
 // Sets the debug message logging level. Messages are output on the debug port. Higher settings log more messages.
 boolean LoRamDot::DebugLogLevel(byte level)
 {
 	// Check if the level is within the valid range
 	if (level >= 0 && level <= 6)
-		return SendCommand("AT+LOG=" + String(level));
+		return SendCommandValue("AT+LOG=", level);
 	else
 	{
 		_lastCommandStatus = false;
@@ -283,6 +1518,108 @@ boolean LoRamDot::DebugLogLevel(byte level)
 	}
 }
 
+/////////////////////////////////////////////
+// Configuration Shadow
+/////////////////////////////////////////////
+
+// Sends only the settings that differ from the known mDot state, then saves them with a single AT&W (only if something changed).
+// changes: Optional count of settings sent. Returns false if a command failed (the settings already sent are not saved).
+boolean LoRamDot::ApplyConfiguration(const LoRamDotConfig &config, byte *changes)
+{
+	byte l_changes = 0;
+	boolean l_result = true;
+
+	if (changes != NULL)
+		*changes = 0;
+
+	// Each setting is sent only if it is managed and differs from the shadow
+	if (l_result && config.dataRate != CONFIG_UNSET && config.dataRate != _shadow.dataRate)
+	{
+		l_result = SendSetting("AT+TXDR=DR", config.dataRate, &_shadow.dataRate);
+		_dataRate = _shadow.dataRate == CONFIG_UNSET ? DATA_RATE_UNKNOWN : _shadow.dataRate;
+		l_changes++;
+	}
+	if (l_result && config.publicNetwork != CONFIG_UNSET && config.publicNetwork != _shadow.publicNetwork)
+	{
+		l_result = PublicNetworkMode(config.publicNetwork);
+		l_changes++;
+	}
+	if (l_result && config.joinMode != CONFIG_UNSET && config.joinMode != _shadow.joinMode)
+	{
+		l_result = NetworkJoinMode(config.joinMode);
+		l_changes++;
+	}
+	if (l_result && config.subBand != CONFIG_UNSET && config.subBand != _shadow.subBand)
+	{
+		l_result = FrequencySubBand(config.subBand);
+		l_changes++;
+	}
+	if (l_result && config.ackAttempts != CONFIG_UNSET && config.ackAttempts != _shadow.ackAttempts)
+	{
+		l_result = RequireAcknowledgment(config.ackAttempts);
+		l_changes++;
+	}
+	if (l_result && config.adaptiveDataRate != CONFIG_UNSET && config.adaptiveDataRate != _shadow.adaptiveDataRate)
+	{
+		l_result = AdaptiveDataRate(config.adaptiveDataRate);
+		l_changes++;
+	}
+	if (l_result && config.transmitPower != CONFIG_UNSET && config.transmitPower != _shadow.transmitPower)
+	{
+		l_result = TransmitPower(config.transmitPower);
+		l_changes++;
+	}
+	if (l_result && config.applicationPort != CONFIG_UNSET && config.applicationPort != _shadow.applicationPort)
+	{
+		l_result = ApplicationPort(config.applicationPort);
+		l_changes++;
+	}
+	if (l_result && config.joinRetries != CONFIG_UNSET && config.joinRetries != _shadow.joinRetries)
+	{
+		l_result = JoinRetries(config.joinRetries);
+		l_changes++;
+	}
+	if (l_result && config.networkId != NULL && HashHex(config.networkId) != _networkIdHash)
+	{
+		l_result = NetworkID(KEY_TYPE_HEX, config.networkId);
+		l_changes++;
+	}
+	if (l_result && config.networkKey != NULL && HashHex(config.networkKey) != _networkKeyHash)
+	{
+		l_result = NetworkKey(KEY_TYPE_HEX, config.networkKey);
+		l_changes++;
+	}
+
+	if (changes != NULL)
+		*changes = l_changes;
+
+	if (!l_result)
+		return false;
+
+	// Write to flash once and only if a setting changed
+	if (l_changes > 0)
+		return SaveConfiguration();
+
+	return true;
+}
+
+// Reads the managed settings from the mDot (one AT&V) into the shadow so the next ApplyConfiguration() skips settings already held.
+// Returns false if the settings could not be read (unknown settings will be sent).
+boolean LoRamDot::ReadConfiguration()
+{
+	LoRamDotSnapshot l_snapshot;
+
+	return ReadSnapshot(l_snapshot);
+}
+
+// Marks every shadowed setting as unknown so the next ApplyConfiguration() sends them all.
+void LoRamDot::ForgetConfiguration()
+{
+	_shadow = LoRamDotConfig();
+	_networkIdHash = 0;
+	_networkKeyHash = 0;
+}
+
 /////////////////////////////////////////////
 // Network Management Commands
 /////////////////////////////////////////////
@@ -310,7 +1647,14 @@ String LoRamDot::FrequencyBand()
 	String response = "";
 
 	if (SendCommand("AT+FREQ", &response))
+	{
+		if (response.indexOf("868") >= 0)
+			_frequencyBand = FREQUENCY_BAND_EU;
+		else if (response.indexOf("915") >= 0)
+			_frequencyBand = FREQUENCY_BAND_US_AU;
+
 		return response;
+	}
 	else
 	{
 		_lastCommandStatus = false;
@@ -326,7 +1670,7 @@ boolean LoRamDot::FrequencySubBand(byte sub_band)
 {
 	// Check if the sub_band is within the valid range
 	if (sub_band >= 1 && sub_band <= 8)
-		return SendCommand("AT+FSB=" + String(sub_band));
+		return SendSetting("AT+FSB=", sub_band, &_shadow.subBand);
 	else
 	{
 		_lastCommandStatus = false;
@@ -343,7 +1687,7 @@ boolean LoRamDot::PublicNetworkMode(byte mode)
 	// Check if the mode is within the valid range
 	if (mode == 0 || mode == 1)
 	{
-		return SendCommand("AT+PN=" + String(mode));
+		return SendSetting("AT+PN=", mode, &_shadow.publicNetwork);
 	}
 	else
 	{
@@ -360,7 +1704,7 @@ boolean LoRamDot::JoinByteOrder(byte order)
 {
 	// Check if the order is within the valid range
 	if (order == 0 || order == 1)
-		return SendCommand("AT+JBO=" + String(order));
+		return SendCommandValue("AT+JBO=", order);
 	else
 	{
 		_lastCommandStatus = false;
@@ -376,7 +1720,7 @@ boolean LoRamDot::NetworkJoinMode(byte mode)
 {
 	// Check if the mode is within the valid range
 	if (mode >= 0 && mode <= 3)
-		return SendCommand("AT+NJM=" + String(mode));
+		return SendSetting("AT+NJM=", mode, &_shadow.joinMode);
 	else
 	{
 		_lastCommandStatus = false;
@@ -388,9 +1732,27 @@ boolean LoRamDot::NetworkJoinMode(byte mode)
 }
 
 // Join network. For US915 and EU868 models +NI, +NK must match gateway settings in order to join. US915 must also match + FSB setting.
+// A failed join ends the wait as soon as the mDot reports it (COMMAND_STATUS_ID_ERROR).
 boolean LoRamDot::Join()
 {
-	return SendCommand("AT+JOIN");
+	WaitForCommand();
+
+	if (OpenCommand("AT+JOIN", JOIN_FAILURE_LINE))
+		CloseCommand();
+
+	return WaitForResponse(&_lastResponse);
+}
+
+// Sends AT+JOIN and returns immediately. Call Poll() from loop() until the join completes.
+// Returns false (BUSY) if the previous command is still waiting for its response.
+boolean LoRamDot::BeginJoin()
+{
+	if (!OpenCommand("AT+JOIN", JOIN_FAILURE_LINE))
+		return false;
+
+	CloseCommand();
+
+	return true;
 }
 
 // This is the maximum number of join attempts that will be made if none are successful. 0: Disable; 1-255: Retries (Default: 2)
@@ -398,7 +1760,7 @@ boolean LoRamDot::JoinRetries(byte retries)
 {
 	// Check if the retries is within the valid range
 	if (retries >= 0 && retries <= 255)
-		return SendCommand("AT+JR=" + String(retries));
+		return SendSetting("AT+JR=", retries, &_shadow.joinRetries);
 	else
 	{
 		_lastCommandStatus = false;
@@ -416,7 +1778,7 @@ boolean LoRamDot::JoinDelay(byte delay)
 {
 	// Check if the delay is within the valid range
 	if (delay >= 1 && delay <= 15)
-		return SendCommand("AT+JR=" + String(delay));
+		return SendSetting("AT+JD=", delay, &_joinDelay);
 	else
 	{
 		_lastCommandStatus = false;
@@ -442,7 +1804,13 @@ boolean LoRamDot::NetworkID(byte type, String id)
 {
 	// Check if the type and id is within the valid range
 	if ((type == 0 && ((id.length() == 16) || (id.length() == 23))) || (type == 1 && id.length() <= 128))
-		return SendCommand("AT+NI=" + String(type) + "," + id);
+	{
+		boolean l_result = SendCommandValues("AT+NI=", type, ',', id);
+
+		_networkIdHash = (l_result && type == KEY_TYPE_HEX) ? HashHex(id.c_str()) : 0;
+
+		return l_result;
+	}
 	
 	_lastCommandStatus = false;
 	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
@@ -462,7 +1830,13 @@ boolean LoRamDot::NetworkKey(byte type, String key)
 {
 	// Check if the type and key is within the valid range
 	if ((type == 0 && ((key.length() == 32) || (key.length() == 47))) || (type == 1 && key.length() <= 128))
-		return SendCommand("AT+NK=" + String(type) + "," + key);
+	{
+		boolean l_result = SendCommandValues("AT+NK=", type, ',', key);
+
+		_networkKeyHash = (l_result && type == KEY_TYPE_HEX) ? HashHex(key.c_str()) : 0;
+
+		return l_result;
+	}
 	
 	_lastCommandStatus = false;
 	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
@@ -490,7 +1864,7 @@ boolean LoRamDot::TTNAppKey(String key)
 // Enables or disables AES encryption of payload data.
 boolean LoRamDot::AESEncryption(boolean mode)
 {
-	return SendCommand("AT+ENC=" + (mode) ? "1" : "0");
+	return SendCommandValue("AT+ENC=", (mode) ? 1 : 0);
 }
 
 /////////////////////////////////////////////
@@ -503,7 +1877,7 @@ boolean LoRamDot::NetworkAddress(String address)
 {
 	// Check if the address is within the valid range
 	if (address.length() == 11)
-		return SendCommand("AT+NA=" + address);
+		return SendCommandValue("AT+NA=", address);
 	
 	_lastCommandStatus = false;
 	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
@@ -518,7 +1892,7 @@ boolean LoRamDot::NetworkSessionKey(String key)
 {
 	// Check if the key is within the valid range
 	if ((key.length() == 32) || (key.length() == 47))
-		return SendCommand("AT+NSK=" + key);
+		return SendCommandValue("AT+NSK=", key);
 	else
 	{
 		_lastCommandStatus = false;
@@ -535,7 +1909,7 @@ boolean LoRamDot::DataSessionKey(String key)
 {
 	// Check if the key is within the valid range
 	if (key.length() == 32 || key.length() == 47)
-		return SendCommand("AT+DSK=" + key);
+		return SendCommandValue("AT+DSK=", key);
 
 	_lastCommandStatus = false;
 	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
@@ -549,7 +1923,7 @@ boolean LoRamDot::DataSessionKey(String key)
 // 0-4294967295 (Default is 1)
 boolean LoRamDot::UplinkCounter(unsigned long counter)
 {
-	return SendCommand("AT+ULC=" + counter);
+	return SendCommandValue("AT+ULC=", counter);
 }
 
 // A device using MANUAL join mode, it may reject downlink packets if they do not have the correct counter value.
@@ -557,7 +1931,7 @@ boolean LoRamDot::UplinkCounter(unsigned long counter)
 // 0-4294967295 (Default is 1)
 boolean LoRamDot::DownlinkCounter(unsigned long counter)
 {
-	return SendCommand("AT+DLC=" + counter);
+	return SendCommandValue("AT+DLC=", counter);
 }
 
 /////////////////////////////////////////////
@@ -570,8 +1944,9 @@ boolean LoRamDot::NetworkJoinStatus()
 {
 	String l_joinStatus = "";
 
+	// The status follows the command echo
 	if (SendCommand("AT+NJS", &l_joinStatus))
-		return (l_joinStatus == "1") ? true : false;
+		return (ParseResponseNumber(l_joinStatus.c_str()) == 1) ? true : false;
 	else
 		return false;
 
@@ -595,7 +1970,7 @@ boolean LoRamDot::RequireAcknowledgment(byte attempts)
 {
 	// Check if the mode is within the valid range
 	if (attempts >= 0 && attempts <= 8)
-		return SendCommand("AT+ACK=" + String(attempts));
+		return SendSetting("AT+ACK=", attempts, &_shadow.ackAttempts);
 	else
 	{
 		_lastCommandStatus = false;
@@ -613,7 +1988,7 @@ String LoRamDot::NetworkLinkCheck()
 {
 	String l_nlcStatus = "";
 
-	if (SendCommand("AT+PING", &l_nlcStatus))
+	if (SendCommand("AT+NLC", &l_nlcStatus))
 		return l_nlcStatus;
 	else
 		return "";
@@ -626,7 +2001,7 @@ boolean LoRamDot::LinkCheckCount(byte count)
 {
 	// Check if the mode is within the valid range
 	if (count >= 0 && count <= 255)
-		return SendCommand("AT+LCC=" + String(count));
+		return SendCommandValue("AT+LCC=", count);
 	else
 	{
 		_lastCommandStatus = false;
@@ -658,7 +2033,66 @@ boolean LoRamDot::RestoreNetworkSession()
 // (false: Off [Default]; true: On) Preserves the network session information over resets when using auto join mode (AT+NJM). If not using auto join mode, use with the save session command(AT + SS).
 boolean LoRamDot::PreserveSession(boolean preserve)
 {
-	return SendCommand("AT+PS=" + (preserve) ? "1" : "0");
+	return SendCommandValue("AT+PS=", (preserve) ? 1 : 0);
+}
+
+// Start up fast path that avoids a join (seconds of airtime and a join server exchange) after a reset:
+//		1. If the mDot is still joined (only the host restarted) the session is kept.
+//		2. Otherwise the saved session is restored (AT+RS) and checked with NetworkJoinStatus().
+//		3. Only if that fails does the mDot join, and the new session is saved (AT+SS).
+// The session is then saved every setSessionSaveInterval() uplinks. A restored uplink counter can be up to that many
+// uplinks behind, so it is advanced by the interval (AT+ULC) to never repeat a counter the network has already seen.
+// Returns SESSION_ACTIVE, SESSION_RESTORED, SESSION_JOINED or SESSION_FAILED.
+byte LoRamDot::ResumeSession()
+{
+	_sessionManaged = true;
+	_uplinksSinceSave = 0;
+
+	if (NetworkJoinStatus())
+		return SESSION_ACTIVE;
+
+	if (RestoreNetworkSession() && NetworkJoinStatus())
+	{
+		if (_sessionSaveInterval > 1)
+		{
+			String l_counter = "";
+
+			if (SendCommand("AT+ULC", &l_counter))
+				UplinkCounter(ParseResponseNumber(l_counter.c_str()) + _sessionSaveInterval);
+		}
+
+		return SESSION_RESTORED;
+	}
+
+	if (!Join())
+		return SESSION_FAILED;
+
+	SaveNetworkSession();
+
+	return SESSION_JOINED;
+}
+
+// Sets the uplinks between automatic session saves (AT+SS) once ResumeSession() has been called. 0 disables them.
+// Each save writes flash, so the interval trades flash wear against the uplink counter jump after a restore.
+void LoRamDot::setSessionSaveInterval(unsigned int uplinks)
+{
+	_sessionSaveInterval = uplinks;
+}
+
+// Saves the session (AT+SS) if the save interval has passed. Called by Send() and SendBinary() before sending, so the
+// response of the last uplink is not replaced. Call it from loop() when sending asynchronously.
+// Returns false only if a save was due and failed.
+boolean LoRamDot::SaveSessionIfDue()
+{
+	if (!_sessionManaged || _sessionSaveInterval == 0 || _uplinksSinceSave < _sessionSaveInterval)
+		return true;
+
+	if (!SaveNetworkSession())
+		return false;
+
+	_uplinksSinceSave = 0;
+
+	return true;
 }
 
 /////////////////////////////////////////////
@@ -682,21 +2116,7 @@ unsigned long LoRamDot::TransmitNext()
 	String l_transmitNext = ""; // Millisecons (text)
 
 	if (SendCommand("AT+TXN", &l_transmitNext))
-	{
-		l_transmitNext.trim();
-
-		unsigned long result = 0;
-
-		for (unsigned int i = 0; i < l_transmitNext.length(); i++)
-		{
-			char c = l_transmitNext.charAt(i);
-			if (c < '0' || c > '9') break;
-			result *= 10;
-			result += (c - '0');
-		}
-
-		return result;
-	}
+		return ParseResponseNumber(l_transmitNext.c_str());
 	else
 		return 0;
 }
@@ -706,38 +2126,12 @@ unsigned long LoRamDot::TransmitNext()
 unsigned long LoRamDot::TimeOnAir(byte bytes)
 {
 	// Check if the mode is within the valid range
-	if (bytes >= 0 && bytes <= 242)
+	if (bytes <= 242)
 	{
-		String l_onAirTime = ""; // Millisecons (text)
+		if (SendCommandValue("AT+TOA=", bytes))
+			return ParseResponseNumber(_lastResponse.c_str());
 
-		if (SendCommand("AT+TXN", &l_onAirTime))
-		{
-			l_onAirTime.trim();
-
-			if (l_onAirTime.equalsIgnoreCase("ERROR"))
-			{
-				unsigned long result = 0;
-
-				for (unsigned int i = 0; i < l_onAirTime.length(); i++)
-				{
-					char c = l_onAirTime.charAt(i);
-					if (c < '0' || c > '9') break;
-					result *= 10;
-					result += (c - '0');
-				}
-
-				return result;
-			}
-			else
-			{
-				_lastCommandStatus = false;
-				_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
-				_lastCommandStatusId = COMMAND_STATUS_INPUT_OUT_OF_RANGE;
-
-				return 0;
-			}
-
-		}
+		return 0;
 	}
 	
 	_lastCommandStatus = false;
@@ -747,6 +2141,16 @@ unsigned long LoRamDot::TimeOnAir(byte bytes)
 	return 0;
 }
 
+// Calculates the on air time, in milliseconds, locally from the frequency band, data rate and forward error correction last set.
+// Asks the mDot (TimeOnAir()) only if the data rate is unknown.
+unsigned long LoRamDot::EstimateTimeOnAir(byte bytes)
+{
+	if (_dataRate == DATA_RATE_UNKNOWN)
+		return TimeOnAir(bytes);
+
+	return LoRaWANTimeOnAir(_frequencyBand, _dataRate, bytes, _codingRate);
+}
+
 /////////////////////////////////////////////
 // Configuring
 /////////////////////////////////////////////
@@ -762,12 +2166,311 @@ String LoRamDot::SettingsAndStatus()
 		return "";
 }
 
+// AT&V line parser states
+static const byte SNAPSHOT_LABEL = 0;					// Reading the label up to the ':'
+static const byte SNAPSHOT_SPACE = 1;					// Skipping the spaces in front of the value
+static const byte SNAPSHOT_VALUE = 2;					// Reading the value
+
+// Adds a label character to a label hash. Spaces are ignored and case does not matter.
+static constexpr uint32_t SnapshotLabelStep(uint32_t hash, char c)
+{
+	return (c == ' ') ? hash : (uint32_t)((hash ^ (uint32_t)((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c)) * HASH_PRIME);
+}
+
+// Returns the hash of an AT&V label. Evaluated at compile time for the labels below so no label text is stored.
+static constexpr uint32_t SnapshotLabel(const char *label, uint32_t hash = HASH_OFFSET)
+{
+	return (*label == '\0') ? hash : SnapshotLabel(label + 1, SnapshotLabelStep(hash, *label));
+}
+
+// Parses the number in an AT&V value ("on", "off", "115200", "10 s", "DI8"). Returns false if there is none.
+static boolean SnapshotNumber(const char *value, uint32_t *number)
+{
+	if (strcmp(value, "on") == 0)
+	{
+		*number = 1;
+		return true;
+	}
+	if (strcmp(value, "off") == 0)
+	{
+		*number = 0;
+		return true;
+	}
+
+	while (*value != '\0' && !isDigit(*value))
+		value++;
+
+	if (*value == '\0')
+		return false;
+
+	*number = strtoul(value, NULL, 10);
+	return true;
+}
+
+// Parses the number in an AT&V value into a byte setting (CONFIG_UNSET if there is none).
+static byte SnapshotByte(const char *value)
+{
+	uint32_t l_number;
+
+	return SnapshotNumber(value, &l_number) ? (byte)l_number : CONFIG_UNSET;
+}
+
+// Parses the number in an AT&V value into a long setting (0 if there is none).
+static uint32_t SnapshotLong(const char *value)
+{
+	uint32_t l_number;
+
+	return SnapshotNumber(value, &l_number) ? l_number : 0;
+}
+
+// Starts parsing a new AT&V line.
+void LoRamDot::ResetSnapshotLine()
+{
+	_snapshotLabel = HASH_OFFSET;
+	_snapshotHexHash = HASH_OFFSET;
+	_snapshotValueLength = 0;
+	_snapshotState = SNAPSHOT_LABEL;
+}
+
+// Parses a received AT&V byte into the snapshot.
+// Each "Label: value" line is reduced to a hash of the label and the first LORAMDOT_SNAPSHOT_VALUE_SIZE characters of the value
+// (plus a hash of its hex digits for the keys) so the table is never held in RAM. Lines without a ':' (echo, OK) are ignored.
+void LoRamDot::ParseSnapshotByte(char c)
+{
+	if (c == '\n')
+	{
+		if (_snapshotState == SNAPSHOT_VALUE)
+			StoreSnapshotValue();
+
+		ResetSnapshotLine();
+		return;
+	}
+
+	if (c == '\r')
+		return;
+
+	switch (_snapshotState)
+	{
+	case SNAPSHOT_LABEL:
+		if (c == ':')
+			_snapshotState = SNAPSHOT_SPACE;
+		else
+			_snapshotLabel = SnapshotLabelStep(_snapshotLabel, c);
+		break;
+
+	case SNAPSHOT_SPACE:
+		if (c == ' ' || c == '\t')
+			break;
+
+		_snapshotState = SNAPSHOT_VALUE;
+		// Fall through
+
+	case SNAPSHOT_VALUE:
+		if (_snapshotValueLength < LORAMDOT_SNAPSHOT_VALUE_SIZE)
+			_snapshotValue[_snapshotValueLength++] = c;
+
+		_snapshotHexHash = HashHexStep(_snapshotHexHash, c);
+		break;
+	}
+}
+
+// Stores the completed line's value in the snapshot field named by its label. Unknown labels are ignored.
+void LoRamDot::StoreSnapshotValue()
+{
+	// Trailing spaces are not part of the value
+	while (_snapshotValueLength > 0 && _snapshotValue[_snapshotValueLength - 1] == ' ')
+		_snapshotValueLength--;
+
+	_snapshotValue[_snapshotValueLength] = '\0';
+
+	if (_statistics != NULL)
+	{
+		StoreStatisticsValue();
+		return;
+	}
+
+	const char *l_value = _snapshotValue;
+
+	switch (_snapshotLabel)
+	{
+	case SnapshotLabel("Frequency Band"):
+		if (strstr(l_value, "868") != NULL)
+			_snapshot->frequencyBand = FREQUENCY_BAND_EU;
+		else if (strstr(l_value, "915") != NULL)
+			_snapshot->frequencyBand = FREQUENCY_BAND_US_AU;
+		break;
+	case SnapshotLabel("Frequency Sub Band"):
+		_snapshot->subBand = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Public Network"):
+		_snapshot->publicNetwork = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Start Up Mode"):
+		_snapshot->startUpMode = (strcmp(l_value, "SERIAL_DATA") == 0) ? DATA_MODE_SERIAL : DATA_MODE_AT;
+		break;
+	case SnapshotLabel("Network Address"):
+		_snapshot->networkAddress = strtoul(l_value, NULL, 16);
+		break;
+	case SnapshotLabel("Network ID"):
+		_snapshot->networkIdHash = HashHexFinish(_snapshotHexHash);
+		break;
+	case SnapshotLabel("Network Key"):
+		_snapshot->networkKeyHash = HashHexFinish(_snapshotHexHash);
+		break;
+	case SnapshotLabel("Network Join Mode"):
+		if (strcmp(l_value, "MANUAL") == 0)
+			_snapshot->joinMode = NETWORK_JOIN_MODE_MANUAL;
+		else if (strcmp(l_value, "OTA") == 0)
+			_snapshot->joinMode = NETWORK_JOIN_MODE_OTA;
+		else if (strcmp(l_value, "AUTO_OTA") == 0)
+			_snapshot->joinMode = NETWORK_JOIN_MODE_AUTO_OTA;
+		else if (strcmp(l_value, "PEER_TO_PEER") == 0)
+			_snapshot->joinMode = NETWORK_JOIN_MODE_PEER_TO_PEER;
+		else
+			_snapshot->joinMode = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Network Join Retries"):
+		_snapshot->joinRetries = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Preserve Session"):
+		_snapshot->preserveSession = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Link Check Count"):
+		_snapshot->linkCheckCount = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Link Check Threshold"):
+		_snapshot->linkCheckThreshold = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Error Correction"):
+		_snapshot->forwardErrorCorrection = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("ACK Retries"):
+		_snapshot->ackAttempts = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Adaptive Data Rate"):
+		_snapshot->adaptiveDataRate = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Command Echo"):
+		_snapshot->commandEcho = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Tx Data Rate"):
+		_snapshot->txDataRate = ParseDataRate(l_value, (_snapshot->frequencyBand != CONFIG_UNSET) ? _snapshot->frequencyBand : _frequencyBand);
+		break;
+	case SnapshotLabel("Rx Data Rate"):
+		_snapshot->rxDataRate = ParseDataRate(l_value, (_snapshot->frequencyBand != CONFIG_UNSET) ? _snapshot->frequencyBand : _frequencyBand);
+		break;
+	case SnapshotLabel("Tx Power"):
+		_snapshot->txPower = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Tx Wait"):
+		_snapshot->txWait = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Receive Output"):
+		_snapshot->receiveOutput = (strcmp(l_value, "RAW") == 0) ? DATA_FORMAT_RAW : DATA_FORMAT_HEX;
+		break;
+	case SnapshotLabel("Serial Baud Rate"):
+		_snapshot->serialBaudRate = SnapshotLong(l_value);
+		break;
+	case SnapshotLabel("Wake Mode"):
+		_snapshot->wakeMode = (strcmp(l_value, "INTERRUPT") == 0) ? 1 : (strcmp(l_value, "INTERVAL") == 0) ? 0 : SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Wake Interval"):
+		_snapshot->wakeInterval = SnapshotLong(l_value);
+		break;
+	case SnapshotLabel("Wake Delay"):
+		_snapshot->wakeDelay = SnapshotLong(l_value);
+		break;
+	case SnapshotLabel("Wake Timeout"):
+		_snapshot->wakeTimeout = SnapshotLong(l_value);
+		break;
+	case SnapshotLabel("Wake Pin"):
+		_snapshot->wakePin = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Class"):
+	case SnapshotLabel("Device Class"):
+		_snapshot->deviceClass = l_value[0];
+		break;
+	case SnapshotLabel("App Port"):
+	case SnapshotLabel("Application Port"):
+		_snapshot->applicationPort = SnapshotByte(l_value);
+		break;
+	case SnapshotLabel("Maximum Size"):
+		_snapshot->maxPayload = SnapshotByte(l_value);
+		break;
+	default:
+		return;
+	}
+
+	_snapshot->fields++;
+}
+
+// Updates the library state from a completed snapshot and stops parsing.
+// The data rate, band, coding rate and receive format the library tracks, and the configuration shadow, follow the mDot.
+void LoRamDot::FinishSnapshot()
+{
+	LoRamDotSnapshot *l_snapshot = _snapshot;
+
+	_snapshot = NULL;
+
+	if (_lastCommandStatusId != COMMAND_STATUS_ID_OK || l_snapshot->fields == 0)
+		return;
+
+	if (l_snapshot->frequencyBand != CONFIG_UNSET)
+		_frequencyBand = l_snapshot->frequencyBand;
+	if (l_snapshot->forwardErrorCorrection >= FORWARD_ERROR_CORRECTION_REDUNDANCY_5_BITS && l_snapshot->forwardErrorCorrection <= FORWARD_ERROR_CORRECTION_REDUNDANCY_8_BITS)
+		_codingRate = l_snapshot->forwardErrorCorrection;
+	if (l_snapshot->receiveOutput != CONFIG_UNSET)
+		_receiveFormat = l_snapshot->receiveOutput;
+
+	_dataRate = (l_snapshot->txDataRate == CONFIG_UNSET) ? DATA_RATE_UNKNOWN : l_snapshot->txDataRate;
+
+	_shadow.dataRate = l_snapshot->txDataRate;
+	_shadow.publicNetwork = l_snapshot->publicNetwork;
+	_shadow.joinMode = l_snapshot->joinMode;
+	_shadow.subBand = l_snapshot->subBand;
+	_shadow.ackAttempts = l_snapshot->ackAttempts;
+	_shadow.adaptiveDataRate = l_snapshot->adaptiveDataRate;
+	_shadow.transmitPower = l_snapshot->txPower;
+	_shadow.applicationPort = l_snapshot->applicationPort;
+	_shadow.joinRetries = l_snapshot->joinRetries;
+	_networkIdHash = l_snapshot->networkIdHash;
+	_networkKeyHash = l_snapshot->networkKeyHash;
+}
+
+// Sends AT&V and returns immediately. snapshot is filled as Poll() reads the table.
+// Returns false (BUSY) if the previous command is still waiting for its response.
+boolean LoRamDot::BeginSnapshot(LoRamDotSnapshot &snapshot)
+{
+	if (!OpenCommand("AT&V"))
+		return false;
+
+	snapshot = LoRamDotSnapshot();
+	_snapshot = &snapshot;
+	ResetSnapshotLine();
+
+	CloseCommand();
+
+	return true;
+}
+
+// Reads the device settings with a single AT&V, parsed into snapshot line by line as the table is received.
+// Returns true if the table was received.
+boolean LoRamDot::ReadSnapshot(LoRamDotSnapshot &snapshot)
+{
+	WaitForCommand();
+
+	if (!BeginSnapshot(snapshot))
+		return false;
+
+	return WaitForResponse(&_lastResponse);
+}
+
 // Sets the device class. The LoRaWAN 1.0 specification defines the three device classes, Class A, B and C. Note : Currently only Class A is supported.
 boolean LoRamDot::DeviceClass(String deviceClass)
 {
 	// Check if the mode is within the valid range
 	if (deviceClass == DEVICE_CLASS_A || deviceClass == DEVICE_CLASS_B || deviceClass == DEVICE_CLASS_C)
-		return SendCommand("AT+DC=" + deviceClass);
+		return SendCommandValue("AT+DC=", deviceClass);
 	else
 	{
 		_lastCommandStatus = false;
@@ -784,7 +2487,7 @@ boolean LoRamDot::ApplicationPort(byte applicationPort)
 {
 	// Check if the mode is within the valid range
 	if (applicationPort >= 1 && applicationPort <= 223)
-		return SendCommand("AT+AP=" + String(applicationPort));
+		return SendSetting("AT+AP=", applicationPort, &_shadow.applicationPort);
 	else
 	{
 		_lastCommandStatus = false;
@@ -801,7 +2504,7 @@ boolean LoRamDot::TransmitPower(byte transmitPower)
 {
 	// Check if the mode is within the valid range
 	if (transmitPower >= 0 && transmitPower <= 20)
-		return SendCommand("AT=TXP" + String(transmitPower));
+		return SendSetting("AT+TXP=", transmitPower, &_shadow.transmitPower);
 	else
 	{
 		_lastCommandStatus = false;
@@ -816,14 +2519,14 @@ boolean LoRamDot::TransmitPower(byte transmitPower)
 // Note: Transmitted signals are inverted so motes/gateways do not see other mote/gateway packets.
 boolean LoRamDot::TransmitInverted(boolean inverted)
 {
-	return SendCommand("AT+TXI=" + (inverted) ? "1" : "0");
+	return SendCommandValue("AT+TXI=", (inverted) ? 1 : 0);
 }
 
 // Sets RX signal inverted. inverted: false = Not Inverted (default), 1 = Inverted 
 // Note: Transmitted signals are inverted so motes/gateways do not see other mote/gateway packets.
 boolean LoRamDot::ReceiveSignalInverted(boolean inverted)
 {
-	return SendCommand("AT+RXI=" + (inverted) ? "1" : "0");
+	return SendCommandValue("AT+RXI=", (inverted) ? 1 : 0);
 }
 
 // Allows the dot to use non-default rx windows, if required by the network it is attempting to communicate with.
@@ -834,7 +2537,7 @@ boolean LoRamDot::ReceiveDelay(byte delay)
 {
 	// Check if the mode is within the valid range
 	if (delay >= 1 && delay <= 15)
-		return SendCommand("AT=TXP" + String(delay));
+		return SendSetting("AT+RXD=", delay, &_receiveDelay);
 	else
 	{
 		_lastCommandStatus = false;
@@ -858,7 +2561,14 @@ boolean LoRamDot::ForwardErrorCorrection(byte redundancy)
 		|| redundancy == FORWARD_ERROR_CORRECTION_REDUNDANCY_6_BITS
 		|| redundancy == FORWARD_ERROR_CORRECTION_REDUNDANCY_7_BITS
 		|| redundancy == FORWARD_ERROR_CORRECTION_REDUNDANCY_8_BITS)
-		return SendCommand("AT=FEC" + String(redundancy));
+	{
+		if (!SendCommandValue("AT+FEC=", redundancy))
+			return false;
+
+		_codingRate = redundancy;
+
+		return true;
+	}
 	else
 	{
 		_lastCommandStatus = false;
@@ -873,14 +2583,14 @@ boolean LoRamDot::ForwardErrorCorrection(byte redundancy)
 // enabled: false = CRC disabled, true = CRC enabled(Default)
 boolean LoRamDot::CyclicalRedundancyCheck(boolean enabled)
 {
-	return SendCommand("AT+CRC=" + (enabled) ? "1" : "0");
+	return SendCommandValue("AT+CRC=", (enabled) ? 1 : 0);
 }
 
 // Enable or disable adaptive data rate for your device. For more information on Adpative Data Rate, refer to your device's Developer Guide.
 // enabled: false = ADR disabled (Default), true = ADR enabled
 boolean LoRamDot::AdaptiveDataRate(boolean enabled)
 {
-	return SendCommand("AT+ADR=" + (enabled) ? "1" : "0");
+	return SendSetting("AT+ADR=", (enabled) ? 1 : 0, &_shadow.adaptiveDataRate);
 }
 
 // Sets the current data rate to use, DR0-DR15 can be entered as input in addition to (7-12) or (SF_7-SF_12).
@@ -912,9 +2622,17 @@ boolean LoRamDot::TXDataRate(String dataRate)
 {
 	// Check if the mode is within the valid range
 	if ((dataRate.startsWith("DR") && isDigit(dataRate.charAt(2)))
-		|| (dataRate.startsWith("SF_") && isDigit(dataRate.substring(3).charAt(3)))
+		|| (dataRate.startsWith("SF_") && isDigit(dataRate.charAt(3)))
 		|| isDigit(dataRate.charAt(0)))
-		return SendCommand("AT+TXDR=" + dataRate);
+	{
+		if (!SendCommandValue("AT+TXDR=", dataRate))
+			return false;
+
+		_dataRate = ParseDataRate(dataRate.c_str(), _frequencyBand);
+		_shadow.dataRate = (_dataRate == DATA_RATE_UNKNOWN) ? CONFIG_UNSET : _dataRate;
+
+		return true;
+	}
 	else
 	{
 		_lastCommandStatus = false;
@@ -931,11 +2649,41 @@ String LoRamDot::SessionDataRate()
 	String l_sessionDataRate = "";
 
 	if (SendCommand("AT+SDR", &l_sessionDataRate))
+	{
+		byte l_dataRate = ParseDataRate(l_sessionDataRate.c_str(), _frequencyBand);
+
+		if (l_dataRate != DATA_RATE_UNKNOWN)
+			_dataRate = l_dataRate;
+
 		return l_sessionDataRate;
+	}
 	else
 		return "";
 }
 
+// Returns the frequency band used for payload sizes (FREQUENCY_BAND_US_AU or FREQUENCY_BAND_EU).
+byte LoRamDot::FrequencyBandId()
+{
+	return _frequencyBand;
+}
+
+// Returns the data rate (0-15) last set with TXDataRate() or read with SessionDataRate(). DATA_RATE_UNKNOWN if neither has been called.
+byte LoRamDot::CurrentDataRate()
+{
+	return _dataRate;
+}
+
+// Returns the maximum payload in bytes for the current data rate and frequency band (242 if the data rate is unknown).
+byte LoRamDot::MaxPayload()
+{
+	if (_frequencyBand == FREQUENCY_BAND_EU && _dataRate < sizeof(MAX_PAYLOAD_EU))
+		return MAX_PAYLOAD_EU[_dataRate];
+	if (_frequencyBand == FREQUENCY_BAND_US_AU && _dataRate < sizeof(MAX_PAYLOAD_US_AU))
+		return MAX_PAYLOAD_US_AU[_dataRate];
+
+	return PAYLOAD_SIZE_MAX;
+}
+
 // Repeats each frame as many times as indicated or until downlink from network server is received. This setting
 //		increases redundancy to increase change of packet to be received by the gateway at the expense of increasing
 //		network congestion.When enabled, debug output shows multiple packets being sent.On the Conduit, an MQTT
@@ -945,7 +2693,7 @@ boolean LoRamDot::RepeatPacket(byte repeats)
 {
 	// Check if the mode is within the valid range
 	if (repeats >= 0 && repeats <= 15)
-		return SendCommand("AT=REP" + String(repeats));
+		return SendCommandValue("AT+REP=", repeats);
 	else
 	{
 		_lastCommandStatus = false;
@@ -966,9 +2714,13 @@ boolean LoRamDot::RepeatPacket(byte repeats)
 // data: Up to 242 bytes of data or the maximum payload size based on spreading factor (See AT+TXDR)
 boolean LoRamDot::Send(String data)
 {
-	// Check if the data length is within the valid range
-	if (data.length() <= 242)
-		return SendCommand("AT+SEND=" + data);
+	// Check if the data length is within the valid range for the data rate
+	if (data.length() <= MaxPayload())
+	{
+		SaveSessionIfDue();
+
+		return SendCommandValue("AT+SEND=", data);
+	}
 	else
 	{
 		_lastCommandStatus = false;
@@ -983,12 +2735,13 @@ boolean LoRamDot::Send(String data)
 // data: String of up to 242 eight bit hexadecimal values. Each value may range from 00 to FF.
 boolean LoRamDot::SendBinary(String data)
 {
-	////////////////////////////////////////////////////////////////////////
-	///// TODO: Add check against the length for reduced payload sizes. ////
-	////////////////////////////////////////////////////////////////////////
-	// Check if the data length is within the valid range
-	if (data.length() <= 242)
-		return SendCommand("AT+SENDB=" + data);
+	// Check if the data length (two hex digits per byte) is within the valid range for the data rate
+	if (data.length() <= 2 * (unsigned int)MaxPayload())
+	{
+		SaveSessionIfDue();
+
+		return SendCommandValue("AT+SENDB=", data);
+	}
 	
 	_lastCommandStatus = false;
 	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
@@ -997,20 +2750,61 @@ boolean LoRamDot::SendBinary(String data)
 	return false;
 }
 
-// Functions as the +SEND command, but sends hexadecimal data.
-// data: String of up to 242 eight bit hexadecimal values. Each value may range from 00 to FF.
-boolean LoRamDot::SendBinary(byte data[])
+// Functions as the +SEND command, but sends the bytes as hexadecimal data.
+// The hex is streamed straight into the AT+SENDB command line.
+// data: Up to 242 bytes or the maximum payload for the data rate (See MaxPayload()). length: Number of bytes in data.
+boolean LoRamDot::SendBinary(const uint8_t *data, size_t length)
+{
+	// Check if the data length is within the valid range for the data rate
+	if (length <= MaxPayload() && (data != NULL || length == 0))
+	{
+		SaveSessionIfDue();
+
+		WaitForCommand();
+
+		if (!OpenCommand("AT+SENDB="))
+			return false;
+
+		CloseCommand(PrintHex(*_Serial, data, length));
+
+		return WaitForResponse(&_lastResponse);
+	}
+
+	_lastCommandStatus = false;
+	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
+	_lastCommandStatusId = COMMAND_STATUS_INPUT_OUT_OF_RANGE;
+
+	return false;
+}
+
+// Functions as the +SEND command, but sends the bytes printed by data as hexadecimal data.
+// data: Printable object that prints up to 242 bytes. printTo() is called twice (once to count the bytes).
+boolean LoRamDot::SendBinary(const Printable &data)
 {
-	// Convert to HEX String
-	String hexData = "";
+	// Count the bytes first so an oversized payload is rejected before anything is sent
+	ByteCounter l_counter;
+	data.printTo(l_counter);
 
-	for (unsigned long count = 0; count < size_t(data); count++)
+	if (l_counter.count <= MaxPayload())
 	{
-		hexData += String(data[count], HEX);
+		SaveSessionIfDue();
+
+		WaitForCommand();
+
+		if (!OpenCommand("AT+SENDB="))
+			return false;
+
+		HexEncoder l_encoder(*_Serial);
+		CloseCommand(2 * data.printTo(l_encoder));
+
+		return WaitForResponse(&_lastResponse);
 	}
 
-	// Send
-	return SendBinary(hexData);
+	_lastCommandStatus = false;
+	_lastCommandStatusMessage = "INPUT-OUT-OF-RANGE";
+	_lastCommandStatusId = COMMAND_STATUS_INPUT_OUT_OF_RANGE;
+
+	return false;
 }
 
 /////////////////////////////////////////////
@@ -1028,6 +2822,26 @@ String LoRamDot::ReceiveOnce()
 		return "";
 }
 
+// Decodes the last payload received straight into buffer as it is read from the serial stream and returns the number of bytes stored.
+// Hex output (DATA_FORMAT_HEX) is decoded to bytes; raw output (DATA_FORMAT_RAW) is copied as is. Bytes beyond capacity are dropped.
+// The output format is the one last set with ReceiveOutput(). In raw mode a payload containing "OK\r\n" ends the response early.
+size_t LoRamDot::ReceiveOnce(uint8_t *buffer, size_t capacity)
+{
+	WaitForCommand();
+
+	if (!OpenCommand("AT+RECV"))
+		return 0;
+
+	CapturePayload(buffer, capacity);
+	CloseCommand();
+
+	boolean l_received = WaitForResponse(&_lastResponse);
+
+	FinishPayload();
+
+	return l_received ? _payloadLength : 0;
+}
+
 // Formats the receive data output. Data is either processed into hexadecimal data or left unprocessed/raw.
 // Hexadecimal outputs the byte values in the response.Raw / Unprocessed outputs the actual bytes on the serial interface.
 // format: DATA_FORMAT_HEX = 0, DATA_FORMAT_RAW = 1. 
@@ -1035,7 +2849,14 @@ boolean LoRamDot::ReceiveOutput(byte format)
 {
 	// Check if the format is within the valid range
 	if (format == 0 || format == 1)
-		return SendCommand("AT+RXO=" + String(format));
+	{
+		if (!SendCommandValue("AT+RXO=", format))
+			return false;
+
+		_receiveFormat = format;
+
+		return true;
+	}
 	else
 	{
 		_lastCommandStatus = false;
@@ -1046,6 +2867,12 @@ boolean LoRamDot::ReceiveOutput(byte format)
 	}
 }
 
+// Enables or disables unsolicited response codes. When enabled the mDot sends RECV (EVENT_DOWNLINK) when a packet is received.
+boolean LoRamDot::UnsolicitedResponses(boolean enabled)
+{
+	return SendCommandValue("AT+URC=", (enabled) ? 1 : 0);
+}
+
 // Indicates there is at least one packet pending on the gateway for this end device. This indication is communicated
 // to the end device in any packet coming from the server.Each packet contains a data pending bit.
 boolean LoRamDot::DataPending()
@@ -1064,7 +2891,7 @@ boolean LoRamDot::TransmitWait(boolean wait)
 {
 	// Check if the wait is within the valid range
 	if (wait == 0 || wait == 1)
-		return SendCommand("AT+TXW=" + String(wait));
+		return SendCommandValue("AT+TXW=", wait);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1119,6 +2946,154 @@ String LoRamDot::SignalToNoiseRatio()
 		return "";
 }
 
+// Stores the completed AT&S line's value in the statistics count named by its label. Unknown labels are ignored.
+void LoRamDot::StoreStatisticsValue()
+{
+	uint32_t l_count = SnapshotLong(_snapshotValue);
+
+	switch (_snapshotLabel)
+	{
+	case SnapshotLabel("Join Attempts"):
+		_statistics->joinAttempts = l_count;
+		break;
+	case SnapshotLabel("Join Fails"):
+		_statistics->joinFails = l_count;
+		break;
+	case SnapshotLabel("Up Packets"):
+		_statistics->upPackets = l_count;
+		break;
+	case SnapshotLabel("Down Packets"):
+		_statistics->downPackets = l_count;
+		break;
+	case SnapshotLabel("Missed Acks"):
+		_statistics->missedAcks = l_count;
+		break;
+	case SnapshotLabel("CRC Errors"):
+		_statistics->crcErrors = l_count;
+		break;
+	default:
+		return;
+	}
+
+	_statistics->fields++;
+}
+
+// Reads the device statistics (AT&S) into statistics, parsed line by line as the response is received.
+// Returns true if the statistics were received.
+boolean LoRamDot::ReadStatistics(LoRamDotStatistics &statistics)
+{
+	WaitForCommand();
+
+	if (!OpenCommand("AT&S"))
+		return false;
+
+	statistics = LoRamDotStatistics();
+	_statistics = &statistics;
+	ResetSnapshotLine();
+
+	CloseCommand();
+
+	return WaitForResponse(&_lastResponse);
+}
+
+// AT+RSSI / AT+SNR parser states
+static const byte SIGNAL_LINE_START = 0;				// At the start of a line
+static const byte SIGNAL_BETWEEN = 1;					// Between numbers
+static const byte SIGNAL_ECHO = 2;						// In the command echo line (ignored)
+static const byte SIGNAL_SIGN = 3;						// After a '-'
+static const byte SIGNAL_INTEGER = 4;					// In the integer digits
+static const byte SIGNAL_FRACTION = 5;					// After the '.' (the first digit is kept in tenths)
+static const byte SIGNAL_FRACTION_REST = 6;				// In the fraction digits that are dropped
+
+// Sends AT+RSSI or AT+SNR and parses the four values (last, minimum, maximum, average) scaled by 1 or 10.
+// The values are parsed as Poll() reads the response, like the AT&V snapshot, so no strings are created.
+boolean LoRamDot::ReadSignal(const char *command, LoRamDotSignal *signal, byte scale)
+{
+	WaitForCommand();
+
+	if (!OpenCommand(command))
+		return false;
+
+	_signal = signal;
+	_signalScale = scale;
+	_signalFields = 0;
+	_signalState = SIGNAL_LINE_START;
+
+	CloseCommand();
+
+	return WaitForResponse(&_lastResponse);
+}
+
+// Parses a received AT+RSSI or AT+SNR byte into the signal's next value.
+// Numbers are signed decimals ("-47", "7.5") scaled by 1 or 10 (tenths); everything between them is skipped.
+void LoRamDot::ParseSignalByte(char c)
+{
+	if (_signalFields == 4)
+		return;
+
+	if (_signalState >= SIGNAL_INTEGER)
+	{
+		if (isDigit(c))
+		{
+			if (_signalState == SIGNAL_INTEGER)
+				_signalValue = _signalValue * 10 + (c - '0');
+			else if (_signalState == SIGNAL_FRACTION)
+			{
+				if (_signalScale == 10)
+					_signalValue += c - '0';
+
+				_signalState = SIGNAL_FRACTION_REST;
+			}
+
+			return;
+		}
+
+		if (_signalState == SIGNAL_INTEGER)
+			_signalValue *= _signalScale;
+
+		if (c == '.' && _signalState == SIGNAL_INTEGER)
+		{
+			_signalState = SIGNAL_FRACTION;
+			return;
+		}
+
+		// The number is complete
+		int16_t *l_values[4] = { &_signal->last, &_signal->minimum, &_signal->maximum, &_signal->average };
+
+		*l_values[_signalFields++] = (int16_t)(_signalNegative ? -_signalValue : _signalValue);
+		_signalState = SIGNAL_BETWEEN;
+	}
+
+	if (c == '\n')
+		_signalState = SIGNAL_LINE_START;
+	else if (_signalState == SIGNAL_ECHO)
+		return;
+	else if (_signalState == SIGNAL_LINE_START && c == 'A')
+		_signalState = SIGNAL_ECHO;
+	else if (c == '-')
+		_signalState = SIGNAL_SIGN;
+	else if (isDigit(c))
+	{
+		_signalNegative = (_signalState == SIGNAL_SIGN);
+		_signalValue = c - '0';
+		_signalState = SIGNAL_INTEGER;
+	}
+	else
+		_signalState = SIGNAL_BETWEEN;
+}
+
+// Reads the RSSI of the packets received since the last reset (AT+RSSI) in dBm.
+boolean LoRamDot::ReadSignalStrength(LoRamDotSignal &rssi)
+{
+	return ReadSignal("AT+RSSI", &rssi, 1);
+}
+
+// Reads the SNR of the packets received since the last reset (AT+SNR) in tenths of a dB.
+boolean LoRamDot::ReadSignalToNoiseRatio(LoRamDotSignal &snr)
+{
+	return ReadSignal("AT+SNR", &snr, 10);
+}
+
 /////////////////////////////////////////////
 // Serial Data Mode
 /////////////////////////////////////////////
@@ -1132,6 +3107,24 @@ boolean LoRamDot::SerialDataMode()
 	return SendCommand("AT+SD");
 }
 
+// Sends the +++ escape sequence and waits for the OK of AT command mode. Data the mDot has not yet sent is discarded.
+// The sequence has no line ending. It is only recognised as an escape while the mDot is awake and its buffer is empty.
+boolean LoRamDot::EscapeSerialDataMode()
+{
+	WaitForCommand();
+
+	if (OpenCommand(SERIAL_DATA_ESCAPE))
+		CloseCommand(0, false);
+
+	return WaitForResponse(&_lastResponse);
+}
+
+// Returns the serial stream the mDot is on, to write application data in serial data mode (see LoRamDotDataWriter).
+Stream &LoRamDot::SerialStream()
+{
+	return *_Serial;
+}
+
 // Configures which operation mode the end device powers up in, either AT command mode or serial data mode.
 //		- AT Command mode : The end device powers up or resets in command mode.AT commands are used to send and receive data.
 //		- Serial data mode : Allows the end device to send and receive data without entering AT commands.Data
@@ -1142,7 +3135,7 @@ boolean LoRamDot::StartupMode(byte dataMode)
 {
 	// Check if the dataMode is within the valid range
 	if (dataMode == 0 || dataMode == 1)
-		return SendCommand("AT+SMODE=" + String(dataMode));
+		return SendCommandValue("AT+SMODE=", dataMode);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1159,7 +3152,7 @@ boolean LoRamDot::SerialDataClearOnError(boolean discardBuffer)
 {
 	// Check if the discardBuffer is within the valid range
 	if (discardBuffer == 0 || discardBuffer == 1)
-		return SendCommand("AT+SDCE=" + String(discardBuffer));
+		return SendCommandValue("AT+SDCE=", discardBuffer);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1180,7 +3173,7 @@ boolean LoRamDot::SleepMode(byte sleepMode)
 {
 	// Check if the sleepMode is within the valid range
 	if (sleepMode == 0 || sleepMode == 1)
-		return SendCommand("AT+SLEEP=" + String(sleepMode));
+		return SendCommandValue("AT+SLEEP=", sleepMode);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1196,7 +3189,7 @@ boolean LoRamDot::WakeMode(byte wakeMode)
 {
 	// Check if the wakeMode is within the valid range
 	if (wakeMode == 0 || wakeMode == 1)
-		return SendCommand("AT+WM=" + String(wakeMode));
+		return SendCommandValue("AT+WM=", wakeMode);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1214,7 +3207,7 @@ boolean LoRamDot::WakeInterval(unsigned long interval)
 {
 	// Check if the interval is within the valid range
 	if (interval >= 2 && interval <= 2147483647)
-		return SendCommand("AT+WI=" + String(interval));
+		return SendCommandValue("AT+WI=", interval);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1229,12 +3222,12 @@ boolean LoRamDot::WakeInterval(unsigned long interval)
 //	expires, the device goes back to sleep.If the device received at least one character before this timer expires, the
 //	device continues to read input until either the payload is reached or the + WTO timer expires at which time it sends
 //	the collected data and goes to sleep.
-// delay: 2-2147483647 seconds (Default is 100)
+// delay: 2-2147483647 milliseconds (Default is 100)
 boolean LoRamDot::WakeDelay(unsigned long delay)
 {
 	// Check if the delay is within the valid range
 	if (delay >= 2 && delay <= 2147483647)
-		return SendCommand("AT+WD=" + String(delay));
+		return SendCommandValue("AT+WD=", delay);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1252,7 +3245,7 @@ boolean LoRamDot::WakeTimeout(unsigned long timeout)
 {
 	// Check if the timeout is within the valid range
 	if (timeout >= 2 && timeout <= 65000)
-		return SendCommand("AT+WTO=" + String(timeout));
+		return SendCommandValue("AT+WTO=", timeout);
 	else
 	{
 		_lastCommandStatus = false;
@@ -1269,7 +3262,7 @@ boolean LoRamDot::AntennaGain(int gain)
 {
 	// Check if the gain is within the valid range
 	if (gain >= -128 && gain <= 127)
-		return SendCommand("AT+ANT=" + String(gain));
+		return SendCommandValue("AT+ANT=", gain);
 	else
 	{
 		_lastCommandStatus = false;
@@ -17,9 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifndef _LORAMDOT_h
 	#define _LORAMDOT_h
-#endif
+
 #if defined(ARDUINO) && ARDUINO >= 100
-	#include "arduino.h"
+	#include "Arduino.h"
 #else
 	#include "WProgram.h"
 #endif
@@ -33,6 +33,89 @@ const boolean ENABLED = 1;								// Enabled
 const int COMMAND_STATUS_ID_OK = 0;						// Command Status was OK.
 const int COMMAND_STATUS_ID_TIMED_OUT = 1;				// Command Status was Timed-Out.
 const int COMMAND_STATUS_INPUT_OUT_OF_RANGE = 2;		// Command Status was that the Input to the function to call the command was out of range.
+const int COMMAND_STATUS_ID_BUSY = 3;					// Command Status was that another command was still waiting for its response.
+const int COMMAND_STATUS_ID_ERROR = 4;					// Command Status was that the mDot answered ERROR (or a failure line). The status message holds the error detail.
+
+														// Command States (asynchronous commands)
+const byte COMMAND_STATE_IDLE = 0;						// No command has been sent
+const byte COMMAND_STATE_WAITING = 1;					// Command sent and waiting for the response
+const byte COMMAND_STATE_COMPLETE = 2;					// Command completed. See LastCommandStatusId() for the outcome.
+
+typedef void (*CommandCallback)(int statusId);			// Called with the status ID when an asynchronous command completes
+
+														// Events (lines classified by Poll(), see setEventCallback())
+const byte EVENT_DOWNLINK = 0;							// A downlink was received ("RECV", see UnsolicitedResponses()). Read it with ReceiveOnce().
+const byte EVENT_JOINED = 1;							// The network was joined
+const byte EVENT_JOIN_FAILED = 2;						// A join attempt failed
+const byte EVENT_RESET = 3;								// The mDot restarted (start up banner)
+const byte EVENT_ERROR = 4;								// The mDot reported an error
+const byte EVENT_UNSOLICITED = 5;						// Any other line received outside a command
+const byte EVENT_COUNT = 6;								// Number of events
+
+typedef void (*EventCallback)(byte event, const char *line);	// Called with the event (EVENT_*) and the line that raised it (truncated to LORAMDOT_EVENT_LINE_SIZE)
+
+#ifndef LORAMDOT_EVENT_LINE_SIZE
+	#if defined(__AVR__)
+		#define LORAMDOT_EVENT_LINE_SIZE 32				// Characters of a line kept to classify it and pass to the event callback
+	#else
+		#define LORAMDOT_EVENT_LINE_SIZE 80				// Characters of a line kept to classify it and pass to the event callback
+	#endif
+#endif
+
+														// Response Buffer
+#ifndef LORAMDOT_RESPONSE_BUFFER_SIZE
+	#if defined(__AVR__)
+		#define LORAMDOT_RESPONSE_BUFFER_SIZE 128		// Bytes of the response kept while receiving. Longer responses keep the last bytes received.
+	#else
+		#define LORAMDOT_RESPONSE_BUFFER_SIZE 1024		// Bytes of the response kept while receiving. Longer responses keep the last bytes received.
+	#endif
+#endif
+
+const char RESPONSE_TERMINATOR[] = "OK\r\n";			// End of a successful command response
+const byte RESPONSE_TERMINATOR_LENGTH = 4;				// Number of characters in RESPONSE_TERMINATOR
+const char RESPONSE_ERROR_LINE[] = "ERROR";				// Line ending a failed command response
+const char JOIN_FAILURE_LINE[] = "Failed to join";		// Start of the line ending a failed AT+JOIN
+const unsigned long FAILURE_LINE_SETTLE = 50;			// Milliseconds to wait for the ERROR that normally follows a failure line before failing the command
+const char SERIAL_DATA_ESCAPE[] = "+++";				// Escape sequence that returns from serial data mode to AT command mode
+const unsigned int SERIAL_DATA_BUFFER_SIZE = 512;		// mDot firmware serial buffer (bytes)
+
+														// Timeout Profiles (see setTimeoutProfiles())
+const byte TIMEOUT_CLASS_QUICK = 0;						// Settings and queries answered by the mDot itself
+const byte TIMEOUT_CLASS_REPORT = 1;					// Long reports (AT&V, AT&S, ATI)
+const byte TIMEOUT_CLASS_STORE = 2;						// Flash writes and restarts (AT&W, AT+SS, ATZ)
+const byte TIMEOUT_CLASS_SEND = 3;						// Uplinks (AT+SEND, AT+SENDB): time on air, receive windows and acknowledgment attempts
+const byte TIMEOUT_CLASS_LINK = 4;						// Requests answered by the network (AT+PING, AT+NLC)
+const byte TIMEOUT_CLASS_JOIN = 5;						// Joins (AT+JOIN): time on air and join windows of each attempt
+const byte TIMEOUT_CLASS_COUNT = 6;						// Number of timeout classes
+
+const unsigned long TIMEOUT_QUICK = 2000;				// Milliseconds for TIMEOUT_CLASS_QUICK
+const unsigned long TIMEOUT_REPORT = 5000;				// Milliseconds for TIMEOUT_CLASS_REPORT (about 1 KB of output at 9600 baud)
+const unsigned long TIMEOUT_STORE = 5000;				// Milliseconds for TIMEOUT_CLASS_STORE (a restart takes about 3 seconds)
+const unsigned long TIMEOUT_RECEIVE_WINDOW = 1000;		// Milliseconds allowed for the second receive window to close after it opens
+const unsigned long TIMEOUT_ACK = 3000;					// Milliseconds before an unacknowledged confirmed uplink is retried (LoRaWAN ACK_TIMEOUT 2 +/- 1 s)
+const unsigned long TIMEOUT_MARGIN = 2000;				// Milliseconds added to each radio attempt (firmware processing and serial output)
+const unsigned long TIMEOUT_ADAPTIVE_MINIMUM = 200;		// Least margin in milliseconds between a learned timeout and the mean latency
+const byte TIMEOUT_ADAPTIVE_SAMPLES = 8;				// Responses of a class before its learned timeout is used
+const byte JOIN_DELAY_DEFAULT = 5;						// Seconds from a join request to the first join window (LoRaWAN JOIN_ACCEPT_DELAY1)
+const byte RECEIVE_DELAY_DEFAULT = 1;					// Seconds from an uplink to the first receive window (LoRaWAN RECEIVE_DELAY1)
+const byte JOIN_RETRIES_DEFAULT = 2;					// Join attempts made by the mDot by default (AT+JR)
+
+														// Session Resume Outcomes (see ResumeSession())
+const byte SESSION_FAILED = 0;							// There is no session: the saved session could not be restored and the join failed
+const byte SESSION_ACTIVE = 1;							// The mDot was still joined (only the host restarted)
+const byte SESSION_RESTORED = 2;						// The saved session was restored (AT+RS) without a join
+const byte SESSION_JOINED = 3;							// The saved session was not valid, so the mDot joined and the new session was saved
+const unsigned int SESSION_SAVE_INTERVAL = 16;			// Default uplinks between automatic session saves (see setSessionSaveInterval())
+
+														// Baud Rate Negotiation (see NegotiateBaudRate())
+typedef void (*BaudRateCallback)(unsigned long baudRate);	// Reopens the host serial port at baudRate, e.g. Serial1.begin(baudRate)
+
+const unsigned long BAUD_RATE_MAX = 921600;				// Fastest mDot serial baud rate
+const unsigned long BAUD_PROBE_TIMEOUT = 250;			// Milliseconds to wait for OK while probing a baud rate
+const byte BAUD_PROBE_ATTEMPTS = 2;						// AT commands sent at each baud rate while probing
+const unsigned long BAUD_RESTART_TIMEOUT = 6000;		// Milliseconds for the mDot to answer after restarting at a new baud rate
+const byte BAUD_VERIFY_COMMANDS = 8;					// AT commands (followed by an AT&V) that must succeed at a new baud rate
+const byte BAUD_FALLBACK_ATTEMPTS = 3;					// Attempts to return the mDot to the last good baud rate after a failed change
 
 														// Wake PINs
 const byte WAKE_PIN_DIN = 1;							// Wke PIN is DIN
@@ -45,17 +128,18 @@ const byte WAKE_PIN_NCTS_DIO7 = 7;						// (Not available with AT&K3)
 const byte WAKE_PIN_NDTR_SLEEPRQ_DI8 = 8;				// (Default)	
 
 														// Serial Speeds
-const unsigned int SERIAL_SPEED_1200 = 1200;			// 1200 baud
-const unsigned int SERIAL_SPEED_2400 = 2400;			// 2400 baud
-const unsigned int SERIAL_SPEED_4800 = 4800;			// 4800 baod
-const unsigned int SERIAL_SPEED_9600 = 9600;			// 9600 baud
-const unsigned int SERIAL_SPEED_19200 = 19200;			// 19200 baud
-const unsigned int SERIAL_SPEED_38400 = 38400;			// 38400 baud
-const unsigned int SERIAL_SPEED_57600 = 57600;			// 38400 baud
-const unsigned int SERIAL_SPEED_115200 = 115200;		// 115200 baud (Default)
-const unsigned int SERIAL_SPEED_230500 = 230500;		// 230500 baud
-const unsigned int SERIAL_SPEED_460800 = 460800;		// 460800 baud
-const unsigned int SERIAL_SPEED_921600 = 921600;		// 921600 baud
+const unsigned long SERIAL_SPEED_1200 = 1200;			// 1200 baud
+const unsigned long SERIAL_SPEED_2400 = 2400;			// 2400 baud
+const unsigned long SERIAL_SPEED_4800 = 4800;			// 4800 baud
+const unsigned long SERIAL_SPEED_9600 = 9600;			// 9600 baud
+const unsigned long SERIAL_SPEED_19200 = 19200;			// 19200 baud
+const unsigned long SERIAL_SPEED_38400 = 38400;			// 38400 baud
+const unsigned long SERIAL_SPEED_57600 = 57600;			// 57600 baud
+const unsigned long SERIAL_SPEED_115200 = 115200;		// 115200 baud (Default)
+const unsigned long SERIAL_SPEED_230400 = 230400;		// 230400 baud
+const unsigned long SERIAL_SPEED_230500 = SERIAL_SPEED_230400;	// Deprecated: misnamed, use SERIAL_SPEED_230400
+const unsigned long SERIAL_SPEED_460800 = 460800;		// 460800 baud
+const unsigned long SERIAL_SPEED_921600 = 921600;		// 921600 baud
 
 														// US AU Data Rates
 const String DATA_RATE_US_AU_D0_11 = "DR0";				// Data Rate for D0 on US and AU devices for 11 bytes payload. 
@@ -74,6 +158,13 @@ const String DATA_RATE_EU_D5_242 = "DR5";				// Data Rate for D5 on EU devices f
 const String DATA_RATE_EU_D6_242 = "DR6";				// Data Rate for D6 on EU devices for 242 bytes payload.
 const String DATA_RATE_EU_D7_50 = "DR7";				// Data Rate for D7 on EU devices for 50 bytes payload.
 														
+														// Frequency Bands (used to look up the maximum payload for the data rate)
+const byte FREQUENCY_BAND_US_AU = 0;					// 915MHz US and AU models (Default)
+const byte FREQUENCY_BAND_EU = 1;						// 868MHz EU models
+
+const byte DATA_RATE_UNKNOWN = 0xFF;					// Data rate has not been set or could not be read
+const byte PAYLOAD_SIZE_MAX = 242;						// Largest payload at any data rate
+
 														// Debug Levels
 const byte DEBUG_LOG_LEVEL_OFF = 0;						// Off  No debug messages(Default)
 const byte DEBUG_LOG_LEVEL_FATAL = 1;					// Output FATAL debug messages.
@@ -132,6 +223,124 @@ const byte SLEEP_MODE_STOP_MODE = 1;					// Sleep (ST Micro stop mode)
 const byte WAKE_MODE_DEEP_SLEEP = 0;					// ST Micro standby mode
 const byte WAKE_MODE_STOP_MODE = 1;						// Sleep(ST Micro stop mode)
 
+const byte CONFIG_UNSET = 0xFF;							// LoRamDotConfig setting is not managed (left as it is on the mDot)
+
+// Settings applied with LoRamDot::ApplyConfiguration(). Fields left at CONFIG_UNSET (or NULL) are not changed.
+// Only settings that differ from what the mDot is known to hold are sent, followed by a single AT&W.
+struct LoRamDotConfig
+{
+	byte dataRate = CONFIG_UNSET;						// TX data rate (DR number, e.g. 0 for DATA_RATE_US_AU_D0_11)
+	byte publicNetwork = CONFIG_UNSET;					// ENABLED or DISABLED
+	byte joinMode = CONFIG_UNSET;						// NETWORK_JOIN_MODE_*
+	byte subBand = CONFIG_UNSET;						// Frequency sub-band 1-8 (915MHz models only)
+	byte ackAttempts = CONFIG_UNSET;					// Acknowledgment attempts 0-8
+	byte adaptiveDataRate = CONFIG_UNSET;				// ENABLED or DISABLED
+	byte transmitPower = CONFIG_UNSET;					// 0-20 dBm
+	byte applicationPort = CONFIG_UNSET;				// 1-223
+	byte joinRetries = CONFIG_UNSET;					// 0-255 (255 cannot be managed)
+	const char *networkId = NULL;						// Network ID / TTN Application EUI as hex (KEY_TYPE_HEX)
+	const char *networkKey = NULL;						// Network Key / TTN App Key as hex (KEY_TYPE_HEX)
+};
+
+#ifndef LORAMDOT_SNAPSHOT_VALUE_SIZE
+	#define LORAMDOT_SNAPSHOT_VALUE_SIZE 24				// Characters of an AT&V value kept while parsing (longer values are truncated)
+#endif
+
+// Typed device settings parsed from a single AT&V response with LoRamDot::ReadSnapshot().
+// Settings not reported by the firmware are left at CONFIG_UNSET (bytes) or 0.
+struct LoRamDotSnapshot
+{
+	byte frequencyBand = CONFIG_UNSET;					// FREQUENCY_BAND_US_AU or FREQUENCY_BAND_EU
+	byte subBand = CONFIG_UNSET;						// Frequency sub-band
+	byte publicNetwork = CONFIG_UNSET;					// ENABLED or DISABLED
+	byte startUpMode = CONFIG_UNSET;					// DATA_MODE_AT or DATA_MODE_SERIAL
+	uint32_t networkAddress = 0;						// Network (device) address
+	uint32_t networkIdHash = 0;							// Hash of the network ID hex digits
+	uint32_t networkKeyHash = 0;						// Hash of the network key hex digits
+	byte joinMode = CONFIG_UNSET;						// NETWORK_JOIN_MODE_*
+	byte joinRetries = CONFIG_UNSET;					// Join retries
+	byte preserveSession = CONFIG_UNSET;				// ENABLED or DISABLED
+	byte linkCheckCount = CONFIG_UNSET;					// 0 (off) or packets between link checks
+	byte linkCheckThreshold = CONFIG_UNSET;				// 0 (off) or failed link checks before a rejoin
+	byte forwardErrorCorrection = CONFIG_UNSET;			// FORWARD_ERROR_CORRECTION_REDUNDANCY_*
+	byte ackAttempts = CONFIG_UNSET;					// 0 (off) or acknowledgment attempts
+	byte adaptiveDataRate = CONFIG_UNSET;				// ENABLED or DISABLED
+	byte commandEcho = CONFIG_UNSET;					// ENABLED or DISABLED
+	byte txDataRate = CONFIG_UNSET;						// TX data rate (DR number)
+	byte rxDataRate = CONFIG_UNSET;						// RX data rate (DR number)
+	byte txPower = CONFIG_UNSET;						// dBm
+	byte txWait = CONFIG_UNSET;							// ENABLED or DISABLED
+	byte receiveOutput = CONFIG_UNSET;					// DATA_FORMAT_HEX or DATA_FORMAT_RAW
+	uint32_t serialBaudRate = 0;						// Serial baud rate
+	byte wakeMode = CONFIG_UNSET;						// 0 interval, 1 interrupt
+	uint32_t wakeInterval = 0;							// Seconds
+	uint32_t wakeDelay = 0;								// Milliseconds
+	uint32_t wakeTimeout = 0;							// Milliseconds
+	byte wakePin = CONFIG_UNSET;						// WAKE_PIN_*
+	char deviceClass = 0;								// 'A', 'B' or 'C'
+	byte applicationPort = CONFIG_UNSET;				// Application port
+	byte maxPayload = CONFIG_UNSET;						// Maximum payload size at the current data rate
+	byte fields = 0;									// Number of settings parsed
+};
+
+// Device statistics parsed from AT&S with LoRamDot::ReadStatistics(). Counts since the last reset (AT&R).
+struct LoRamDotStatistics
+{
+	uint32_t joinAttempts = 0;							// Join attempts
+	uint32_t joinFails = 0;								// Failed joins
+	uint32_t upPackets = 0;								// Packets sent
+	uint32_t downPackets = 0;							// Packets received
+	uint32_t missedAcks = 0;							// Acknowledgments not received
+	uint32_t crcErrors = 0;								// Packets received with CRC errors
+	byte fields = 0;									// Number of counts parsed
+};
+
+// Signal quadruple parsed from AT+RSSI (dBm) or AT+SNR (tenths of a dB) with LoRamDot::ReadSignalStrength() / ReadSignalToNoiseRatio().
+struct LoRamDotSignal
+{
+	int16_t last = 0;									// Last packet
+	int16_t minimum = 0;								// Minimum since the last reset
+	int16_t maximum = 0;								// Maximum since the last reset
+	int16_t average = 0;								// Average since the last reset
+};
+
+														// Command Metrics
+#ifndef LORAMDOT_METRICS
+	#define LORAMDOT_METRICS 1							// 1 records counters and a latency histogram per AT command (see CommandMetrics()). 0 compiles them out.
+#endif
+
+#ifndef LORAMDOT_METRICS_COMMANDS
+	#if defined(__AVR__)
+		#define LORAMDOT_METRICS_COMMANDS 4				// Commands tracked. Commands beyond the first LORAMDOT_METRICS_COMMANDS - 1 are counted together as "*".
+	#else
+		#define LORAMDOT_METRICS_COMMANDS 32			// Commands tracked. Commands beyond the first LORAMDOT_METRICS_COMMANDS - 1 are counted together as "*".
+	#endif
+#endif
+
+#ifndef LORAMDOT_METRICS_NAME_SIZE
+	#define LORAMDOT_METRICS_NAME_SIZE 9				// Characters of the command name kept (longer names are truncated)
+#endif
+
+const byte METRICS_LATENCY_BUCKETS = 16;				// Latency histogram buckets. Bucket 0 counts < 1 ms, bucket b counts 2^(b-1) to 2^b - 1 ms
+														// and the last bucket counts 16384 ms and over.
+
+#if LORAMDOT_METRICS
+// Counters and latency histogram of one AT command (the command text before any '=' or '?'), read with LoRamDot::CommandMetrics().
+// The latency runs from the start of the command line to the end of the response (or the timeout).
+struct LoRamDotCommandMetrics
+{
+	char command[LORAMDOT_METRICS_NAME_SIZE + 1] = {};	// Command name, e.g. "AT+SENDB"
+	uint32_t calls = 0;									// Commands sent
+	uint16_t timeouts = 0;								// Commands that timed out (saturates at 65535)
+	uint16_t errors = 0;								// Commands that failed with any other status (saturates at 65535)
+	uint32_t bytesWritten = 0;							// Bytes of the command lines written
+	uint32_t bytesRead = 0;								// Bytes of the responses read
+	uint32_t totalMs = 0;								// Sum of the latencies (the mean is totalMs / calls)
+	uint32_t maximumMs = 0;								// Longest latency
+	uint16_t latency[METRICS_LATENCY_BUCKETS] = {};		// Commands per latency bucket (saturates at 65535)
+};
+#endif
+
 const String CODES = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="; // Base64 string
 
 class LoRamDot
@@ -142,7 +351,12 @@ public:
 
 	void begin(Stream &serial);
 
-	void setTimeout(unsigned long timeout);
+	void setTimeout(unsigned long timeout);				// Sets one timeout in milliseconds for every command (0: no timeout). Turns the timeout profiles off.
+	void setTimeoutProfiles(boolean enabled, boolean adaptive = false);	// Times each command by its class (TIMEOUT_CLASS_*) from the configured receive windows and retries
+														// (the default; quick commands time out after 2 s, not 15 s). adaptive: Also tightens each class's timeout from the latencies observed.
+	unsigned long CommandTimeout(byte timeoutClass);	// Returns the timeout in milliseconds used for commands of the class (TIMEOUT_CLASS_*).
+	static byte TimeoutClass(const char *command);		// Returns the timeout class (TIMEOUT_CLASS_*) of a command, e.g. TIMEOUT_CLASS_SEND for "AT+SEND=...".
+	void setFrequencyBand(byte band);					// Sets the frequency band (FREQUENCY_BAND_US_AU or FREQUENCY_BAND_EU) used to look up payload sizes. Also learned from FrequencyBand().
 
 	// General AT Commands
 
@@ -155,16 +369,37 @@ public:
 	boolean ResetToFactory();							// Reset to Factory Defaults changes the current settings to the factory defaults, but does not store them.
 	boolean SaveConfiguration();						// Writes all configuration settings displayed in AT&V to flash memory.
 	boolean WakePin(byte pin);							// Sets the pin that the end device monitors if wake mode is set to interrupt mode.
-	boolean SerialSpeed(int speed);						// Sets serial baud rate for interface on header pins 2 and 3. Changes to this setting take effect after a save and reboot of the Dot.
-	boolean DebugSerialSpeed(int speed);				// Sets debug serial baud rate for interface on DEBUG header pins 30 and 31. Changes to this setting take effect after a save and reboot of the Dot.power - cycle or reset.
+	boolean SerialSpeed(unsigned long speed);			// Sets serial baud rate for interface on header pins 2 and 3. Changes to this setting take effect after a save and reboot of the Dot.
+	boolean DebugSerialSpeed(unsigned long speed);		// Sets debug serial baud rate for interface on DEBUG header pins 30 and 31. Changes to this setting take effect after a save and reboot of the Dot.power - cycle or reset.
 	boolean DebugLogLevel(byte level);					// Sets the debug message logging level. Messages are output on the debug port. Higher settings log more messages.
 
+														// Baud Rate Negotiation
+
+	unsigned long ProbeBaudRate(BaudRateCallback setBaudRate, unsigned long maximum = BAUD_RATE_MAX);	// Finds the mDot's baud rate by trying each rate up to maximum
+														// (fastest first) until it answers AT. Returns the rate or 0 if the mDot never answers.
+	unsigned long NegotiateBaudRate(BaudRateCallback setBaudRate, unsigned long maximum = BAUD_RATE_MAX);	// Probes the baud rate, then steps the mDot up to the fastest
+														// rate up to maximum that passes an error free check, falling back to the last good rate. Returns the rate in use (0 if not found).
+	unsigned long BaudRate();							// Returns the baud rate found by the last probe or negotiation (0 if unknown).
+
 														// LoRa utility functions
 
 	String LastResponse();								// Returns the last message received.
 	boolean LastCommandStatus();						// Returns the status of the last command (true: success, false: failure).
 	String LastCommandStatusMessage();					// Returns the status message of the last command.
-	int LastCommandStatusId();							// Returns the status ID of the last command (0:OK, 1:TIMED-OUT, 2:INPUT-OUT-OF-RANGE).
+	int LastCommandStatusId();							// Returns the status ID of the last command (0:OK, 1:TIMED-OUT, 2:INPUT-OUT-OF-RANGE, 3:BUSY, 4:ERROR).
+
+														// Asynchronous Commands
+
+	boolean BeginCommand(const char *command);			// Sends a command and returns immediately. Call Poll() from loop() until the command completes.
+	boolean BeginCommand(String command);				// Sends a command and returns immediately. Call Poll() from loop() until the command completes.
+														// Returns false (BUSY) if the previous command is still waiting for its response.
+	byte Poll();										// Reads the available response data and returns the command state (COMMAND_STATE_IDLE, _WAITING or _COMPLETE).
+	byte CommandState();								// Returns the command state without reading from the serial stream.
+	void setCommandCallback(CommandCallback callback);	// Sets the function called when a command completes. NULL disables the callback.
+	void setEventCallback(byte event, EventCallback callback);	// Sets the function called when a line raising event (EVENT_*) is received. NULL disables the callback.
+														// Once a callback is set Poll() also reads the serial stream between commands so unsolicited lines are seen as they arrive.
+														// Commands sent from an event callback raised while a command's response is read fail with BUSY, and Poll()
+														// returns at once there. A command sent from the command callback replaces the last response and status.
 
 														// Network Management Commands
 
@@ -175,6 +410,7 @@ public:
 	boolean JoinByteOrder(byte order);					// Sets the byte order (LSB [Default] or MSB first) in which the device EUI is sent to the gateway in a join request.
 	boolean NetworkJoinMode(byte mode);					// Controls how the end device establishes communications with the gateway.
 	boolean Join();										// Join network. For US915 and EU868 models +NI, +NK must match gateway settings in order to join. US915 must also match + FSB setting.
+	boolean BeginJoin();								// Sends AT+JOIN and returns immediately. Call Poll() from loop() until the join completes. Returns false (BUSY) if a command is waiting.
 	boolean JoinRetries(byte retries);					// This is the maximum number of join attempts that will be made if none are successful. 0: Disable; 1-255: Retries (Default: 2)
 	boolean JoinDelay(byte delay);						// Allows the dot to use non-default join receive windows, if required by the network it is attempting to connect to.
 														// Initiating a join request opens a receive window to listen for the response.This command allows you to alter the default timing of the window.
@@ -223,14 +459,24 @@ public:
 														// join.This command should be issued after the Dot has joined.See AT + PS if using auto join mode.
 	boolean RestoreNetworkSession();					// Restores the network session information (join) that was saved with the AT+SS command.
 	boolean PreserveSession(boolean preserve);			// (false: Off [Default]; true: On) Preserves the network session information over resets when using auto join mode (AT+NJM). If not using auto join mode, use with the save session command(AT + SS).
+	byte ResumeSession();								// Start up fast path: keeps or restores (AT+RS) the saved session and joins only if there is no valid session.
+														// Returns SESSION_ACTIVE, SESSION_RESTORED, SESSION_JOINED or SESSION_FAILED.
+	void setSessionSaveInterval(unsigned int uplinks);	// Sets the uplinks between automatic session saves (AT+SS) once ResumeSession() has been called. 0 disables them.
+	boolean SaveSessionIfDue();							// Saves the session (AT+SS) if the save interval has passed. Called by Send() and SendBinary(); call it from
+														// loop() when sending asynchronously. Returns false only if a save was due and failed.
 
 														// Sending and Receiving Packets
 	String TransmitChannel();							// For reference, use the +TXCH command to display channels used with frequency hopping.
 	unsigned long TransmitNext();						// Returns the time, in milliseconds, until the next free channel is available to transmit data. The time can range from 0 - 2793000 milliseconds.
 	unsigned long TimeOnAir(byte bytes);				// Displays the amount of on air time, in milliseconds, required to transmit the number of bytes specified at the current data rate.
 														// bytes: 0-242 The number of bytes used to calculate the time on air.
+	unsigned long EstimateTimeOnAir(byte bytes);		// Calculates the on air time, in milliseconds, locally from the frequency band, data rate and forward error correction
+														// last set (See LoRamDotAirtime.h). Asks the mDot (TimeOnAir()) only if the data rate is unknown.
 														// Configuring
 	String SettingsAndStatus();							// Displays device settings and status in a tabular format.
+	boolean ReadSnapshot(LoRamDotSnapshot &snapshot);	// Reads the device settings with a single AT&V, parsed into snapshot line by line as the table is received.
+														// Also updates the configuration shadow and the data rate, band and receive format the library tracks.
+	boolean BeginSnapshot(LoRamDotSnapshot &snapshot);	// Sends AT&V and returns immediately. snapshot is filled as Poll() reads the table. Returns false (BUSY) if a command is waiting.
 	boolean DeviceClass(String deviceClass);			// Sets the device class. The LoRaWAN 1.0 specification defines the three device classes, Class A, B and C. Note : Currently only Class A is supported.
 	boolean ApplicationPort(byte applicationPort);		// Sets the port used for application data. Each LoRaWAN packet containing data has an associated port value. 
 														// Port 0 is reserved for MAC commands, ports 1 - 223 are available for application use, and port 233 - 255 are reserved for future LoRaWAN use.
@@ -280,6 +526,9 @@ public:
 														//		which results in a longer range but a lower data rate.For more information on spreading factor, refer to the
 														//		device's developer guide
 	String SessionDataRate();							// Display the current data rate the LoRaMAC layer is using. It can be changed by the network server if ADR is enabled.
+	byte FrequencyBandId();								// Returns the frequency band used for payload sizes (FREQUENCY_BAND_US_AU or FREQUENCY_BAND_EU).
+	byte CurrentDataRate();								// Returns the data rate (0-15) last set with TXDataRate() or read with SessionDataRate(). DATA_RATE_UNKNOWN if neither has been called.
+	byte MaxPayload();									// Returns the maximum payload in bytes for the current data rate and frequency band (242 if the data rate is unknown).
 	boolean RepeatPacket(byte repeats);					// Repeats each frame as many times as indicated or until downlink from network server is received. This setting
 														//		increases redundancy to increase change of packet to be received by the gateway at the expense of increasing
 														//		network congestion.When enabled, debug output shows multiple packets being sent.On the Conduit, an MQTT
@@ -294,14 +543,20 @@ public:
 	boolean SendBinary(String data);					// Functions as the +SEND command, but sends hexadecimal data.
 														// data: String of up to 242 eight bit hexadecimal values. Each value may range from 00 to FF.
 
-	boolean SendBinary(byte data[]);					// Functions as the +SEND command, but sends hexadecimal data.
-														// data: String of up to 242 eight bit hexadecimal values. Each value may range from 00 to FF.
+	boolean SendBinary(const uint8_t *data, size_t length);	// Functions as the +SEND command, but sends the bytes as hexadecimal data.
+														// The hex is streamed straight into the AT+SENDB command line.
+														// data: Up to 242 bytes or the maximum payload for the data rate (See MaxPayload()). length: Number of bytes in data.
+	boolean SendBinary(const Printable &data);			// Functions as the +SEND command, but sends the bytes printed by data as hexadecimal data.
+														// data: Printable object that prints up to 242 bytes. printTo() is called twice (once to count the bytes).
 														// Receiving Packets
 
 	String ReceiveOnce();								// Displays the last payload received. It does not initiate reception of new data. Use +SEND to initiate receiving data from the network server.
+	size_t ReceiveOnce(uint8_t *buffer, size_t capacity);	// Decodes the last payload received straight into buffer as it is read from the serial stream and returns the number of bytes stored.
+														// Hex output (DATA_FORMAT_HEX) is decoded to bytes; raw output (DATA_FORMAT_RAW) is copied as is. Bytes beyond capacity are dropped.
 	boolean ReceiveOutput(byte format);					// Formats the receive data output. Data is either processed into hexadecimal data or left unprocessed/raw.
 														// Hexadecimal outputs the byte values in the response.Raw / Unprocessed outputs the actual bytes on the serial interface.
 														// format: DATA_FORMAT_HEX = 0, DATA_FORMAT_RAW = 1. 
+	boolean UnsolicitedResponses(boolean enabled);		// Enables or disables unsolicited response codes. When enabled the mDot sends RECV (EVENT_DOWNLINK) when a packet is received.
 	boolean DataPending();								// Indicates there is at least one packet pending on the gateway for this end device. This indication is communicated
 														// to the end device in any packet coming from the server.Each packet contains a data pending bit.
 	boolean TransmitWait(boolean wait);					// Enables or disables waiting for RX windows to expire after sending.
@@ -313,6 +568,9 @@ public:
 	String SignalStrength();							// Displays device statistics including join attempts, join failures, packets sent, packets received and missed acks. Use AT&R to reset / clear the statistics.
 	String SignalToNoiseRatio();						// Displays signal to noise ratio for all packets received from the gateway since the last reset. There are four signal to
 														//   noise ratio values, which, in order, are: last packet SNR, minimum SNR, maximum SNR and average SNR.Values range from - 20dBm to 20dBm.
+	boolean ReadStatistics(LoRamDotStatistics &statistics);	// Reads the device statistics (AT&S) into statistics, parsed as the response is received.
+	boolean ReadSignalStrength(LoRamDotSignal &rssi);	// Reads the RSSI of the packets received (AT+RSSI) in dBm.
+	boolean ReadSignalToNoiseRatio(LoRamDotSignal &snr);	// Reads the SNR of the packets received (AT+SNR) in tenths of a dB.
 
 														// Serial Data Mode
 
@@ -320,6 +578,8 @@ public:
 														//		- When++ + is received to escape serial data mode all buffer data will be discarded.
 														//		- CTS is handled by the serial driver and is relative to its buffer size.When flow control is enabled, see AT&K.
 														//		- mDot firmware serial buffer size is 512 bytes.
+	boolean EscapeSerialDataMode();						// Sends the +++ escape sequence and waits for the OK of AT command mode. Data the mDot has not yet sent is discarded.
+	Stream &SerialStream();								// Returns the serial stream the mDot is on, to write application data in serial data mode (see LoRamDotDataWriter).
 
 	boolean StartupMode(byte dataMode);					// Configures which operation mode the end device powers up in, either AT command mode or serial data mode.
 														//		- AT Command mode : The end device powers up or resets in command mode.AT commands are used to send and receive data.
@@ -342,28 +602,209 @@ public:
 														//	expires, the device goes back to sleep.If the device received at least one character before this timer expires, the
 														//	device continues to read input until either the payload is reached or the + WTO timer expires at which time it sends
 														//	the collected data and goes to sleep.
-														// delay: 2-2147483647 seconds (Default is 100)
+														// delay: 2-2147483647 milliseconds (Default is 100)
 	boolean WakeTimeout(unsigned long timeout);			// Configures the amount of time that the device waits for subsequent characters following the first character
 														//	received upon waking.Once this timer expires, the collected data is sent and the end device goes back to sleep.
 														// timeout: 0-65000 milliseconds (Default is 20)
 	boolean AntennaGain(int gain);						// 	Allows a non-default antenna to be used while still adhering to transmit power regulations.
 														// gain: -128 to 127 (Default is 3)			
 
+														// Configuration Shadow
+
+	boolean ApplyConfiguration(const LoRamDotConfig &config, byte *changes = NULL);	// Sends only the settings that differ from the known mDot state, then saves them with a single AT&W
+														// (only if something changed). changes: Optional count of settings sent. Returns false if a command failed.
+	boolean ReadConfiguration();						// Reads the managed settings from the mDot (one AT&V) into the shadow so the next ApplyConfiguration() skips settings already held.
+	void ForgetConfiguration();							// Marks every shadowed setting as unknown so the next ApplyConfiguration() sends them all.
+
+#if LORAMDOT_METRICS
+														// Command Metrics
+
+	byte CommandMetricsCount();							// Returns the number of commands with metrics.
+	const LoRamDotCommandMetrics *CommandMetrics(byte index);	// Returns the metrics of the command at index (0 to CommandMetricsCount() - 1) or NULL.
+	const LoRamDotCommandMetrics *CommandMetrics(const char *command);	// Returns the metrics of the command (e.g. "AT+SENDB") or NULL if it has not been sent.
+	void ClearCommandMetrics();							// Clears the metrics of every command.
+	static unsigned long LatencyBucketMs(byte bucket);	// Returns the shortest latency in milliseconds counted by a histogram bucket.
+	static unsigned long LatencyPercentileMs(const LoRamDotCommandMetrics &metrics, byte percent);	// Returns the latency in milliseconds that percent of the
+														// commands did not exceed (the top of the histogram bucket it falls in, limited to maximumMs).
+#endif
+
+	boolean SendCommand(const char *command);			// Send a command that instructs the mDot to send the data and wait for the "OK" response.
+	boolean SendCommand(const char *command, String *response);	// Send a command that instructs the mDot to send the command and wait for the respnse string.
 	boolean SendCommand(String command);				// Send a command that instructs the mDot to send the data and wait for the "OK" response.
 	boolean SendCommand(String command, String *response);	// Send a command that instructs the mDot to send the command and wait for the respnse string.
 	boolean ReceiveResponse(String *response, unsigned long timeout); // Read the the serial response.
-																	  // The timeout is set seperately to enable the use of -1 in SendCommand
+																	  // The timeout is given separately from the command's class timeout. 0 waits with no timeout.
 protected:
 
 private:
 	Stream *_Serial;
 	unsigned long _timeout = 15000;						// Timeout for the serial stream in milliseconds. 0 disables the timeout (no timeout).
+
+	// Timeout profiles (per command class, used instead of _timeout while enabled)
+	boolean _timeoutProfiles = true;					// Time commands by their class
+	boolean _timeoutAdaptive = false;					// Tighten the class timeouts from the latencies observed
+	byte _commandClass = TIMEOUT_CLASS_QUICK;			// Timeout class of the current command
+	byte _joinDelay = JOIN_DELAY_DEFAULT;				// Join delay last set with JoinDelay() (CONFIG_UNSET if unknown)
+	byte _receiveDelay = RECEIVE_DELAY_DEFAULT;			// Receive delay last set with ReceiveDelay() (CONFIG_UNSET if unknown)
+	uint32_t _latencyMean[TIMEOUT_CLASS_COUNT] = {};	// Smoothed latency per class in eighths of a millisecond
+	uint32_t _latencyDeviation[TIMEOUT_CLASS_COUNT] = {};	// Smoothed latency deviation per class times four, in milliseconds
+	byte _latencySamples[TIMEOUT_CLASS_COUNT] = {};		// Latencies observed per class (stops at 255)
+
+	unsigned long ProfileTimeout(byte timeoutClass);	// Returns the timeout of a class derived from the receive windows and retries
+	void LearnLatency(int statusId);					// Adds the current command's latency (or timeout) to its class
+
+	// Session resume
+	boolean _sessionManaged = false;					// ResumeSession() has been called, so the session is saved every _sessionSaveInterval uplinks
+	unsigned int _sessionSaveInterval = SESSION_SAVE_INTERVAL;	// Uplinks between automatic session saves (0: none)
+	unsigned int _uplinksSinceSave = 0;					// Uplinks sent since the session was last saved
+
+	// Baud rate negotiation
+	unsigned long _baudRate = 0;						// Baud rate found by the last probe or negotiation (0 if unknown)
+
+	boolean ProbeAttention(unsigned long timeout);		// Sends AT (discarding any input received at the wrong rate) and waits up to timeout for OK
+	boolean WaitForRestart(BaudRateCallback setBaudRate, unsigned long baudRate);	// Reopens the host port at baudRate and waits until the mDot answers
+	boolean VerifyBaudRate(unsigned long baudRate);		// Checks the link is error free at baudRate (several ATs and an AT&V reporting the rate)
+	boolean ChangeBaudRate(BaudRateCallback setBaudRate, unsigned long baudRate);	// Saves the baud rate, restarts the mDot and verifies the link at the new rate
+	boolean RevertBaudRate(BaudRateCallback setBaudRate, unsigned long baudRate, unsigned long rejected);	// Returns the mDot to baudRate after a failed change to rejected
+
 	String _lastResponse = "";							// Last response received. Partial response if timed out.
 	boolean _lastCommandStatus = false;					// The response status of the last command. Used by code to determin if the last response was successful especially after receiving an empty string.
 	String _lastCommandStatusMessage = "";				// Message to give context as to why the command failed
-	int _lastCommandStatusId = 0;						// Status ID of the last command (0:OK, 1:TIMED-OUT, 3:INPUT-OUT-OF-RANGE).
+	int _lastCommandStatusId = 0;						// Status ID of the last command (0:OK, 1:TIMED-OUT, 2:INPUT-OUT-OF-RANGE, 3:BUSY, 4:ERROR).
+
+	// Asynchronous command engine
+	byte _commandState = COMMAND_STATE_IDLE;			// State of the current command (COMMAND_STATE_*)
+	unsigned long _commandStart = 0;					// millis() when the current command was sent
+	unsigned long _commandTimeout = 0;					// Timeout for the current command in milliseconds. 0 waits forever.
+	CommandCallback _commandCallback = NULL;			// Called when a command completes
+
+	// Event dispatch (lines classified as they are received)
+	EventCallback _eventCallbacks[EVENT_COUNT] = {};	// Called when a line raising each event is received
+	boolean _eventsEnabled = false;						// True once a callback is set (Poll() then reads between commands)
+	char _eventLine[LORAMDOT_EVENT_LINE_SIZE + 1];		// Start of the current line
+	byte _eventLineLength = 0;							// Characters in _eventLine
+	boolean _inCallback = false;						// An event callback raised while a command's response is read is running (commands fail with BUSY)
+
+	void ProcessEventByte(char c);						// Adds a received byte to the current line and dispatches the line's event once it ends
+
+	// Response accumulator (ring buffer, no heap allocation while receiving)
+	char _responseBuffer[LORAMDOT_RESPONSE_BUFFER_SIZE + 1];	// Received bytes. The extra byte holds the terminating NUL once the response is complete.
+	unsigned int _responseHead = 0;						// Index the next received byte is written to
+	unsigned int _responseLength = 0;					// Number of bytes held in the buffer
+	byte _lineMatched = 0;								// Characters of the current line matched against the terminators
+	byte _lineCandidates = 0;							// Terminators the current line still matches (a bit each)
+	const char *_failureLine = NULL;					// Start of a line that ends the current command as failed (e.g. JOIN_FAILURE_LINE). NULL for none.
+	boolean _failureSeen = false;						// True once the failure line has been received
+	unsigned long _failureTime = 0;						// millis() when the failure line was received
+
+	void ResetResponse();								// Empties the response buffer
+	byte ProcessResponseByte(char c);					// Stores a received byte. Returns the terminator once a line ending the response has been received (0 until then).
+	void FinishResponse();								// Copies the trimmed response buffer into _lastResponse
+
+	// Data rate tracking (for the maximum payload size)
+	byte _frequencyBand = FREQUENCY_BAND_US_AU;			// Frequency band of the mDot model
+	byte _dataRate = DATA_RATE_UNKNOWN;					// Data rate last set or read
+	byte _codingRate = FORWARD_ERROR_CORRECTION_REDUNDANCY_5_BITS;	// Forward error correction last set (LoRaWAN default 4/5)
+
+	// Configuration shadow (known mDot settings, CONFIG_UNSET when unknown)
+	LoRamDotConfig _shadow;								// The key pointers are not used. See the hashes below.
+	uint32_t _networkIdHash = 0;						// Hash of the network ID hex digits (0 when unknown)
+	uint32_t _networkKeyHash = 0;						// Hash of the network key hex digits (0 when unknown)
+
+	boolean SendSetting(const char *prefix, byte value, byte *shadow);	// Sends a setting and records it in the shadow (unknown if the command failed)
+
+	// AT&V snapshot (parsed line by line as it is received)
+	LoRamDotSnapshot *_snapshot = NULL;					// Caller snapshot filled by the current command. NULL when not parsing.
+	LoRamDotStatistics *_statistics = NULL;				// Caller statistics filled by the current command (AT&S uses the same line parser). NULL when not parsing.
+	uint32_t _snapshotLabel = 0;						// Hash of the current line's label (before the ':')
+	uint32_t _snapshotHexHash = 0;						// Hash of the hex digits in the current line's value (keys)
+	char _snapshotValue[LORAMDOT_SNAPSHOT_VALUE_SIZE + 1];	// Start of the current line's value
+	byte _snapshotValueLength = 0;						// Characters in _snapshotValue
+	byte _snapshotState = 0;							// Label, spaces after the ':' or value
+
+	void ResetSnapshotLine();							// Starts parsing a new AT&V line
+	void ParseSnapshotByte(char c);						// Parses a received AT&V byte into the snapshot
+	void StoreSnapshotValue();							// Stores the completed line's value in the snapshot field named by its label
+	void FinishSnapshot();								// Updates the library state from a completed snapshot and stops parsing
+	void StoreStatisticsValue();						// Stores the completed AT&S line's value in the statistics count named by its label
+
+	// AT+RSSI / AT+SNR reading (parsed as it is received)
+	LoRamDotSignal *_signal = NULL;						// Caller signal filled by the current command. NULL when not parsing.
+	byte _signalScale = 1;								// 1 (dBm) or 10 (tenths of a dB)
+	byte _signalFields = 0;								// Values stored (last, minimum, maximum, average)
+	byte _signalState = 0;								// Line start, echo line, between numbers, sign, integer or fraction digits
+	boolean _signalNegative = false;					// The number being parsed is negative
+	long _signalValue = 0;								// The number being parsed (scaled once its integer digits end)
+
+	boolean ReadSignal(const char *command, LoRamDotSignal *signal, byte scale);	// Sends AT+RSSI or AT+SNR and parses the four values (scaled by 1 or 10)
+	void ParseSignalByte(char c);						// Parses a received AT+RSSI or AT+SNR byte into the signal's next value
+
+	// Payload capture (decodes a downlink into a caller buffer while the response is read)
+	byte _receiveFormat = DATA_FORMAT_HEX;				// Receive output format last set with ReceiveOutput()
+	uint8_t *_payloadBuffer = NULL;						// Caller buffer for the payload of the current command. NULL when not capturing.
+	size_t _payloadCapacity = 0;						// Size of the caller buffer
+	size_t _payloadLength = 0;							// Bytes stored in the caller buffer
+	size_t _payloadLineStart = 0;						// Hex: _payloadLength at the start of the current line (restored if the line is not hex)
+	size_t _payloadReceived = 0;						// Raw: Payload bytes received including those beyond the capacity
+	byte _payloadState = 0;								// Hex: High nibble + 0x10 when pending, 0xFF when the line is not hex. Raw: Characters of the echo/blank line prefix matched.
+
+	void CapturePayload(uint8_t *buffer, size_t capacity);	// Starts decoding the current command's payload into the buffer
+	void DecodePayloadByte(char c);						// Decodes a received byte into the payload buffer
+	void StoreRawPayloadByte(char c);					// Stores a raw payload byte (or counts it if the buffer is full)
+	void FinishPayload();								// Removes the raw response framing and stops capturing
+	char ResponseByteFromEnd(unsigned int index);		// Returns the byte received index bytes before the last one (0 if not held in the buffer)
+
+	void CompleteCommand(int statusId, const char *statusMessage);	// Ends the current command with the given status and fires the callback
+
+#if LORAMDOT_METRICS
+	// Command metrics
+	LoRamDotCommandMetrics _metrics[LORAMDOT_METRICS_COMMANDS];	// Metrics per command
+	byte _metricsCount = 0;								// Entries of _metrics in use
+	LoRamDotCommandMetrics *_commandMetrics = NULL;		// Metrics of the current command. NULL when no command is being recorded.
+	unsigned long _metricsStart = 0;					// millis() when the current command line was started
+
+	void OpenMetrics(const char *prefix, size_t written);	// Starts recording the command named by prefix
+	void CloseMetrics(int statusId);					// Records the outcome and latency of the current command
+#endif
+
+	// Allocation-free command formatting. The prefix and arguments are printed straight to the serial stream.
+	boolean OpenCommand(const char *prefix, const char *failureLine = NULL);	// Starts a command and writes its prefix. Returns false (BUSY) if a command is still waiting.
+	void CloseCommand(size_t written = 0, boolean lineEnd = true);	// Ends the command line (CR LF unless lineEnd is false) and starts waiting for the response. written: Bytes of arguments printed.
+
+	// Sends the prefix followed by the value (e.g. "AT+FSB=" and 2) and waits for the "OK" response.
+	template <typename T> boolean SendCommandValue(const char *prefix, const T &value)
+	{
+		WaitForCommand();
+
+		if (!OpenCommand(prefix))
+			return false;
+
+		CloseCommand(_Serial->print(value));
+
+		return WaitForResponse(&_lastResponse);
+	}
+
+	// Sends the prefix followed by two values and a separator (e.g. "AT+NI=", 0, ',' and the id) and waits for the "OK" response.
+	template <typename T1, typename T2> boolean SendCommandValues(const char *prefix, const T1 &first, char separator, const T2 &second)
+	{
+		WaitForCommand();
+
+		if (!OpenCommand(prefix))
+			return false;
+
+		size_t l_written = _Serial->print(first);
+		l_written += _Serial->print(separator);
+		l_written += _Serial->print(second);
+		CloseCommand(l_written);
+
+		return WaitForResponse(&_lastResponse);
+	}
+	boolean WaitForResponse(String *response);			// Polls until the current command completes and copies the response
+	void WaitForCommand();								// Polls until the current command completes (returns at once in an event callback raised while it is read)
 	
 	// Value to receive the Serial incoming data 
 	String _inputString = "";							// String to hold incoming Serial data
 	boolean _stringComplete = false;					// True when the stream has received a full line of data
 };
+
+#endif
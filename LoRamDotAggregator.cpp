@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoRamDotAggregator.h"
+
+// Aggregator Constructor
+// Records are sent through the given mDot.
+LoRamDotAggregator::LoRamDotAggregator(LoRamDot &mDot) : _mDot(&mDot)
+{
+
+}
+
+// Buffers a record. If it does not fit in the current uplink the buffered records are sent first.
+// Returns false if the record is larger than the maximum payload or the flush failed (the record is not buffered).
+boolean LoRamDotAggregator::Add(const uint8_t *record, size_t length)
+{
+	if (length == 0 || length > MaxPayload())
+		return false;
+
+	// Send what is buffered if the record would overflow the uplink or the record table. A flush that only dropped
+	// records (counted by Dropped()) leaves room for this one.
+	if (_length + length > MaxPayload() || _records == LORAMDOT_AGGREGATOR_MAX_RECORDS)
+	{
+		if (!Flush() && _records > 0)
+			return false;
+	}
+
+	memcpy(_buffer + _length, record, length);
+	_length += length;
+	_recordEnds[_records++] = (byte)_length;
+
+	return true;
+}
+
+// Sends all buffered records, as many whole records per uplink as the maximum payload allows.
+// The maximum payload is read for every uplink so a data rate change (e.g. ADR) never splits a record. An uplink the
+// mDot refuses is packed again if the data rate it reports has since dropped.
+// Returns false if a send failed (the records not sent stay buffered) or a record was dropped.
+boolean LoRamDotAggregator::Flush()
+{
+	boolean l_result = true;
+
+	while (_records > 0)
+	{
+		// Find the whole records that fit in one uplink
+		size_t l_maxPayload = MaxPayload();
+		byte l_records = 0;
+
+		while (l_records < _records && _recordEnds[l_records] <= l_maxPayload)
+			l_records++;
+
+		// A record larger than the new maximum payload can never be sent so it is dropped
+		if (l_records == 0)
+		{
+			l_records = 1;
+			_dropped++;
+			l_result = false;
+		}
+		else if (!_mDot->SendBinary(_buffer, _recordEnds[l_records - 1]))
+		{
+			if (_mDot->LastCommandStatusId() != COMMAND_STATUS_ID_ERROR)
+				return false;
+
+			// The uplink may be too large for a data rate lowered by ADR
+			_mDot->SessionDataRate();
+
+			if (_mDot->MaxPayload() >= _recordEnds[l_records - 1])
+				return false;
+
+			continue;
+		}
+
+		// Move the remaining records to the front
+		byte l_sent = _recordEnds[l_records - 1];
+
+		memmove(_buffer, _buffer + l_sent, _length - l_sent);
+		_length -= l_sent;
+
+		for (byte i = l_records; i < _records; i++)
+			_recordEnds[i - l_records] = _recordEnds[i] - l_sent;
+
+		_records -= l_records;
+	}
+
+	return l_result;
+}
+
+// Returns the number of bytes buffered.
+size_t LoRamDotAggregator::Length()
+{
+	return _length;
+}
+
+// Returns the number of records buffered.
+byte LoRamDotAggregator::Records()
+{
+	return _records;
+}
+
+// Returns the number of bytes that can be added before the next uplink is sent.
+size_t LoRamDotAggregator::Available()
+{
+	size_t l_maxPayload = MaxPayload();
+
+	return (_length < l_maxPayload) ? l_maxPayload - _length : 0;
+}
+
+// Returns the number of records dropped because they outgrew the maximum payload.
+unsigned int LoRamDotAggregator::Dropped()
+{
+	return _dropped;
+}
+
+// Returns the maximum payload, reading the data rate first if it is not known.
+// Until the data rate is known LoRamDot::MaxPayload() allows 242 bytes, more than the slow data rates carry.
+size_t LoRamDotAggregator::MaxPayload()
+{
+	if (_mDot->CurrentDataRate() == DATA_RATE_UNKNOWN)
+		_mDot->SessionDataRate();
+
+	return _mDot->MaxPayload();
+}
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotAggregator.h
+
+#ifndef _LORAMDOTAGGREGATOR_h
+	#define _LORAMDOTAGGREGATOR_h
+
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_AGGREGATOR_MAX_RECORDS
+	#define LORAMDOT_AGGREGATOR_MAX_RECORDS 32			// Records buffered before the aggregator flushes
+#endif
+
+// Buffers small application records and sends them together with SendBinary(), packing each uplink up to the
+// maximum payload of the current data rate (See LoRamDot::MaxPayload()). Records are never split across uplinks.
+// The data rate is read from the mDot (AT+SDR) when it is not known, and again when an uplink is refused.
+class LoRamDotAggregator
+{
+public:
+	LoRamDotAggregator(LoRamDot &mDot);
+
+	boolean Add(const uint8_t *record, size_t length);	// Buffers a record. If it does not fit in the current uplink the buffered records are sent first.
+														// Returns false if the record is larger than the maximum payload or the flush failed (the record is not buffered).
+	boolean Flush();									// Sends all buffered records, as many whole records per uplink as the maximum payload allows.
+														// Returns false if a send failed (the records not sent stay buffered) or a record was dropped.
+														// A record larger than a maximum payload lowered after it was buffered can never be sent and is dropped (See Dropped()).
+	size_t Length();									// Returns the number of bytes buffered.
+	byte Records();										// Returns the number of records buffered.
+	size_t Available();									// Returns the number of bytes that can be added before the next uplink is sent.
+	unsigned int Dropped();								// Returns the number of records dropped because they outgrew the maximum payload.
+
+private:
+	LoRamDot *_mDot;
+	uint8_t _buffer[PAYLOAD_SIZE_MAX];					// Buffered records
+	size_t _length = 0;									// Bytes buffered
+	byte _recordEnds[LORAMDOT_AGGREGATOR_MAX_RECORDS];	// Offset after the end of each buffered record
+	byte _records = 0;									// Records buffered
+	unsigned int _dropped = 0;							// Records dropped by Flush()
+
+	size_t MaxPayload();								// Returns the maximum payload, reading the data rate first if it is not known
+};
+
+#endif
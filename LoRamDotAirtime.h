@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotAirtime.h
+// Local LoRa time-on-air model (Semtech SX1272/76 datasheet formula) so airtime can be computed without asking the mDot.
+// All functions are constexpr: with constant arguments the time is evaluated at compile time, e.g.
+//		const unsigned long SENSOR_AIRTIME = LoRaWANTimeOnAir(FREQUENCY_BAND_EU, 5, 12);
+
+#ifndef _LORAMDOTAIRTIME_h
+	#define _LORAMDOTAIRTIME_h
+
+#include "LoRamDot.h"
+
+const byte LORAWAN_OVERHEAD = 13;						// MHDR (1), FHDR without options (7), FPort (1) and MIC (4) bytes added to the application payload
+const byte LORAWAN_PREAMBLE_SYMBOLS = 8;				// LoRaWAN preamble length in symbols
+const unsigned long LORA_BANDWIDTH_FSK = 0;				// Bandwidth value used for the EU868 DR7 FSK (50kbps) data rate
+
+// Symbol time in microseconds. Exact for the 125, 250 and 500kHz bandwidths.
+constexpr unsigned long LoRaSymbolTime(byte spreadingFactor, unsigned long bandwidth)
+{
+	return (1UL << spreadingFactor) * (1000000UL / bandwidth);
+}
+
+// 1 when low data rate optimisation is used (symbol time of 16ms or more).
+constexpr byte LoRaLowDataRateOptimize(byte spreadingFactor, unsigned long bandwidth)
+{
+	return (LoRaSymbolTime(spreadingFactor, bandwidth) >= 16000UL) ? 1 : 0;
+}
+
+// Rounds a positive division up and returns 0 for a negative or zero numerator.
+constexpr long LoRaCeilDivide(long numerator, long denominator)
+{
+	return (numerator <= 0) ? 0 : (numerator + denominator - 1) / denominator;
+}
+
+// Number of payload symbols (including the 8 symbol header block).
+// codingRate: 1-4 for 4/5-4/8 (FORWARD_ERROR_CORRECTION_REDUNDANCY_*).
+constexpr unsigned long LoRaPayloadSymbols(unsigned int phyPayload, byte spreadingFactor, unsigned long bandwidth, byte codingRate, bool crc, bool implicitHeader)
+{
+	return 8 + LoRaCeilDivide(8L * phyPayload - 4L * spreadingFactor + 28 + (crc ? 16 : 0) - (implicitHeader ? 20 : 0),
+		4L * (spreadingFactor - 2 * LoRaLowDataRateOptimize(spreadingFactor, bandwidth))) * (codingRate + 4);
+}
+
+// Time on air of a LoRa packet in microseconds.
+constexpr unsigned long LoRaTimeOnAirMicros(unsigned int phyPayload, byte spreadingFactor, unsigned long bandwidth, byte codingRate,
+	unsigned int preambleSymbols = LORAWAN_PREAMBLE_SYMBOLS, bool crc = true, bool implicitHeader = false)
+{
+	// Preamble is preambleSymbols + 4.25 symbols so the sum is kept in quarter symbols
+	return ((4UL * preambleSymbols + 17 + 4UL * LoRaPayloadSymbols(phyPayload, spreadingFactor, bandwidth, codingRate, crc, implicitHeader))
+		* LoRaSymbolTime(spreadingFactor, bandwidth)) / 4;
+}
+
+// Time on air of an FSK (50kbps) packet in microseconds: preamble (5), sync word (3), length (1), payload and CRC (2) bytes at 20us per bit.
+constexpr unsigned long FSKTimeOnAirMicros(unsigned int phyPayload)
+{
+	return (5UL + 3 + 1 + phyPayload + 2) * 8 * 20;
+}
+
+// Spreading factor of a LoRaWAN data rate (0 for FSK).
+constexpr byte LoRaWANSpreadingFactor(byte band, byte dataRate)
+{
+	return (band == FREQUENCY_BAND_EU)
+		? ((dataRate <= 5) ? 12 - dataRate : (dataRate == 6) ? 7 : 0)
+		: ((dataRate <= 3) ? 10 - dataRate : (dataRate == 4) ? 8 : (dataRate >= 8 && dataRate <= 13) ? 20 - dataRate : 0);
+}
+
+// Bandwidth (Hz) of a LoRaWAN data rate (LORA_BANDWIDTH_FSK for FSK).
+constexpr unsigned long LoRaWANBandwidth(byte band, byte dataRate)
+{
+	return (band == FREQUENCY_BAND_EU)
+		? ((dataRate <= 5) ? 125000UL : (dataRate == 6) ? 250000UL : LORA_BANDWIDTH_FSK)
+		: ((dataRate <= 3) ? 125000UL : 500000UL);
+}
+
+// Time on air in milliseconds (rounded up) of an uplink with the given application payload.
+// band: FREQUENCY_BAND_US_AU or FREQUENCY_BAND_EU. dataRate: DR number. payload: Application payload bytes (0-242).
+// codingRate: FORWARD_ERROR_CORRECTION_REDUNDANCY_* (Default 4/5).
+constexpr unsigned long LoRaWANTimeOnAir(byte band, byte dataRate, byte payload, byte codingRate = FORWARD_ERROR_CORRECTION_REDUNDANCY_5_BITS)
+{
+	return (LoRaWANBandwidth(band, dataRate) == LORA_BANDWIDTH_FSK)
+		? (FSKTimeOnAirMicros(payload + LORAWAN_OVERHEAD) + 999) / 1000
+		: (LoRaWANSpreadingFactor(band, dataRate) == 0)
+			? 0		// Reserved data rate
+			: (LoRaTimeOnAirMicros(payload + LORAWAN_OVERHEAD, LoRaWANSpreadingFactor(band, dataRate), LoRaWANBandwidth(band, dataRate), codingRate) + 999) / 1000;
+}
+
+#endif
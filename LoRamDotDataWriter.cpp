@@ -0,0 +1,251 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoRamDotDataWriter.h"
+
+// Data Writer Constructor
+// Data is streamed through the given mDot's serial port.
+LoRamDotDataWriter::LoRamDotDataWriter(LoRamDot &mDot) : _mDot(&mDot)
+{
+
+}
+
+// Sets the function that reads the mDot's CTS line (NULL: no flow control).
+void LoRamDotDataWriter::setClearToSend(ClearToSendCallback callback)
+{
+	_clearToSend = callback;
+}
+
+// Reads the wake settings (AT&V) and enters serial data mode (AT+SD). Returns false if a command failed or ADR is on.
+// With adaptive data rate on the network could lower the data rate below the packet size while no AT command can be sent.
+boolean LoRamDotDataWriter::Begin()
+{
+	if (_state != DATA_WRITER_IDLE)
+		return true;
+
+	LoRamDotSnapshot l_snapshot;
+
+	if (!_mDot->ReadSnapshot(l_snapshot) || l_snapshot.adaptiveDataRate == ENABLED)
+		return false;
+
+	_wakeMode = (l_snapshot.wakeMode == 1) ? 1 : 0;
+	_wakeInterval = l_snapshot.wakeInterval * 1000UL;
+	_wakeDelay = (l_snapshot.wakeDelay > 0) ? l_snapshot.wakeDelay : WAKE_DELAY_DEFAULT;
+	_wakeTimeout = (l_snapshot.wakeTimeout > 0) ? l_snapshot.wakeTimeout : WAKE_TIMEOUT_DEFAULT;
+
+	// The time on air of each packet is estimated locally, as no AT command can be sent in serial data mode
+	if (_mDot->CurrentDataRate() == DATA_RATE_UNKNOWN)
+		_mDot->SessionDataRate();
+
+	_packetSize = _mDot->MaxPayload();
+
+	if (_packetSize > SERIAL_DATA_BUFFER_SIZE)
+		_packetSize = SERIAL_DATA_BUFFER_SIZE;
+
+	if (!_mDot->SerialDataMode())
+		return false;
+
+	_serial = &_mDot->SerialStream();
+	_packetLength = 0;
+	_packets = 0;
+	_wakeAt = millis();
+	_state = DATA_WRITER_AWAKE;
+
+	return true;
+}
+
+// Buffers a byte. Returns 0 if the buffer is full or the writer has not begun.
+size_t LoRamDotDataWriter::write(uint8_t c)
+{
+	if (_state == DATA_WRITER_IDLE || _pending == LORAMDOT_DATA_WRITER_BUFFER_SIZE)
+		return 0;
+
+	_buffer[(_head + _pending) % LORAMDOT_DATA_WRITER_BUFFER_SIZE] = c;
+	_pending++;
+
+	return 1;
+}
+
+// Buffers as many bytes as fit and returns the number buffered.
+size_t LoRamDotDataWriter::write(const uint8_t *buffer, size_t size)
+{
+	size_t l_written = 0;
+
+	while (l_written < size && write(buffer[l_written]) == 1)
+		l_written++;
+
+	return l_written;
+}
+
+// Writes the next packet when the mDot is awake. Returns the writer state (DATA_WRITER_*).
+// Call from loop() at least every few milliseconds: in interval wake mode the first byte must arrive within the
+// wake delay (AT+WD, default 100 ms) of the mDot waking.
+byte LoRamDotDataWriter::Poll()
+{
+	if (_state == DATA_WRITER_IDLE)
+		return _state;
+
+	unsigned long l_now = millis();
+
+	if (_packetLength == 0)
+	{
+		// Part of the wake window is kept clear at each end in case the clocks differ
+		unsigned long l_margin = (_wakeDelay > 2 * DATA_WRITER_MARGIN) ? DATA_WRITER_MARGIN : _wakeDelay / 4;
+
+		// In interval wake mode a wake window that passes without data is followed by another wake interval
+		if (_wakeMode == 0)
+		{
+			while ((long)(l_now - (_wakeAt + _wakeDelay - l_margin)) >= 0)
+				_wakeAt += _wakeDelay + _wakeInterval;
+		}
+
+		if ((long)(l_now - (_wakeAt + l_margin)) < 0)
+		{
+			_state = DATA_WRITER_SLEEPING;
+			return _state;
+		}
+
+		_state = DATA_WRITER_AWAKE;
+
+		if (_pending == 0)
+			return _state;
+	}
+	else
+	{
+		unsigned long l_gap = l_now - _lastByte;
+
+		// The mDot ends a packet once no byte has arrived for the wake timeout. A byte written close to that edge
+		// could land in either packet, so the packet is only continued in the first half of the timeout.
+		if (l_gap >= _wakeTimeout + DATA_WRITER_MARGIN)
+		{
+			ClosePacket(_lastByte + _wakeTimeout);
+			return _state;
+		}
+
+		if (_pending == 0 || l_gap * 2 >= _wakeTimeout)
+			return _state;
+	}
+
+	// Write the packet without a gap, as far as the buffered data and CTS allow
+	size_t l_written = 0;
+
+	while (_pending > 0 && _packetLength < _packetSize)
+	{
+		size_t l_count = LORAMDOT_DATA_WRITER_BUFFER_SIZE - _head;
+
+		if (l_count > _pending)
+			l_count = _pending;
+		if (l_count > _packetSize - _packetLength)
+			l_count = _packetSize - _packetLength;
+
+		if (_clearToSend != NULL)
+		{
+			if (!_clearToSend())
+				break;
+
+			// CTS is checked before every byte
+			l_count = 1;
+		}
+
+		l_count = _serial->write(_buffer + _head, l_count);
+
+		if (l_count == 0)
+			break;
+
+		_head = (_head + l_count) % LORAMDOT_DATA_WRITER_BUFFER_SIZE;
+		_pending -= l_count;
+		_packetLength += l_count;
+		l_written += l_count;
+	}
+
+	if (l_written > 0)
+		_lastByte = millis();
+
+	// A full packet is sent at once
+	if (_packetLength == _packetSize)
+		ClosePacket(_lastByte);
+	else
+		_state = (_pending > 0 && _packetLength < _packetSize) ? DATA_WRITER_BLOCKED : DATA_WRITER_AWAKE;
+
+	return _state;
+}
+
+// Sends the buffered data, waits for the last packet to go out and escapes to AT mode. Blocks.
+// The escape is written in a wake window so the mDot reads it with an empty buffer. If nothing can be written for a
+// whole wake cycle (CTS stays deasserted) the data left is dropped and the escape still made, and false is returned.
+boolean LoRamDotDataWriter::End()
+{
+	if (_state == DATA_WRITER_IDLE)
+		return true;
+
+	unsigned long l_stall = _wakeDelay + ((_wakeMode == 0) ? _wakeInterval : 0) + DATA_WRITER_RECEIVE_WINDOWS
+		+ _mDot->EstimateTimeOnAir((byte)_packetSize) + DATA_WRITER_STALL_TIMEOUT;
+	unsigned long l_progress = millis();
+	size_t l_pending = _pending;
+	boolean l_result = true;
+	byte l_state = Poll();
+
+	while (_pending > 0 || _packetLength > 0 || l_state != DATA_WRITER_AWAKE)
+	{
+		l_state = Poll();
+
+		if (_pending != l_pending)
+		{
+			l_pending = _pending;
+			l_progress = millis();
+		}
+		else if (_pending > 0 && millis() - l_progress >= l_stall)
+		{
+			_head = (_head + _pending) % LORAMDOT_DATA_WRITER_BUFFER_SIZE;
+			_pending = 0;
+			l_pending = 0;
+			l_result = false;
+		}
+	}
+
+	_state = DATA_WRITER_IDLE;
+
+	return _mDot->EscapeSerialDataMode() && l_result;
+}
+
+// Returns the bytes buffered and not yet written to the mDot.
+size_t LoRamDotDataWriter::Pending()
+{
+	return _pending;
+}
+
+// Returns the packets the mDot has been given since Begin().
+unsigned long LoRamDotDataWriter::Packets()
+{
+	return _packets;
+}
+
+// Returns the largest packet written (the maximum payload, at most SERIAL_DATA_BUFFER_SIZE).
+size_t LoRamDotDataWriter::PacketSize()
+{
+	return _packetSize;
+}
+
+// Ends the current packet and predicts when the mDot next wakes: after the packet's time on air, its receive
+// windows and, in interval wake mode, the wake interval.
+void LoRamDotDataWriter::ClosePacket(unsigned long closedAt)
+{
+	_packets++;
+	_wakeAt = closedAt + _mDot->EstimateTimeOnAir((byte)_packetLength) + DATA_WRITER_RECEIVE_WINDOWS
+		+ ((_wakeMode == 0) ? _wakeInterval : 0);
+	_packetLength = 0;
+	_state = DATA_WRITER_SLEEPING;
+}
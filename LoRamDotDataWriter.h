@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotDataWriter.h
+
+#ifndef _LORAMDOTDATAWRITER_h
+	#define _LORAMDOTDATAWRITER_h
+
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_DATA_WRITER_BUFFER_SIZE
+	#if defined(__AVR__)
+		#define LORAMDOT_DATA_WRITER_BUFFER_SIZE 256		// Bytes of application data waiting to be written
+	#else
+		#define LORAMDOT_DATA_WRITER_BUFFER_SIZE 2048		// Bytes of application data waiting to be written
+	#endif
+#endif
+
+typedef boolean (*ClearToSendCallback)();				// Returns true while the mDot's CTS line allows data, e.g. digitalRead(ctsPin) == LOW (see HardWareFlowControl())
+
+														// Data Writer States (returned by Poll())
+const byte DATA_WRITER_IDLE = 0;						// The mDot is in AT command mode
+const byte DATA_WRITER_AWAKE = 1;						// The mDot is reading data into a packet
+const byte DATA_WRITER_BLOCKED = 2;						// The mDot is awake but CTS is holding off the data
+const byte DATA_WRITER_SLEEPING = 3;					// The mDot is sending a packet and then sleeping until it wakes to read data
+
+const unsigned long DATA_WRITER_RECEIVE_WINDOWS = 2000;	// Milliseconds from the end of a packet to the end of its receive windows (receive delay of 1 second)
+const unsigned long DATA_WRITER_MARGIN = 20;			// Milliseconds kept clear of the edges of the mDot's wake window and WTO timer
+const unsigned long WAKE_DELAY_DEFAULT = 100;			// Milliseconds the mDot waits for data after waking (AT+WD)
+const unsigned long WAKE_TIMEOUT_DEFAULT = 20;			// Milliseconds without data that end a packet (AT+WTO)
+const unsigned long DATA_WRITER_STALL_TIMEOUT = 1000;	// Milliseconds beyond a whole wake cycle that End() waits for CTS before dropping the data left
+
+// Streams application data through the mDot's serial data mode (AT+SD), so bulk transfers need no AT command per
+// packet. Bytes written (it is a Print) are buffered and Poll() feeds them to the mDot one packet at a time: up to
+// the maximum payload at the current data rate (never more than the 512 byte firmware buffer), written without a
+// gap so the mDot's WTO timer only ends the packet once it is complete. After each packet the writer waits for the
+// time on air, the receive windows and, in interval wake mode, the wake interval, and writes the next packet within
+// the mDot's wake delay. The wake settings are read from the mDot by Begin(). A ClearToSendCallback holds the data
+// off while CTS is not asserted. End() sends what is left, waits for it to go out and escapes back to AT mode (+++).
+// A packet that starts with "+++" is taken as the escape by the mDot. Adaptive data rate must be off: no AT command
+// can be sent in serial data mode, so a data rate lowered by the network would go unseen and packets sized for the
+// old rate would be refused.
+class LoRamDotDataWriter : public Print
+{
+public:
+	LoRamDotDataWriter(LoRamDot &mDot);
+
+	void setClearToSend(ClearToSendCallback callback);	// Sets the function that reads the mDot's CTS line (NULL: no flow control).
+
+	boolean Begin();									// Reads the wake settings (AT&V) and enters serial data mode (AT+SD). Returns false if a command failed or ADR is on.
+	size_t write(uint8_t c);							// Buffers a byte. Returns 0 if the buffer is full or the writer has not begun.
+	size_t write(const uint8_t *buffer, size_t size);	// Buffers as many bytes as fit and returns the number buffered.
+	using Print::write;
+	byte Poll();										// Writes the next packet when the mDot is awake. Returns the writer state (DATA_WRITER_*).
+	boolean End();										// Sends the buffered data, waits for the last packet to go out and escapes to AT mode. Blocks.
+														// Returns false if the escape failed or CTS held the data off for a whole wake cycle (the data left is dropped).
+
+	size_t Pending();									// Returns the bytes buffered and not yet written to the mDot.
+	unsigned long Packets();							// Returns the packets the mDot has been given since Begin().
+	size_t PacketSize();								// Returns the largest packet written (the maximum payload, at most SERIAL_DATA_BUFFER_SIZE).
+
+private:
+	LoRamDot *_mDot;
+	Stream *_serial = NULL;
+	ClearToSendCallback _clearToSend = NULL;
+	byte _state = DATA_WRITER_IDLE;						// DATA_WRITER_*
+
+	uint8_t _buffer[LORAMDOT_DATA_WRITER_BUFFER_SIZE];	// Buffered data, oldest at _head
+	size_t _head = 0;									// Index of the oldest buffered byte
+	size_t _pending = 0;								// Bytes buffered
+
+	byte _wakeMode = 0;									// 0 interval, 1 interrupt (AT+WM)
+	unsigned long _wakeInterval = 0;					// Milliseconds the mDot sleeps between wake windows (AT+WI)
+	unsigned long _wakeDelay = WAKE_DELAY_DEFAULT;		// Milliseconds the mDot waits for the first byte after waking (AT+WD)
+	unsigned long _wakeTimeout = WAKE_TIMEOUT_DEFAULT;	// Milliseconds without data that end a packet (AT+WTO)
+
+	size_t _packetSize = 0;								// Bytes in a full packet
+	size_t _packetLength = 0;							// Bytes written to the current packet
+	unsigned long _lastByte = 0;						// millis() when the last byte of the current packet was written
+	unsigned long _wakeAt = 0;							// millis() when the mDot wakes (or woke) to read data
+	unsigned long _packets = 0;							// Packets given to the mDot
+
+	void ClosePacket(unsigned long closedAt);			// Ends the current packet and predicts when the mDot next wakes
+};
+
+#endif
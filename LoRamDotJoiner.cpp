@@ -0,0 +1,275 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoRamDotJoiner.h"
+
+// Joiner Constructor
+// Join requests are made through the given mDot.
+LoRamDotJoiner::LoRamDotJoiner(LoRamDot &mDot) : _mDot(&mDot)
+{
+
+}
+
+// Sets the back off after the first failure and the longest back off in milliseconds.
+void LoRamDotJoiner::setBackoff(unsigned long base, unsigned long maximum)
+{
+	_backoffBase = (base < 1) ? 1 : base;
+	_backoffMaximum = (maximum < _backoffBase) ? _backoffBase : maximum;
+}
+
+// Sets the milliseconds over which the first join request is randomly delayed (0: join at once).
+void LoRamDotJoiner::setStartSpread(unsigned long spread)
+{
+	_startSpread = spread;
+}
+
+// Sets the data rates swept, from first to last (e.g. DR5 to DR0).
+void LoRamDotJoiner::setDataRates(byte first, byte last)
+{
+	_firstDataRate = (first > 15) ? 15 : first;
+	_lastDataRate = (last > 15) ? 15 : last;
+}
+
+// Sets the sub-bands swept on US915/AU915 (bit 0: sub-band 1 ... bit 7: sub-band 8). 0 keeps the mDot's sub-band.
+void LoRamDotJoiner::setSubBands(byte mask)
+{
+	_subBands = mask;
+}
+
+// Sets the join requests made at each data rate and sub-band before stepping (1-255).
+void LoRamDotJoiner::setAttemptsPerStep(byte attempts)
+{
+	_attemptsPerStep = (attempts < 1) ? 1 : attempts;
+}
+
+// Sets the join requests made before giving up (0: keep trying).
+void LoRamDotJoiner::setMaximumAttempts(unsigned int attempts)
+{
+	_maximumAttempts = attempts;
+}
+
+// Starts joining. Returns false if a command is still waiting.
+// The first join request is made at a random time within the start spread.
+boolean LoRamDotJoiner::Start()
+{
+	if (_mDot->Poll() == COMMAND_STATE_WAITING)
+		return false;
+
+	if (_firstDataRate == DATA_RATE_UNKNOWN || _lastDataRate == DATA_RATE_UNKNOWN)
+		setDataRates((_mDot->FrequencyBandId() == FREQUENCY_BAND_EU) ? 5 : 3, 0);
+
+	// One join request per AT+JOIN, so every request is paced by the back off
+	_mDot->JoinRetries(1);
+
+	_restoreDataRate = (_mDot->CurrentDataRate() != DATA_RATE_UNKNOWN) ? _mDot->CurrentDataRate() : _firstDataRate;
+	_attempts = 0;
+	_failures = 0;
+	_stepAttempts = 0;
+	_dataRate = _firstDataRate;
+	_subBand = 0;
+	_configured = false;
+
+	if (_subBands != 0 && _mDot->FrequencyBandId() == FREQUENCY_BAND_US_AU)
+	{
+		while ((_subBands & (1 << _subBand)) == 0)
+			_subBand++;
+
+		_subBand++;
+	}
+
+	_startTime = millis();
+	_nextAttempt = _startTime + ((_startSpread > 0) ? (unsigned long)random((long)_startSpread) : 0);
+	_state = JOINER_WAITING;
+
+	return true;
+}
+
+// Makes the next join request when due and reads its response. Returns the joiner state (JOINER_*).
+// Call from loop(). Only the sub-band and data rate changes wait for the mDot's response. A join request that cannot
+// be started is retried after a back off. Once joined the data rate in effect before Start() is restored.
+byte LoRamDotJoiner::Poll()
+{
+	if (_state == JOINER_WAITING)
+	{
+		if ((long)(millis() - _nextAttempt) < 0 || _mDot->Poll() == COMMAND_STATE_WAITING)
+			return _state;
+
+		if (!_configured && !Configure())
+		{
+			Backoff();
+			return _state;
+		}
+
+		if (_mDot->BeginJoin())
+		{
+			_attempts++;
+			_stepAttempts++;
+			_state = JOINER_JOINING;
+		}
+		else
+			Backoff();
+
+		return _state;
+	}
+
+	if (_state == JOINER_JOINING)
+	{
+		if (_mDot->Poll() == COMMAND_STATE_WAITING)
+			return _state;
+
+		if (_mDot->LastCommandStatus())
+		{
+			// The sweep may have left the mDot at a slow data rate with a small maximum payload
+			if (_dataRate != _restoreDataRate)
+				_mDot->TXDataRate("DR" + String(_restoreDataRate));
+
+			_state = JOINER_JOINED;
+		}
+		else if (_maximumAttempts != 0 && _attempts >= _maximumAttempts)
+			_state = JOINER_FAILED;
+		else
+		{
+			// Back off from the time on air of the request just made, then step
+			Backoff();
+
+			if (_stepAttempts >= _attemptsPerStep)
+				Step();
+
+			_state = JOINER_WAITING;
+		}
+	}
+
+	return _state;
+}
+
+// Stops joining. A join request in progress still completes through the mDot's Poll().
+void LoRamDotJoiner::Stop()
+{
+	_state = JOINER_IDLE;
+}
+
+// Returns the joiner state (JOINER_*).
+byte LoRamDotJoiner::State()
+{
+	return _state;
+}
+
+// Returns the join requests made since Start().
+unsigned int LoRamDotJoiner::Attempts()
+{
+	return _attempts;
+}
+
+// Returns the data rate of the current (or next) join request.
+byte LoRamDotJoiner::DataRate()
+{
+	return _dataRate;
+}
+
+// Returns the sub-band of the current (or next) join request (0 if the sub-band is not swept).
+byte LoRamDotJoiner::SubBand()
+{
+	return _subBand;
+}
+
+// Returns the milliseconds until the next join request (0 if one is due or in progress).
+unsigned long LoRamDotJoiner::NextAttempt()
+{
+	if (_state != JOINER_WAITING)
+		return 0;
+
+	long l_wait = (long)(_nextAttempt - millis());
+
+	return (l_wait > 0) ? (unsigned long)l_wait : 0;
+}
+
+// Moves to the next data rate, or the first data rate of the next sub-band.
+void LoRamDotJoiner::Step()
+{
+	_stepAttempts = 0;
+	_configured = false;
+
+	if (_dataRate != _lastDataRate)
+	{
+		if (_firstDataRate > _lastDataRate)
+			_dataRate--;
+		else
+			_dataRate++;
+
+		return;
+	}
+
+	_dataRate = _firstDataRate;
+
+	if (_subBand == 0)
+		return;
+
+	// Next sub-band in the mask, wrapping to the first
+	for (byte i = 0; i < 8; i++)
+	{
+		byte l_subBand = (byte)((_subBand + i) % 8 + 1);
+
+		if (_subBands & (1 << (l_subBand - 1)))
+		{
+			_subBand = l_subBand;
+			return;
+		}
+	}
+}
+
+// Sends the current step's sub-band and data rate to the mDot.
+boolean LoRamDotJoiner::Configure()
+{
+	if (_subBand != 0 && !_mDot->FrequencySubBand(_subBand))
+		return false;
+
+	if (!_mDot->TXDataRate("DR" + String(_dataRate)))
+		return false;
+
+	_configured = true;
+
+	return true;
+}
+
+// Schedules the next join request after a failure.
+// The back off doubles with each failure up to the maximum. Half of it is fixed and half random, so nodes that failed
+// together spread out, and it is never shorter than the off time the join duty cycle requires after the request.
+void LoRamDotJoiner::Backoff()
+{
+	if (_failures < 0xFF)
+		_failures++;
+
+	unsigned long l_window = _backoffBase;
+
+	for (byte i = 1; i < _failures && l_window < _backoffMaximum; i++)
+		l_window = (l_window > _backoffMaximum / 2) ? _backoffMaximum : l_window * 2;
+
+	if (l_window > _backoffMaximum)
+		l_window = _backoffMaximum;
+
+	unsigned long l_backoff = l_window / 2 + (unsigned long)random((long)(l_window - l_window / 2) + 1);
+
+	// Join duty cycle: 1% in the first hour, 0.1% for the next 10 hours and 0.01% after that
+	unsigned long l_elapsed = millis() - _startTime;
+	unsigned int l_dutyCycle = (l_elapsed < JOIN_DUTY_CYCLE_PERIOD_1) ? JOIN_DUTY_CYCLE_1
+		: (l_elapsed < JOIN_DUTY_CYCLE_PERIOD_2) ? JOIN_DUTY_CYCLE_2 : JOIN_DUTY_CYCLE_3;
+	unsigned long l_offTime = _mDot->EstimateTimeOnAir(JOIN_REQUEST_PAYLOAD) * (l_dutyCycle - 1);
+
+	if (l_backoff < l_offTime)
+		l_backoff = l_offTime;
+
+	_nextAttempt = millis() + l_backoff;
+}
@@ -0,0 +1,99 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotJoiner.h
+
+#ifndef _LORAMDOTJOINER_h
+	#define _LORAMDOTJOINER_h
+
+#include "LoRamDot.h"
+
+														// Joiner States (returned by Poll())
+const byte JOINER_IDLE = 0;								// Not started, or stopped with Stop()
+const byte JOINER_WAITING = 1;							// Waiting for the randomized back off to end before the next join request
+const byte JOINER_JOINING = 2;							// A join request is in progress
+const byte JOINER_JOINED = 3;							// The network was joined
+const byte JOINER_FAILED = 4;							// The maximum number of join requests failed (see setMaximumAttempts())
+
+														// Joiner Defaults
+const unsigned long JOINER_START_SPREAD = 10000;		// Milliseconds over which the first join request is spread, so nodes powered up together do not join together
+const unsigned long JOINER_BACKOFF_BASE = 10000;		// Milliseconds of back off after the first failed join request, doubled after each further failure
+const unsigned long JOINER_BACKOFF_MAXIMUM = 3600000;	// Longest back off in milliseconds (1 hour)
+const byte JOINER_ATTEMPTS_PER_STEP = 2;				// Join requests made at each data rate before stepping to the next
+const byte JOIN_REQUEST_PAYLOAD = 10;					// Application payload bytes that, with LORAWAN_OVERHEAD, give the 23 byte join request
+
+														// Join Request Duty Cycle (LoRaWAN 1.0.2 section 7, 1 / off time factor)
+const unsigned long JOIN_DUTY_CYCLE_PERIOD_1 = 3600000;	// Up to 1 hour after Start() ...
+const unsigned int JOIN_DUTY_CYCLE_1 = 100;				// ... join requests may be on air 1% of the time
+const unsigned long JOIN_DUTY_CYCLE_PERIOD_2 = 39600000;	// Up to 11 hours after Start() ...
+const unsigned int JOIN_DUTY_CYCLE_2 = 1000;			// ... 0.1%
+const unsigned int JOIN_DUTY_CYCLE_3 = 10000;			// After that 0.01%
+
+// Joins the network without blocking. Each failed join request is followed by a randomized exponential back off
+// (half the doubling back off plus a random part up to the other half). The back off never allows more join request
+// time on air than the LoRaWAN join duty cycle. After setAttemptsPerStep() failures at one data rate the next, slower,
+// data rate is tried. On US915/AU915 each sub-band set with setSubBands() is then swept the same way. The mDot is set
+// to make one join request per AT+JOIN (AT+JR=1) so the back off is applied between every request. Once joined the
+// data rate in effect before Start() (the first swept data rate if it was not known) is set again.
+class LoRamDotJoiner
+{
+public:
+	LoRamDotJoiner(LoRamDot &mDot);
+
+	void setBackoff(unsigned long base, unsigned long maximum);	// Sets the back off after the first failure and the longest back off in milliseconds.
+	void setStartSpread(unsigned long spread);			// Sets the milliseconds over which the first join request is randomly delayed (0: join at once).
+	void setDataRates(byte first, byte last);			// Sets the data rates swept, from first to last (e.g. DR5 to DR0). Default: DR3-DR0 (US915/AU915), DR5-DR0 (EU868).
+	void setSubBands(byte mask);						// Sets the sub-bands swept on US915/AU915 (bit 0: sub-band 1 ... bit 7: sub-band 8). 0 (Default) keeps the mDot's sub-band.
+	void setAttemptsPerStep(byte attempts);				// Sets the join requests made at each data rate and sub-band before stepping (1-255).
+	void setMaximumAttempts(unsigned int attempts);		// Sets the join requests made before giving up (0 [Default]: keep trying).
+
+	boolean Start();									// Starts joining. Returns false if a command is still waiting.
+	byte Poll();										// Makes the next join request when due and reads its response. Returns the joiner state (JOINER_*).
+	void Stop();										// Stops joining. A join request in progress still completes through the mDot's Poll().
+
+	byte State();										// Returns the joiner state (JOINER_*).
+	unsigned int Attempts();							// Returns the join requests made since Start().
+	byte DataRate();									// Returns the data rate of the current (or next) join request.
+	byte SubBand();										// Returns the sub-band of the current (or next) join request (0 if the sub-band is not swept).
+	unsigned long NextAttempt();						// Returns the milliseconds until the next join request (0 if one is due or in progress).
+
+private:
+	LoRamDot *_mDot;
+	byte _state = JOINER_IDLE;							// JOINER_*
+	unsigned long _backoffBase = JOINER_BACKOFF_BASE;	// Back off after the first failure
+	unsigned long _backoffMaximum = JOINER_BACKOFF_MAXIMUM;	// Longest back off
+	unsigned long _startSpread = JOINER_START_SPREAD;	// Spread of the first join request
+	byte _firstDataRate = DATA_RATE_UNKNOWN;			// Data rate of the first step (DATA_RATE_UNKNOWN until the default for the frequency band is set)
+	byte _lastDataRate = DATA_RATE_UNKNOWN;				// Data rate of the last step
+	byte _subBands = 0;									// Sub-bands swept (bit 0: sub-band 1)
+	byte _attemptsPerStep = JOINER_ATTEMPTS_PER_STEP;	// Join requests at each data rate and sub-band
+	unsigned int _maximumAttempts = 0;					// Join requests before giving up (0: no limit)
+
+	unsigned long _startTime = 0;						// millis() at Start() (selects the join duty cycle)
+	unsigned long _nextAttempt = 0;						// millis() when the next join request is due
+	unsigned int _attempts = 0;							// Join requests made
+	byte _failures = 0;									// Consecutive failures (doubles the back off up to the maximum)
+	byte _stepAttempts = 0;								// Join requests made at the current step
+	byte _dataRate = DATA_RATE_UNKNOWN;					// Data rate of the current step
+	byte _restoreDataRate = DATA_RATE_UNKNOWN;			// Data rate set again once joined (in effect before Start())
+	byte _subBand = 0;									// Sub-band of the current step (0: not swept)
+	boolean _configured = false;						// The current step's data rate and sub-band have been sent to the mDot
+
+	void Step();										// Moves to the next data rate, or the first data rate of the next sub-band
+	boolean Configure();								// Sends the current step's sub-band and data rate to the mDot
+	void Backoff();										// Schedules the next join request after a failure
+};
+
+#endif
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoRamDotLinkWindow.h"
+
+// Link Window Constructor
+// low: Value at the start of the first percentile bucket. width: Bucket width (LINK_WINDOW_RSSI_* or LINK_WINDOW_SNR_*).
+LoRamDotLinkWindow::LoRamDotLinkWindow(int16_t low, int16_t width) : _low(low), _width((width < 1) ? 1 : width)
+{
+	Clear();
+}
+
+// Returns the histogram bucket of a value (clamped to the first and last bucket).
+byte LoRamDotLinkWindow::Bucket(int16_t value)
+{
+	long l_bucket = ((long)value - _low) / _width;
+
+	if (l_bucket < 0)
+		return 0;
+	if (l_bucket >= LORAMDOT_LINK_WINDOW_BUCKETS)
+		return LORAMDOT_LINK_WINDOW_BUCKETS - 1;
+
+	return (byte)l_bucket;
+}
+
+// Adds a sample, replacing the oldest once the window is full.
+void LoRamDotLinkWindow::Add(int16_t value)
+{
+	if (_count == LORAMDOT_LINK_WINDOW_SIZE)
+	{
+		int16_t l_oldest = _samples[_head];
+
+		// Every remaining sample moves one position older
+		_sum -= l_oldest;
+		_weightedSum -= _sum;
+		_buckets[Bucket(l_oldest)]--;
+		_count--;
+	}
+
+	_samples[_head] = value;
+
+	if (++_head == LORAMDOT_LINK_WINDOW_SIZE)
+		_head = 0;
+
+	_weightedSum += (long)_count * value;
+	_sum += value;
+	_buckets[Bucket(value)]++;
+	_count++;
+}
+
+// Adds the last packet value of an RSSI or SNR reading.
+void LoRamDotLinkWindow::Add(const LoRamDotSignal &signal)
+{
+	Add(signal.last);
+}
+
+// Discards all samples.
+void LoRamDotLinkWindow::Clear()
+{
+	memset(_buckets, 0, sizeof(_buckets));
+	_head = 0;
+	_count = 0;
+	_sum = 0;
+	_weightedSum = 0;
+}
+
+// Returns the number of samples held.
+byte LoRamDotLinkWindow::Count()
+{
+	return _count;
+}
+
+// Returns the newest sample (0 if there are none).
+int16_t LoRamDotLinkWindow::Last()
+{
+	if (_count == 0)
+		return 0;
+
+	return _samples[(_head == 0) ? LORAMDOT_LINK_WINDOW_SIZE - 1 : _head - 1];
+}
+
+// Returns the mean of the samples, rounded (0 if there are none).
+int16_t LoRamDotLinkWindow::Mean()
+{
+	if (_count == 0)
+		return 0;
+
+	long l_half = (_sum < 0) ? -(long)(_count / 2) : (long)(_count / 2);
+
+	return (int16_t)((_sum + l_half) / _count);
+}
+
+// Returns the value below which percent (0-100) of the samples fall, to the bucket width (0 if there are none).
+// The middle of the bucket holding the sample is returned.
+int16_t LoRamDotLinkWindow::Percentile(byte percent)
+{
+	if (_count == 0)
+		return 0;
+
+	if (percent > 100)
+		percent = 100;
+
+	// Rank of the sample (1 to _count)
+	unsigned int l_rank = ((unsigned int)percent * _count + 99) / 100;
+	unsigned int l_seen = 0;
+
+	if (l_rank == 0)
+		l_rank = 1;
+
+	for (byte i = 0; i < LORAMDOT_LINK_WINDOW_BUCKETS; i++)
+	{
+		l_seen += _buckets[i];
+
+		if (l_seen >= l_rank)
+			return (int16_t)(_low + (long)i * _width + _width / 2);
+	}
+
+	return (int16_t)(_low + (long)(LORAMDOT_LINK_WINDOW_BUCKETS - 1) * _width + _width / 2);
+}
+
+// Returns the least squares slope of the samples in value units per sample (positive: improving RSSI/SNR).
+float LoRamDotLinkWindow::Trend()
+{
+	if (_count < 2)
+		return 0;
+
+	// Positions 0 to n-1: sum n(n-1)/2, sum of squares (n-1)n(2n-1)/6
+	float l_n = _count;
+	float l_sumX = l_n * (l_n - 1) / 2;
+	float l_sumXX = (l_n - 1) * l_n * (2 * l_n - 1) / 6;
+
+	return (l_n * _weightedSum - l_sumX * _sum) / (l_n * l_sumXX - l_sumX * l_sumX);
+}
@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotLinkWindow.h
+
+#ifndef _LORAMDOTLINKWINDOW_h
+	#define _LORAMDOTLINKWINDOW_h
+
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_LINK_WINDOW_SIZE
+	#if defined(__AVR__)
+		#define LORAMDOT_LINK_WINDOW_SIZE 16				// Samples kept in a link window
+	#else
+		#define LORAMDOT_LINK_WINDOW_SIZE 64				// Samples kept in a link window
+	#endif
+#endif
+
+#ifndef LORAMDOT_LINK_WINDOW_BUCKETS
+	#define LORAMDOT_LINK_WINDOW_BUCKETS 64				// Histogram buckets used for the percentiles
+#endif
+
+														// Link Window Ranges (lowest value, bucket width)
+const int16_t LINK_WINDOW_RSSI_LOW = -150;				// RSSI in dBm: -150 to +42 dBm in 3 dB buckets
+const int16_t LINK_WINDOW_RSSI_WIDTH = 3;
+const int16_t LINK_WINDOW_SNR_LOW = -300;				// SNR in tenths of a dB: -30 to +34 dB in 1 dB buckets
+const int16_t LINK_WINDOW_SNR_WIDTH = 10;
+
+// Keeps the last LORAMDOT_LINK_WINDOW_SIZE samples of a link quality value (RSSI, SNR) and their mean,
+// percentiles and trend. Adding a sample is O(1): the sum, the position weighted sum (for the trend) and a
+// histogram of the samples are updated for the sample added and the one it replaces. Percentiles are read
+// from the histogram so their resolution is the bucket width.
+class LoRamDotLinkWindow
+{
+public:
+	LoRamDotLinkWindow(int16_t low = LINK_WINDOW_RSSI_LOW, int16_t width = LINK_WINDOW_RSSI_WIDTH);
+
+	void Add(int16_t value);							// Adds a sample, replacing the oldest once the window is full.
+	void Add(const LoRamDotSignal &signal);				// Adds the last packet value of an RSSI or SNR reading.
+	void Clear();										// Discards all samples.
+
+	byte Count();										// Returns the number of samples held.
+	int16_t Last();										// Returns the newest sample (0 if there are none).
+	int16_t Mean();										// Returns the mean of the samples, rounded (0 if there are none).
+	int16_t Percentile(byte percent);					// Returns the value below which percent (0-100) of the samples fall, to the bucket width (0 if there are none).
+	float Trend();										// Returns the least squares slope of the samples in value units per sample (positive: improving RSSI/SNR).
+
+private:
+	int16_t _samples[LORAMDOT_LINK_WINDOW_SIZE];		// Samples, oldest at _head once the window is full
+	byte _buckets[LORAMDOT_LINK_WINDOW_BUCKETS];		// Samples in each histogram bucket
+	byte _head = 0;										// Index the next sample is written to
+	byte _count = 0;									// Samples held
+	int16_t _low;										// Value at the start of the first bucket
+	int16_t _width;										// Bucket width
+	long _sum = 0;										// Sum of the samples
+	long _weightedSum = 0;								// Sum of each sample multiplied by its age position (0 oldest, _count - 1 newest)
+
+	byte Bucket(int16_t value);							// Returns the histogram bucket of a value (clamped to the first and last bucket)
+};
+
+#endif
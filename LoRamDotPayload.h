@@ -0,0 +1,218 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotPayload.h
+//
+// Compile-time payload schemas. A schema lists its fields (bit width, scale and offset) as template arguments:
+//
+//		// Temperature -40.0 to 62.3 C in 0.1 C steps (10 bits), humidity 0-100% in 1% steps (7 bits)
+//		typedef LoRamDotPayload<LoRamDotField<10, 10, 1, -40>, LoRamDotField<7> > Reading;
+//
+//		uint8_t payload[Reading::BYTES];
+//		loRaWAN.SendBinary(payload, Reading::Encode(payload, temperature, humidity));
+//
+// The packing is unrolled by the compiler so nothing describing the schema is stored or interpreted at run time.
+// Records can be packed back to back with EncodeAt() (Reading::RecordsIn(11) readings fit the 11 byte DR0 payload).
+// This header does not depend on Arduino so the same schema decodes the payload on a host (Linux) or server.
+
+#ifndef _LORAMDOTPAYLOAD_h
+	#define _LORAMDOTPAYLOAD_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A payload field of Bits bits (1-32). The value is stored as round((value - Offset) * ScaleNumerator / ScaleDenominator),
+// clamped to 0 - (2^Bits - 1). Decoding reverses the scale and offset.
+template <uint8_t Bits, int32_t ScaleNumerator = 1, int32_t ScaleDenominator = 1, int32_t Offset = 0>
+struct LoRamDotField
+{
+	static_assert(Bits >= 1 && Bits <= 32, "LoRamDotField width must be 1 to 32 bits");
+	static_assert(ScaleNumerator > 0 && ScaleDenominator > 0, "LoRamDotField scale must be positive");
+
+	static constexpr uint8_t BITS = Bits;
+	static constexpr uint32_t MAX_RAW = (Bits == 32) ? 0xFFFFFFFFUL : ((1UL << Bits) - 1);
+
+	// Returns the stored (raw) value of a value. Integer values are scaled with integer arithmetic so wide fields are exact.
+	template <typename Value>
+	static uint32_t Raw(Value value)
+	{
+		if ((Value)0.5 != 0)
+		{
+			double l_scaled = ((double)value - Offset) * ScaleNumerator / ScaleDenominator;
+
+			if (l_scaled <= 0)
+				return 0;
+			if (l_scaled >= (double)MAX_RAW)
+				return MAX_RAW;
+
+			return (uint32_t)(l_scaled + 0.5);
+		}
+
+		int64_t l_scaled = ((int64_t)value - Offset) * ScaleNumerator;
+
+		if (l_scaled <= 0)
+			return 0;
+
+		l_scaled = (l_scaled + ScaleDenominator / 2) / ScaleDenominator;
+
+		return (l_scaled >= (int64_t)MAX_RAW) ? MAX_RAW : (uint32_t)l_scaled;
+	}
+
+	// Returns the value of a stored (raw) value. Integer values are rounded to the nearest whole number.
+	template <typename Value>
+	static Value ValueOf(uint32_t raw)
+	{
+		if ((Value)0.5 != 0)
+			return (Value)((double)raw * ScaleDenominator / ScaleNumerator + Offset);
+
+		return (Value)(((int64_t)raw * ScaleDenominator + ScaleNumerator / 2) / ScaleNumerator + Offset);
+	}
+};
+
+// Writes the low bits of value at bit position (most significant bit first).
+inline void LoRamDotWriteBits(uint8_t *buffer, size_t position, uint8_t bits, uint32_t value)
+{
+	while (bits > 0)
+	{
+		uint8_t l_free = 8 - (position & 7);
+		uint8_t l_count = (bits < l_free) ? bits : l_free;
+		uint8_t l_mask = (uint8_t)(((1U << l_count) - 1) << (l_free - l_count));
+		uint8_t l_part = (uint8_t)(((value >> (bits - l_count)) << (l_free - l_count)) & l_mask);
+
+		buffer[position >> 3] = (buffer[position >> 3] & ~l_mask) | l_part;
+
+		position += l_count;
+		bits -= l_count;
+	}
+}
+
+// Reads bits bits at bit position (most significant bit first).
+inline uint32_t LoRamDotReadBits(const uint8_t *buffer, size_t position, uint8_t bits)
+{
+	uint32_t l_value = 0;
+
+	while (bits > 0)
+	{
+		uint8_t l_free = 8 - (position & 7);
+		uint8_t l_count = (bits < l_free) ? bits : l_free;
+
+		l_value = (l_value << l_count) | ((buffer[position >> 3] >> (l_free - l_count)) & ((1U << l_count) - 1));
+
+		position += l_count;
+		bits -= l_count;
+	}
+
+	return l_value;
+}
+
+// A payload schema made of LoRamDotField fields, packed in order with no padding.
+template <typename... Fields>
+struct LoRamDotPayload;
+
+// The empty schema ends the field recursion.
+template <>
+struct LoRamDotPayload<>
+{
+	static constexpr size_t BITS = 0;
+
+	static void Pack(uint8_t *, size_t) {}
+	static void Unpack(const uint8_t *, size_t) {}
+};
+
+template <typename Field, typename... Fields>
+struct LoRamDotPayload<Field, Fields...>
+{
+	typedef LoRamDotPayload<Fields...> Rest;
+
+	static constexpr size_t BITS = Field::BITS + Rest::BITS;		// Bits in one record
+	static constexpr size_t BYTES = (BITS + 7) / 8;				// Bytes in one record
+
+	// Returns the number of records that fit in bytes bytes (e.g. MaxPayload()).
+	static constexpr size_t RecordsIn(size_t bytes)
+	{
+		return bytes * 8 / BITS;
+	}
+
+	// Returns the bytes used by records records packed back to back.
+	static constexpr size_t BytesFor(size_t records)
+	{
+		return (records * BITS + 7) / 8;
+	}
+
+	// Packs one value per field at bit position.
+	template <typename Value, typename... Values>
+	static void Pack(uint8_t *buffer, size_t position, Value value, Values... values)
+	{
+		LoRamDotWriteBits(buffer, position, Field::BITS, Field::Raw(value));
+		Rest::Pack(buffer, position + Field::BITS, values...);
+	}
+
+	// Unpacks one value per field from bit position.
+	template <typename Value, typename... Values>
+	static void Unpack(const uint8_t *buffer, size_t position, Value &value, Values &... values)
+	{
+		value = Field::template ValueOf<Value>(LoRamDotReadBits(buffer, position, Field::BITS));
+		Rest::Unpack(buffer, position + Field::BITS, values...);
+	}
+
+	// Packs a record into buffer (at least BYTES long) and returns the payload length (BYTES).
+	// The padding bits after the record in the last byte are cleared, so a reading always encodes to the same bytes.
+	template <typename... Values>
+	static size_t Encode(uint8_t *buffer, Values... values)
+	{
+		static_assert(sizeof...(Values) == sizeof...(Fields) + 1, "LoRamDotPayload needs one value per field");
+
+		buffer[BYTES - 1] = 0;
+		Pack(buffer, 0, values...);
+
+		return BYTES;
+	}
+
+	// Packs record number record (0 first) after the records before it and returns the payload length so far.
+	// buffer must hold BytesFor(record + 1) bytes. Bits after the record are left as they are, so zero the buffer
+	// before packing record 0 or the padding of the last byte is sent with whatever the buffer held.
+	template <typename... Values>
+	static size_t EncodeAt(uint8_t *buffer, size_t record, Values... values)
+	{
+		static_assert(sizeof...(Values) == sizeof...(Fields) + 1, "LoRamDotPayload needs one value per field");
+
+		Pack(buffer, record * BITS, values...);
+
+		return BytesFor(record + 1);
+	}
+
+	// Unpacks the first record of a payload of length bytes. Returns false if the payload is too short.
+	template <typename... Values>
+	static bool Decode(const uint8_t *buffer, size_t length, Values &... values)
+	{
+		return DecodeAt(buffer, length, 0, values...);
+	}
+
+	// Unpacks record number record (0 first) of a payload of length bytes. Returns false if the payload is too short.
+	template <typename... Values>
+	static bool DecodeAt(const uint8_t *buffer, size_t length, size_t record, Values &... values)
+	{
+		static_assert(sizeof...(Values) == sizeof...(Fields) + 1, "LoRamDotPayload needs one value per field");
+
+		if ((record + 1) * BITS > length * 8)
+			return false;
+
+		Unpack(buffer, record * BITS, values...);
+
+		return true;
+	}
+};
+
+#endif
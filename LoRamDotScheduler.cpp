@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoRamDotScheduler.h"
+
+// Scheduler Constructor
+// Uplinks are sent through the given mDot.
+LoRamDotScheduler::LoRamDotScheduler(LoRamDot &mDot) : _mDot(&mDot)
+{
+
+}
+
+// Sets the number of sub-bands (1-LORAMDOT_SCHEDULER_SUB_BANDS) and their duty cycle (DUTY_CYCLE_*).
+void LoRamDotScheduler::setSubBands(byte count, unsigned int dutyCycle)
+{
+	if (count < 1)
+		count = 1;
+	if (count > LORAMDOT_SCHEDULER_SUB_BANDS)
+		count = LORAMDOT_SCHEDULER_SUB_BANDS;
+
+	_subBands = count;
+
+	for (byte i = 0; i < _subBands; i++)
+	{
+		_dutyCycle[i] = (dutyCycle < 1) ? 1 : dutyCycle;
+		_readyAt[i] = millis();
+	}
+}
+
+// Sets the duty cycle (DUTY_CYCLE_*) of one sub-band.
+void LoRamDotScheduler::setSubBand(byte index, unsigned int dutyCycle)
+{
+	if (_subBands == 0)
+		setSubBands(1, DUTY_CYCLE_NONE);
+
+	if (index < _subBands)
+		_dutyCycle[index] = (dutyCycle < 1) ? 1 : dutyCycle;
+}
+
+// Sets the back off after the first failure and the longest back off in milliseconds.
+void LoRamDotScheduler::setBackoff(unsigned long base, unsigned long maximum)
+{
+	_backoffBase = (base < 1) ? 1 : base;
+	_backoffMaximum = (maximum < _backoffBase) ? _backoffBase : maximum;
+}
+
+// Sets the consecutive failures after which an uplink is dropped (0: keep retrying).
+void LoRamDotScheduler::setMaximumFailures(byte failures)
+{
+	_maximumFailures = failures;
+}
+
+// Queues an uplink. Returns false if it is larger than the maximum payload or the queue is full.
+boolean LoRamDotScheduler::Queue(const uint8_t *data, size_t length)
+{
+	if (length == 0 || length > _mDot->MaxPayload() || _queueLength + length + 1 > LORAMDOT_SCHEDULER_QUEUE_SIZE)
+		return false;
+
+	_queue[_queueLength] = (uint8_t)length;
+	memcpy(_queue + _queueLength + 1, data, length);
+	_queueLength += length + 1;
+	_pending++;
+
+	return true;
+}
+
+// Sends the next queued uplink if a channel is free. Returns the scheduler state (SCHEDULER_*).
+// Call from loop(). The send itself waits for the mDot's response.
+byte LoRamDotScheduler::Poll()
+{
+	if (_pending == 0)
+		return SCHEDULER_IDLE;
+
+	if (NextTransmit() > 0)
+		return SCHEDULER_WAITING;
+
+	size_t l_length = _queue[0];
+	unsigned long l_sentAt = millis();
+
+	if (!_mDot->SendBinary(_queue + 1, l_length))
+		return Failed();
+
+	// Charge the airtime (plus the off time) to the sub-band the mDot will have used
+	unsigned long l_airtime = _mDot->EstimateTimeOnAir((byte)l_length);
+	byte l_subBand = NextSubBand();
+
+	_readyAt[l_subBand] = l_sentAt + l_airtime * _dutyCycle[l_subBand];
+
+	Drop();
+
+	return SCHEDULER_SENT;
+}
+
+// Returns the milliseconds until a channel is predicted to be free and any back off has passed (0 if an uplink may be sent now).
+unsigned long LoRamDotScheduler::NextTransmit()
+{
+	long l_wait = (long)(_readyAt[NextSubBand()] - millis());
+	long l_retryWait = (_failures > 0) ? (long)(_retryAt - millis()) : 0;
+
+	if (l_retryWait > l_wait)
+		l_wait = l_retryWait;
+
+	return (l_wait > 0) ? (unsigned long)l_wait : 0;
+}
+
+// Returns the number of queued uplinks.
+unsigned int LoRamDotScheduler::Pending()
+{
+	return _pending;
+}
+
+// Discards all queued uplinks.
+void LoRamDotScheduler::Clear()
+{
+	_queueLength = 0;
+	_pending = 0;
+	_failures = 0;
+}
+
+// Returns the sub-band that frees up first.
+// The default sub-bands for the mDot's frequency band are set on first use.
+byte LoRamDotScheduler::NextSubBand()
+{
+	if (_subBands == 0)
+		setSubBands(1, (_mDot->FrequencyBandId() == FREQUENCY_BAND_EU) ? DUTY_CYCLE_1_PERCENT : DUTY_CYCLE_NONE);
+
+	unsigned long l_now = millis();
+	byte l_next = 0;
+	long l_nextWait = 0;
+
+	for (byte i = 0; i < _subBands; i++)
+	{
+		long l_wait = (long)(_readyAt[i] - l_now);
+
+		if (l_wait < 0)
+			l_wait = 0;
+
+		if (i == 0 || l_wait < l_nextWait)
+		{
+			l_next = i;
+			l_nextWait = l_wait;
+		}
+	}
+
+	return l_next;
+}
+
+// Sorts a failed send by its status and returns the scheduler state.
+// Only a failure for lack of a free channel is worth an AT+TXN round trip; an uplink that does not fit the data rate
+// will never be sent, and anything else is retried after a back off rather than on the next Poll().
+byte LoRamDotScheduler::Failed()
+{
+	int l_statusId = _mDot->LastCommandStatusId();
+	String l_detail = _mDot->LastCommandStatusMessage();
+
+	l_detail.toUpperCase();
+
+	if (l_statusId == COMMAND_STATUS_ID_ERROR && (l_detail.indexOf("CHANNEL") >= 0 || l_detail.indexOf("DUTY") >= 0))
+	{
+		// Resynchronise with the mDot's view of the channels
+		unsigned long l_next = _mDot->TransmitNext();
+		unsigned long l_now = millis();
+
+		for (byte i = 0; i < _subBands; i++)
+		{
+			if ((long)(_readyAt[i] - (l_now + l_next)) < 0)
+				_readyAt[i] = l_now + l_next;
+		}
+
+		return SCHEDULER_FAILED;
+	}
+
+	if (l_statusId == COMMAND_STATUS_INPUT_OUT_OF_RANGE || (l_statusId == COMMAND_STATUS_ID_ERROR && l_detail.indexOf("PAYLOAD") >= 0))
+	{
+		// The data rate has dropped (e.g. ADR) below what the uplink needs. Read it so Queue() checks the new maximum.
+		if (l_statusId == COMMAND_STATUS_ID_ERROR)
+			_mDot->SessionDataRate();
+
+		if (_queue[0] > _mDot->MaxPayload())
+		{
+			Drop();
+			return SCHEDULER_DROPPED;
+		}
+	}
+
+	if (_failures < 0xFF)
+		_failures++;
+
+	if (_maximumFailures != 0 && _failures >= _maximumFailures)
+	{
+		Drop();
+		return SCHEDULER_DROPPED;
+	}
+
+	unsigned long l_backoff = _backoffBase;
+
+	for (byte i = 1; i < _failures && l_backoff < _backoffMaximum; i++)
+		l_backoff = (l_backoff > _backoffMaximum / 2) ? _backoffMaximum : l_backoff * 2;
+
+	_retryAt = millis() + l_backoff;
+
+	return SCHEDULER_FAILED;
+}
+
+// Removes the uplink at the head of the queue.
+void LoRamDotScheduler::Drop()
+{
+	size_t l_length = _queue[0];
+
+	memmove(_queue, _queue + l_length + 1, _queueLength - l_length - 1);
+	_queueLength -= l_length + 1;
+	_pending--;
+	_failures = 0;
+}
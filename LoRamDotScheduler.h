@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotScheduler.h
+
+#ifndef _LORAMDOTSCHEDULER_h
+	#define _LORAMDOTSCHEDULER_h
+
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_SCHEDULER_QUEUE_SIZE
+	#if defined(__AVR__)
+		#define LORAMDOT_SCHEDULER_QUEUE_SIZE 128			// Bytes of queued uplinks (each uplink uses its length + 1 byte)
+	#else
+		#define LORAMDOT_SCHEDULER_QUEUE_SIZE 1024			// Bytes of queued uplinks (each uplink uses its length + 1 byte)
+	#endif
+#endif
+
+#ifndef LORAMDOT_SCHEDULER_SUB_BANDS
+	#define LORAMDOT_SCHEDULER_SUB_BANDS 4					// Sub-bands whose airtime is tracked
+#endif
+
+														// Scheduler States (returned by Poll())
+const byte SCHEDULER_IDLE = 0;							// Nothing queued
+const byte SCHEDULER_WAITING = 1;						// Uplinks queued but no channel is free yet
+const byte SCHEDULER_SENT = 2;							// An uplink was sent
+const byte SCHEDULER_FAILED = 3;						// An uplink failed and stays queued. It is retried when a channel is free (no channel) or after a back off.
+const byte SCHEDULER_DROPPED = 4;						// An uplink was dropped: it no longer fits the current data rate or failed setMaximumFailures() times
+
+														// Duty Cycles (1 / off time factor)
+const unsigned int DUTY_CYCLE_NONE = 1;					// No duty cycle limit (US915 / AU915)
+const unsigned int DUTY_CYCLE_10_PERCENT = 10;			// 10% (EU868 869.7-870.0MHz)
+const unsigned int DUTY_CYCLE_1_PERCENT = 100;			// 1% (EU868 868.0-868.6MHz default channels)
+const unsigned int DUTY_CYCLE_0_1_PERCENT = 1000;		// 0.1% (EU868 868.7-869.2MHz)
+
+														// Scheduler Defaults
+const unsigned long SCHEDULER_BACKOFF_BASE = 1000;		// Milliseconds before an uplink that failed (other than for lack of a channel) is retried, doubled after each further failure
+const unsigned long SCHEDULER_BACKOFF_MAXIMUM = 60000;	// Longest back off in milliseconds
+
+// Queues uplinks and sends them only when the local airtime model says a channel is free, so sends do not
+// fail for lack of a free channel under duty cycle limits. The airtime of every uplink is charged to the
+// sub-band that frees up first (the mDot picks any free channel). When a send fails for lack of a free channel the
+// model is resynchronised with the mDot's own next free channel time (TransmitNext()). An uplink too large for the
+// current data rate (e.g. after ADR lowered it) is dropped, and any other failure (not joined, ERROR, timed out)
+// is retried after a back off that doubles with each consecutive failure.
+class LoRamDotScheduler
+{
+public:
+	LoRamDotScheduler(LoRamDot &mDot);
+
+	void setSubBands(byte count, unsigned int dutyCycle);	// Sets the number of sub-bands (1-LORAMDOT_SCHEDULER_SUB_BANDS) and their duty cycle (DUTY_CYCLE_*).
+														// Default: 1 sub-band at 1% for FREQUENCY_BAND_EU, no limit for FREQUENCY_BAND_US_AU.
+	void setSubBand(byte index, unsigned int dutyCycle);	// Sets the duty cycle (DUTY_CYCLE_*) of one sub-band.
+	void setBackoff(unsigned long base, unsigned long maximum);	// Sets the back off after the first failure and the longest back off in milliseconds.
+	void setMaximumFailures(byte failures);				// Sets the consecutive failures after which an uplink is dropped (0 [Default]: keep retrying).
+
+	boolean Queue(const uint8_t *data, size_t length);	// Queues an uplink. Returns false if it is larger than the maximum payload or the queue is full.
+	byte Poll();										// Sends the next queued uplink if a channel is free. Returns the scheduler state (SCHEDULER_*).
+	unsigned long NextTransmit();						// Returns the milliseconds until a channel is predicted to be free and any back off has passed (0 if an uplink may be sent now).
+	unsigned int Pending();								// Returns the number of queued uplinks.
+	void Clear();										// Discards all queued uplinks.
+
+private:
+	LoRamDot *_mDot;
+	uint8_t _queue[LORAMDOT_SCHEDULER_QUEUE_SIZE];		// Queued uplinks, each as a length byte followed by the data
+	size_t _queueLength = 0;							// Bytes used in the queue
+	unsigned int _pending = 0;							// Uplinks queued (up to half the queue size, so more than a byte holds)
+
+	byte _subBands = 0;									// Sub-bands tracked. 0 until the default for the frequency band is set.
+	unsigned int _dutyCycle[LORAMDOT_SCHEDULER_SUB_BANDS];	// Duty cycle (DUTY_CYCLE_*) of each sub-band
+	unsigned long _readyAt[LORAMDOT_SCHEDULER_SUB_BANDS];	// millis() when each sub-band may transmit again
+
+	unsigned long _backoffBase = SCHEDULER_BACKOFF_BASE;	// Back off after the first failure
+	unsigned long _backoffMaximum = SCHEDULER_BACKOFF_MAXIMUM;	// Longest back off
+	byte _maximumFailures = 0;							// Consecutive failures before the uplink is dropped (0: no limit)
+	byte _failures = 0;									// Consecutive failures of the uplink at the head of the queue
+	unsigned long _retryAt = 0;							// millis() when the back off after the last failure ends
+
+	byte NextSubBand();									// Returns the sub-band that frees up first
+	byte Failed();										// Sorts a failed send by its status and returns the scheduler state
+	void Drop();										// Removes the uplink at the head of the queue
+};
+
+#endif
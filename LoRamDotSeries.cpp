@@ -0,0 +1,245 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoRamDotSeries.h"
+
+// Format
+//		Sample 1: zig-zag varint of the value
+//		Sample 2: zig-zag varint of the delta
+//		Sample 3+: zig-zag varint of the delta-of-delta
+// With run-length encoding a single zero delta-of-delta is the byte 0x00 and a run of n >= 2 is 0x00 0x00 followed by
+// the varint n - 2. No other token starts with 0x00 and a single zero is never followed by another, so the decoder can
+// tell them apart. All arithmetic wraps at 32 bits so counters that overflow are encoded exactly.
+
+// Maps a signed number to an unsigned one so small magnitudes give small numbers (0, -1, 1, -2 -> 0, 1, 2, 3).
+static uint32_t ZigZag(uint32_t value)
+{
+	return (value << 1) ^ (((value >> 31) != 0) ? 0xFFFFFFFFUL : 0);
+}
+
+// Reverses ZigZag().
+static uint32_t UnZigZag(uint32_t value)
+{
+	return (value >> 1) ^ (((value & 1) != 0) ? 0xFFFFFFFFUL : 0);
+}
+
+// Returns the bytes needed to store value as a varint.
+static size_t VarintLength(uint32_t value)
+{
+	size_t l_length = 1;
+
+	while (value >= 0x80)
+	{
+		value >>= 7;
+		l_length++;
+	}
+
+	return l_length;
+}
+
+// Stores value as a varint (7 bits per byte, least significant first, high bit set on all but the last byte).
+// Returns the bytes written.
+static size_t WriteVarint(uint8_t *buffer, uint32_t value)
+{
+	size_t l_length = 0;
+
+	while (value >= 0x80)
+	{
+		buffer[l_length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+
+	buffer[l_length++] = (uint8_t)value;
+
+	return l_length;
+}
+
+// Series Encoder Constructor
+// runLength: Run-length encode repeated slopes (the decoder must use the same setting).
+LoRamDotSeriesEncoder::LoRamDotSeriesEncoder(bool runLength) : _runLength(runLength)
+{
+
+}
+
+// Starts a new uplink of at most capacity bytes (e.g. MaxPayload()), up to LORAMDOT_SERIES_BUFFER_SIZE.
+void LoRamDotSeriesEncoder::Begin(size_t capacity)
+{
+	_capacity = (capacity > LORAMDOT_SERIES_BUFFER_SIZE) ? LORAMDOT_SERIES_BUFFER_SIZE : capacity;
+	_length = 0;
+	_count = 0;
+	_previous = 0;
+	_delta = 0;
+	_run = 0;
+}
+
+// Adds a sample. Returns false (and does not add it) if it does not fit in the uplink.
+bool LoRamDotSeriesEncoder::Add(int32_t value)
+{
+	uint32_t l_value = (uint32_t)value;
+	uint32_t l_delta = l_value - _previous;
+	uint32_t l_token = (_count == 0) ? l_value : (_count == 1) ? l_delta : l_delta - _delta;
+
+	if (_count >= 2 && l_token == 0 && _runLength)
+	{
+		// Extend the run at the end of the uplink: 0x00 for one, 0x00 0x00 varint(n - 2) for more
+		uint32_t l_run = _run + 1;
+		size_t l_runStart = (_run == 0) ? _length : _runStart;
+		size_t l_runLength = (l_run == 1) ? 1 : 2 + VarintLength(l_run - 2);
+
+		if (l_runStart + l_runLength > _capacity)
+			return false;
+
+		_buffer[l_runStart] = 0;
+
+		if (l_run > 1)
+		{
+			_buffer[l_runStart + 1] = 0;
+			WriteVarint(_buffer + l_runStart + 2, l_run - 2);
+		}
+
+		_run = l_run;
+		_runStart = l_runStart;
+		_length = l_runStart + l_runLength;
+	}
+	else
+	{
+		uint32_t l_zigZag = ZigZag(l_token);
+
+		if (_length + VarintLength(l_zigZag) > _capacity)
+			return false;
+
+		_length += WriteVarint(_buffer + _length, l_zigZag);
+		_run = 0;
+	}
+
+	_previous = l_value;
+	_delta = l_delta;
+	_count++;
+
+	return true;
+}
+
+// Returns the compressed uplink.
+const uint8_t *LoRamDotSeriesEncoder::Data()
+{
+	return _buffer;
+}
+
+// Returns the length of the compressed uplink in bytes.
+size_t LoRamDotSeriesEncoder::Length()
+{
+	return _length;
+}
+
+// Returns the number of samples in the uplink.
+size_t LoRamDotSeriesEncoder::Count()
+{
+	return _count;
+}
+
+// Series Decoder Constructor
+// data, length: The compressed uplink. runLength: Must match the encoder.
+LoRamDotSeriesDecoder::LoRamDotSeriesDecoder(const uint8_t *data, size_t length, bool runLength) : _data(data), _length(length), _runLength(runLength)
+{
+
+}
+
+// Reads a varint token. Returns false if the uplink ends inside it or it is longer than 32 bits.
+bool LoRamDotSeriesDecoder::ReadVarint(uint32_t *value)
+{
+	uint32_t l_value = 0;
+
+	for (uint8_t l_shift = 0; l_shift < 35; l_shift += 7)
+	{
+		if (_position >= _length)
+			return false;
+
+		uint8_t l_byte = _data[_position++];
+
+		l_value |= (uint32_t)(l_byte & 0x7F) << l_shift;
+
+		if ((l_byte & 0x80) == 0)
+		{
+			*value = l_value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Reads the next sample. Returns false at the end of the uplink or if it is corrupt.
+bool LoRamDotSeriesDecoder::Next(int32_t *value)
+{
+	uint32_t l_token = 0;
+
+	if (_run > 0)
+	{
+		_run--;
+	}
+	else
+	{
+		if (_position >= _length)
+			return false;
+
+		if (_runLength && _count >= 2 && _data[_position] == 0)
+		{
+			_position++;
+
+			// 0x00 0x00 varint(n - 2) is a run of n
+			if (_position < _length && _data[_position] == 0)
+			{
+				_position++;
+
+				if (!ReadVarint(&_run))
+					return false;
+
+				_run++;
+			}
+		}
+		else
+		{
+			if (!ReadVarint(&l_token))
+				return false;
+
+			l_token = UnZigZag(l_token);
+		}
+	}
+
+	uint32_t l_value;
+
+	if (_count == 0)
+	{
+		l_value = l_token;
+	}
+	else
+	{
+		_delta = (_count == 1) ? l_token : _delta + l_token;
+		l_value = _previous + _delta;
+	}
+
+	_previous = l_value;
+	_count++;
+
+	*value = (int32_t)l_value;
+	return true;
+}
+
+// Returns the number of samples read so far.
+size_t LoRamDotSeriesDecoder::Count()
+{
+	return _count;
+}
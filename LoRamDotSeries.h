@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotSeries.h
+//
+// Compresses a series of integer samples (temperature in 0.01 C, battery mV, counters, ...) into one uplink.
+// Each sample is stored as the change of its change (delta-of-delta), zig-zag mapped so small negative and positive
+// numbers are both small, as a varint (7 bits per byte). Runs of samples that continue the same slope (a zero
+// delta-of-delta) are optionally run-length encoded. A steady series costs a few bytes for the whole uplink.
+//
+//		LoRamDotSeriesEncoder series;
+//
+//		series.Begin(loRaWAN.MaxPayload());
+//
+//		if (!series.Add(reading))						// Full: send it and start the next uplink with this reading
+//		{
+//			loRaWAN.SendBinary(series.Data(), series.Length());
+//			series.Begin(loRaWAN.MaxPayload());
+//			series.Add(reading);
+//		}
+//
+// This header does not depend on Arduino so LoRamDotSeriesDecoder decompresses the uplinks on a host (Linux) or server.
+
+#ifndef _LORAMDOTSERIES_h
+	#define _LORAMDOTSERIES_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef LORAMDOT_SERIES_BUFFER_SIZE
+	#define LORAMDOT_SERIES_BUFFER_SIZE 242				// Largest uplink the encoder fills (PAYLOAD_SIZE_MAX)
+#endif
+
+// Streams samples into a compressed uplink held in a fixed buffer.
+class LoRamDotSeriesEncoder
+{
+public:
+	LoRamDotSeriesEncoder(bool runLength = true);		// runLength: Run-length encode repeated slopes (the decoder must use the same setting).
+
+	void Begin(size_t capacity);						// Starts a new uplink of at most capacity bytes (e.g. MaxPayload()), up to LORAMDOT_SERIES_BUFFER_SIZE.
+	bool Add(int32_t value);							// Adds a sample. Returns false (and does not add it) if it does not fit in the uplink.
+
+	const uint8_t *Data();								// Returns the compressed uplink.
+	size_t Length();									// Returns the length of the compressed uplink in bytes.
+	size_t Count();										// Returns the number of samples in the uplink.
+
+private:
+	uint8_t _buffer[LORAMDOT_SERIES_BUFFER_SIZE];		// Compressed uplink
+	size_t _capacity = LORAMDOT_SERIES_BUFFER_SIZE;		// Bytes the uplink may use
+	size_t _length = 0;									// Bytes used
+	size_t _count = 0;									// Samples added
+	bool _runLength;									// Run-length encode zero delta-of-deltas
+	uint32_t _previous = 0;								// Last sample
+	uint32_t _delta = 0;								// Last delta
+	uint32_t _run = 0;									// Zero delta-of-deltas at the end of the uplink
+	size_t _runStart = 0;								// Offset of the run at the end of the uplink
+};
+
+// Reads the samples back from a compressed uplink.
+class LoRamDotSeriesDecoder
+{
+public:
+	LoRamDotSeriesDecoder(const uint8_t *data, size_t length, bool runLength = true);	// runLength: Must match the encoder.
+
+	bool Next(int32_t *value);							// Reads the next sample. Returns false at the end of the uplink or if it is corrupt.
+	size_t Count();										// Returns the number of samples read so far.
+
+private:
+	const uint8_t *_data;								// Compressed uplink
+	size_t _length;										// Bytes in the uplink
+	size_t _position = 0;								// Offset of the next token
+	size_t _count = 0;									// Samples read
+	bool _runLength;									// Zero delta-of-deltas are run-length encoded
+	uint32_t _previous = 0;								// Last sample
+	uint32_t _delta = 0;								// Last delta
+	uint32_t _run = 0;									// Zero delta-of-deltas still to return from a run
+
+	bool ReadVarint(uint32_t *value);					// Reads a varint token
+};
+
+#endif
@@ -36,7 +36,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "LoRamDot.h"
 
 // These settings are for connecting to teh Australian TTN Network using an Australian configured 915MHz mDot
-#define DATA_RATE DATA_RATE_US_AU_D0_11					// DR0 to DR4 for AU - Data Rates Max Payload (bytes):DR0 : 11; DR1 : 53; DR2 : 129; DR3 : 242; DR4 : 242
+#define DATA_RATE (0)									// DR0 to DR4 for AU - Data Rates Max Payload (bytes):DR0 : 11; DR1 : 53; DR2 : 129; DR3 : 242; DR4 : 242
 #define PUBLIC_NETWORK (ENABLED)						// Public Network
 #define NETWORK_JOIN_MODE (NETWORK_JOIN_MODE_OTA)		// Automatically join
 #define FREQUENCY_SUBBAND (2)							// Subband used in Australian The Things Network gateways
@@ -68,37 +68,26 @@ void setup()
 	loraSerial.begin(115200);							// Lora mdot comms
 	loRaWAN.begin(loraSerial);							// Initialise the LoRaWAN object wrapper
 
-	// Set up the data rate to the smallest packet/longest distance
-	loRaWAN.TXDataRate(DATA_RATE);
-	DEBUG_PRINTLN("DATA_RATE: " + loRaWAN.LastResponse());
-
-	// Set it to talk to public networks
-	loRaWAN.PublicNetworkMode(ENABLED);
-	DEBUG_PRINTLN("PUB_NET: " + loRaWAN.LastResponse());
-
-	// Set up the mode to join
-	loRaWAN.NetworkJoinMode(NETWORK_JOIN_MODE);
-	DEBUG_PRINTLN("NET_JOIN_MODE: " + loRaWAN.LastResponse());
-
-	// Set up the frequency subband to use
-	loRaWAN.FrequencySubBand(FREQUENCY_SUBBAND);
-	DEBUG_PRINTLN("FREQ_SB: " + loRaWAN.LastResponse());
-
-	// Require network acknowledgment?
-	loRaWAN.RequireAcknowledgment(NETWORK_ACKKNOWLEDGMENT);
-	DEBUG_PRINTLN("ACK: " + loRaWAN.LastResponse());
-
-	// The Things Network Application EUI
-	loRaWAN.TTNApplicationEUI(TTN_APP_EUI);
-	DEBUG_PRINTLN("TTN_APP_EUI: " + loRaWAN.LastResponse());
-
-	// The Things Network APP Key
-	loRaWAN.TTNAppKey(TTN_APP_KEY);
-	DEBUG_PRINTLN("TTN_APP_KEY: " + loRaWAN.LastResponse());
-
-	// Join the nework
-	loRaWAN.Join();
-	DEBUG_PRINTLN("JOIN: " + loRaWAN.LastResponse());
+	// Describe the settings this sketch needs. Only the ones that differ from what the mDot holds are sent
+	// and saved, so the mDot flash is not rewritten on every boot.
+	LoRamDotConfig config;
+	config.dataRate = DATA_RATE;						// Set up the data rate to the smallest packet/longest distance
+	config.publicNetwork = PUBLIC_NETWORK;				// Set it to talk to public networks
+	config.joinMode = NETWORK_JOIN_MODE;				// Set up the mode to join
+	config.subBand = FREQUENCY_SUBBAND;					// Set up the frequency subband to use
+	config.ackAttempts = NETWORK_ACKKNOWLEDGMENT;		// Require network acknowledgment?
+	config.networkId = TTN_APP_EUI;						// The Things Network Application EUI
+	config.networkKey = TTN_APP_KEY;					// The Things Network APP Key
+
+	byte changes = 0;
+
+	loRaWAN.ReadConfiguration();
+	loRaWAN.ApplyConfiguration(config, &changes);
+	DEBUG_PRINTLN("CONFIG: " + String(changes) + " changed " + loRaWAN.LastResponse());
+
+	// Resume the network session saved before the last reset and only join the network if there is none
+	byte session = loRaWAN.ResumeSession();
+	DEBUG_PRINTLN("SESSION: " + String(session) + " " + loRaWAN.LastResponse());
 
 #ifdef DEBUG
 	// Print the setting if in debug mode
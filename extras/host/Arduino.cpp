@@ -0,0 +1,445 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// Arduino.cpp
+//
+// Host implementation of the minimal Arduino core in Arduino.h.
+
+#include <time.h>
+#include <unistd.h>
+
+#include "Arduino.h"
+
+/////////////////////////////////////////////
+// Time, Random Numbers and Pins
+/////////////////////////////////////////////
+
+// Returns the monotonic clock in microseconds.
+static unsigned long long MonotonicMicros()
+{
+	struct timespec l_now;
+
+	clock_gettime(CLOCK_MONOTONIC, &l_now);
+
+	return (unsigned long long)l_now.tv_sec * 1000000ULL + l_now.tv_nsec / 1000;
+}
+
+static const unsigned long long START_MICROS = MonotonicMicros();	// Clock at start up (millis() and micros() count from here)
+static int g_pinLevels[256];							// Levels returned by digitalRead()
+
+// Milliseconds since the program started.
+unsigned long millis()
+{
+	return (unsigned long)((MonotonicMicros() - START_MICROS) / 1000);
+}
+
+// Microseconds since the program started.
+unsigned long micros()
+{
+	return (unsigned long)(MonotonicMicros() - START_MICROS);
+}
+
+// Sleeps for ms milliseconds.
+void delay(unsigned long ms)
+{
+	usleep(ms * 1000);
+}
+
+// Sleeps for us microseconds.
+void delayMicroseconds(unsigned int us)
+{
+	usleep(us);
+}
+
+// Returns a pseudo random number from 0 to howbig - 1.
+long random(long howbig)
+{
+	return (howbig > 0) ? ::random() % howbig : 0;
+}
+
+// Returns a pseudo random number from howsmall to howbig - 1.
+long random(long howsmall, long howbig)
+{
+	return (howbig > howsmall) ? howsmall + random(howbig - howsmall) : howsmall;
+}
+
+// Seeds random().
+void randomSeed(unsigned long seed)
+{
+	srandom((unsigned int)seed);
+}
+
+// No pins on a host.
+void pinMode(uint8_t, uint8_t)
+{
+
+}
+
+// No pins on a host.
+void digitalWrite(uint8_t, uint8_t)
+{
+
+}
+
+// Returns the level set with hostDigitalLevel() (LOW by default).
+int digitalRead(uint8_t pin)
+{
+	return g_pinLevels[pin];
+}
+
+// Sets the level digitalRead() returns for a pin (e.g. CTS).
+void hostDigitalLevel(uint8_t pin, int value)
+{
+	g_pinLevels[pin] = value;
+}
+
+/////////////////////////////////////////////
+// String
+/////////////////////////////////////////////
+
+String::String(const char *text)
+{
+	*this = text;
+}
+
+String::String(const String &text)
+{
+	*this = text;
+}
+
+String::String(char c)
+{
+	concat(c);
+}
+
+String::String(unsigned char value, unsigned char base) : String((unsigned long)value, base)
+{
+
+}
+
+String::String(int value, unsigned char base) : String((long)value, base)
+{
+
+}
+
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base)
+{
+
+}
+
+String::String(long value, unsigned char base)
+{
+	char l_text[72];
+
+	if (base == DEC)
+		snprintf(l_text, sizeof(l_text), "%ld", value);
+	else if (base == HEX)
+		snprintf(l_text, sizeof(l_text), "%lx", value);
+	else
+		snprintf(l_text, sizeof(l_text), "%lo", value);
+
+	concat(l_text);
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+	char l_text[72];
+
+	snprintf(l_text, sizeof(l_text), (base == HEX) ? "%lx" : (base == OCT) ? "%lo" : "%lu", value);
+
+	concat(l_text);
+}
+
+String::String(double value, unsigned char decimals)
+{
+	char l_text[72];
+
+	snprintf(l_text, sizeof(l_text), "%.*f", decimals, value);
+
+	concat(l_text);
+}
+
+String::~String()
+{
+	free(_buffer);
+}
+
+String &String::operator=(const String &text)
+{
+	if (this != &text)
+	{
+		_length = 0;
+		concat(text.c_str(), text._length);
+	}
+
+	return *this;
+}
+
+String &String::operator=(const char *text)
+{
+	_length = 0;
+	concat(text);
+
+	return *this;
+}
+
+// Grows the buffer to hold size characters. Returns 0 if the memory could not be allocated.
+unsigned char String::reserve(unsigned int size)
+{
+	if (_buffer != NULL && _capacity >= size)
+		return 1;
+
+	char *l_buffer = (char *)realloc(_buffer, size + 1);
+
+	if (l_buffer == NULL)
+		return 0;
+
+	if (_buffer == NULL)
+		l_buffer[0] = '\0';
+
+	_buffer = l_buffer;
+	_capacity = size;
+
+	return 1;
+}
+
+// Appends length characters of text. Returns 0 if the memory could not be allocated.
+unsigned char String::concat(const char *text, unsigned int length)
+{
+	if (text == NULL)
+		return 0;
+
+	if (length == 0)
+		return 1;
+
+	if (!reserve(_length + length))
+		return 0;
+
+	memmove(_buffer + _length, text, length);
+	_length += length;
+	_buffer[_length] = '\0';
+
+	return 1;
+}
+
+unsigned char String::equalsIgnoreCase(const String &text) const
+{
+	return _length == text._length && strcasecmp(c_str(), text.c_str()) == 0;
+}
+
+unsigned char String::startsWith(const String &prefix) const
+{
+	return _length >= prefix._length && strncmp(c_str(), prefix.c_str(), prefix._length) == 0;
+}
+
+unsigned char String::endsWith(const String &suffix) const
+{
+	return _length >= suffix._length && strcmp(c_str() + _length - suffix._length, suffix.c_str()) == 0;
+}
+
+int String::indexOf(char c) const
+{
+	const char *l_found = strchr(c_str(), c);
+
+	return (l_found != NULL) ? (int)(l_found - c_str()) : -1;
+}
+
+int String::indexOf(const String &text) const
+{
+	const char *l_found = strstr(c_str(), text.c_str());
+
+	return (l_found != NULL) ? (int)(l_found - c_str()) : -1;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+	String l_result;
+
+	if (from > to)
+	{
+		unsigned int l_swap = from;
+
+		from = to;
+		to = l_swap;
+	}
+
+	if (to > _length)
+		to = _length;
+
+	if (from < to)
+		l_result.concat(_buffer + from, to - from);
+
+	return l_result;
+}
+
+void String::toCharArray(char *buffer, unsigned int size) const
+{
+	if (size == 0)
+		return;
+
+	unsigned int l_count = (_length < size - 1) ? _length : size - 1;
+
+	memcpy(buffer, c_str(), l_count);
+	buffer[l_count] = '\0';
+}
+
+void String::trim()
+{
+	if (_length == 0)
+		return;
+
+	unsigned int l_start = 0;
+
+	while (l_start < _length && isspace((unsigned char)_buffer[l_start]))
+		l_start++;
+
+	while (_length > l_start && isspace((unsigned char)_buffer[_length - 1]))
+		_length--;
+
+	_length -= l_start;
+	memmove(_buffer, _buffer + l_start, _length);
+	_buffer[_length] = '\0';
+}
+
+void String::toUpperCase()
+{
+	for (unsigned int i = 0; i < _length; i++)
+		_buffer[i] = (char)toupper((unsigned char)_buffer[i]);
+}
+
+String operator+(const String &left, const String &right)
+{
+	String l_result(left);
+
+	l_result += right;
+
+	return l_result;
+}
+
+String operator+(const String &left, const char *right)
+{
+	String l_result(left);
+
+	l_result += right;
+
+	return l_result;
+}
+
+String operator+(const char *left, const String &right)
+{
+	String l_result(left);
+
+	l_result += right;
+
+	return l_result;
+}
+
+String operator+(const String &left, char right)
+{
+	String l_result(left);
+
+	l_result += right;
+
+	return l_result;
+}
+
+/////////////////////////////////////////////
+// Print and Stream
+/////////////////////////////////////////////
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t l_count = 0;
+
+	while (size-- > 0)
+		l_count += write(*buffer++);
+
+	return l_count;
+}
+
+size_t Print::print(long value, int base)
+{
+	if (base != DEC)
+		return print((unsigned long)value, base);
+
+	char l_text[24];
+
+	snprintf(l_text, sizeof(l_text), "%ld", value);
+
+	return write(l_text);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+	char l_text[72];
+
+	if (base == BIN)
+	{
+		int l_length = 0;
+
+		do
+		{
+			l_text[l_length++] = '0' + (value & 1);
+			value >>= 1;
+		} while (value != 0);
+
+		// The bits were written least significant first
+		for (int i = 0; i < l_length / 2; i++)
+		{
+			char l_swap = l_text[i];
+
+			l_text[i] = l_text[l_length - 1 - i];
+			l_text[l_length - 1 - i] = l_swap;
+		}
+
+		l_text[l_length] = '\0';
+	}
+	else
+	{
+		snprintf(l_text, sizeof(l_text), (base == HEX) ? "%lX" : (base == OCT) ? "%lo" : "%lu", value);
+	}
+
+	return write(l_text);
+}
+
+size_t Print::print(double value, int decimals)
+{
+	char l_text[72];
+
+	snprintf(l_text, sizeof(l_text), "%.*f", decimals, value);
+
+	return write(l_text);
+}
+
+// Reads up to length bytes, waiting up to the stream timeout for each one. Returns the bytes read.
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+	size_t l_count = 0;
+
+	while (l_count < length)
+	{
+		unsigned long l_start = millis();
+		int l_byte;
+
+		while ((l_byte = read()) < 0 && millis() - l_start < _timeout);
+
+		if (l_byte < 0)
+			break;
+
+		buffer[l_count++] = (char)l_byte;
+	}
+
+	return l_count;
+}
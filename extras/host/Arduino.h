@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// Arduino.h
+//
+// Minimal Arduino core for building LoRamDot on a host (Linux) against LoRamDotSimulator or a real port.
+// Only the parts of the core the library uses are provided: millis()/micros()/delay(), Print, Stream, Printable
+// and a String that, like the Arduino one, keeps its characters in a malloc() buffer sized to fit.
+//
+//		g++ -std=gnu++11 -DARDUINO=10800 -Iextras/host -I. LORAMDOT.cpp extras/host/Arduino.cpp ...
+
+#ifndef _LORAMDOT_HOST_ARDUINO_h
+	#define _LORAMDOT_HOST_ARDUINO_h
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+unsigned long millis();									// Milliseconds since the program started
+unsigned long micros();									// Microseconds since the program started
+void delay(unsigned long ms);							// Sleeps for ms milliseconds
+void delayMicroseconds(unsigned int us);				// Sleeps for us microseconds
+long random(long howbig);								// Returns a pseudo random number from 0 to howbig - 1
+long random(long howsmall, long howbig);				// Returns a pseudo random number from howsmall to howbig - 1
+void randomSeed(unsigned long seed);					// Seeds random()
+void pinMode(uint8_t pin, uint8_t mode);				// No pins on a host
+void digitalWrite(uint8_t pin, uint8_t value);			// No pins on a host
+int digitalRead(uint8_t pin);							// Returns the level set with hostDigitalLevel() (LOW by default)
+void hostDigitalLevel(uint8_t pin, int value);			// Sets the level digitalRead() returns for a pin (e.g. CTS)
+
+inline boolean isDigit(int c) { return isdigit(c) != 0; }
+inline boolean isSpace(int c) { return isspace(c) != 0; }
+inline boolean isHexadecimalDigit(int c) { return isxdigit(c) != 0; }
+inline boolean isAlpha(int c) { return isalpha(c) != 0; }
+
+// Text with a heap buffer grown to fit, like the Arduino String
+class String
+{
+public:
+	String(const char *text = "");
+	String(const String &text);
+	explicit String(char c);
+	explicit String(unsigned char value, unsigned char base = DEC);
+	explicit String(int value, unsigned char base = DEC);
+	explicit String(unsigned int value, unsigned char base = DEC);
+	explicit String(long value, unsigned char base = DEC);
+	explicit String(unsigned long value, unsigned char base = DEC);
+	explicit String(double value, unsigned char decimals = 2);
+	~String();
+
+	String &operator=(const String &text);
+	String &operator=(const char *text);
+
+	unsigned char reserve(unsigned int size);
+	unsigned int length() const { return _length; }
+	const char *c_str() const { return (_buffer != NULL) ? _buffer : ""; }
+
+	unsigned char concat(const char *text, unsigned int length);
+	unsigned char concat(const String &text) { return concat(text.c_str(), text._length); }
+	unsigned char concat(const char *text) { return concat(text, (text != NULL) ? strlen(text) : 0); }
+	unsigned char concat(char c) { return concat(&c, 1); }
+	String &operator+=(const String &text) { concat(text); return *this; }
+	String &operator+=(const char *text) { concat(text); return *this; }
+	String &operator+=(char c) { concat(c); return *this; }
+
+	unsigned char equals(const String &text) const { return _length == text._length && strcmp(c_str(), text.c_str()) == 0; }
+	unsigned char equals(const char *text) const { return strcmp(c_str(), (text != NULL) ? text : "") == 0; }
+	unsigned char equalsIgnoreCase(const String &text) const;
+	unsigned char operator==(const String &text) const { return equals(text); }
+	unsigned char operator==(const char *text) const { return equals(text); }
+	unsigned char operator!=(const String &text) const { return !equals(text); }
+	unsigned char operator!=(const char *text) const { return !equals(text); }
+	unsigned char startsWith(const String &prefix) const;
+	unsigned char endsWith(const String &suffix) const;
+
+	char charAt(unsigned int index) const { return (index < _length) ? _buffer[index] : 0; }
+	char operator[](unsigned int index) const { return charAt(index); }
+	int indexOf(char c) const;
+	int indexOf(const String &text) const;
+	String substring(unsigned int from) const { return substring(from, _length); }
+	String substring(unsigned int from, unsigned int to) const;
+	void toCharArray(char *buffer, unsigned int size) const;
+	void trim();
+	void toUpperCase();
+	long toInt() const { return atol(c_str()); }
+	float toFloat() const { return (float)atof(c_str()); }
+
+private:
+	char *_buffer = NULL;								// NUL terminated characters (NULL until the first character)
+	unsigned int _capacity = 0;							// Characters the buffer holds (excluding the NUL)
+	unsigned int _length = 0;							// Characters used
+};
+
+String operator+(const String &left, const String &right);
+String operator+(const String &left, const char *right);
+String operator+(const char *left, const String &right);
+String operator+(const String &left, char right);
+
+class Print;
+
+// An object that can print itself (Arduino Printable)
+class Printable
+{
+public:
+	virtual ~Printable() {}
+	virtual size_t printTo(Print &p) const = 0;
+};
+
+// Output stream (Arduino Print)
+class Print
+{
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *text) { return (text != NULL) ? write((const uint8_t *)text, strlen(text)) : 0; }
+	size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() {}
+
+	size_t print(const __FlashStringHelper *text) { return write((const char *)text); }
+	size_t print(const String &text) { return write((const uint8_t *)text.c_str(), text.length()); }
+	size_t print(const char *text) { return write(text); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+	size_t print(int value, int base = DEC) { return print((long)value, base); }
+	size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+	size_t print(long value, int base = DEC);
+	size_t print(unsigned long value, int base = DEC);
+	size_t print(double value, int decimals = 2);
+	size_t print(const Printable &printable) { return printable.printTo(*this); }
+
+	size_t println() { return write("\r\n"); }
+	template <typename T> size_t println(const T &value) { size_t l_count = print(value); return l_count + println(); }
+	template <typename T> size_t println(const T &value, int format) { size_t l_count = print(value, format); return l_count + println(); }
+};
+
+// Input and output stream (Arduino Stream)
+class Stream : public Print
+{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	void setTimeout(unsigned long timeout) { _timeout = timeout; }
+	unsigned long getTimeout() { return _timeout; }
+	size_t readBytes(char *buffer, size_t length);
+	size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+
+protected:
+	unsigned long _timeout = 1000;						// Milliseconds readBytes() waits for each byte
+};
+
+#endif
@@ -0,0 +1,294 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <poll.h>
+
+#include "LoRamDotManager.h"
+
+// Manager Constructor
+LoRamDotManager::LoRamDotManager()
+{
+	ResetStatistics();
+}
+
+// Adds a module and returns its number (-1 if full). fd: Descriptor of its serial port, waited on with poll().
+int LoRamDotManager::Add(LoRamDot &mDot, int fd)
+{
+	if (_count == LORAMDOT_MANAGER_MODULES)
+		return -1;
+
+	ManagedModule *l_module = &_modules[_count];
+
+	l_module->mDot = &mDot;
+	l_module->fd = fd;
+	l_module->head = 0;
+	l_module->queued = 0;
+	l_module->running = false;
+	l_module->statistics = LoRamDotManagerStatistics();
+
+	return _count++;
+}
+
+// Returns the number of modules.
+byte LoRamDotManager::Count()
+{
+	return _count;
+}
+
+// Returns a module's LoRamDot.
+LoRamDot &LoRamDotManager::Module(byte module)
+{
+	return *_modules[module].mDot;
+}
+
+// Sets the function called when a command completes. NULL disables the callback.
+void LoRamDotManager::setCallback(ManagerCallback callback)
+{
+	_callback = callback;
+}
+
+// Queues a command line (e.g. "AT+SEND=hello") for a module. Returns false if its queue is full or the line too long.
+boolean LoRamDotManager::Queue(byte module, const char *command)
+{
+	if (module >= _count || strlen(command) > MANAGER_COMMAND_SIZE)
+		return false;
+
+	ManagedModule *l_module = &_modules[module];
+
+	if (l_module->queued == LORAMDOT_MANAGER_QUEUE)
+		return false;
+
+	strcpy(l_module->queue[(l_module->head + l_module->queued) % LORAMDOT_MANAGER_QUEUE], command);
+	l_module->queued++;
+
+	return true;
+}
+
+// Queues a command line for every module. Returns false if any queue was full.
+boolean LoRamDotManager::QueueAll(const char *command)
+{
+	boolean l_result = true;
+
+	for (byte i = 0; i < _count; i++)
+	{
+		if (!Queue(i, command))
+			l_result = false;
+	}
+
+	return l_result;
+}
+
+// Returns the commands queued or in progress on a module.
+byte LoRamDotManager::Pending(byte module)
+{
+	if (module >= _count)
+		return 0;
+
+	return _modules[module].queued;
+}
+
+// Returns the commands queued or in progress on all modules.
+unsigned long LoRamDotManager::Pending()
+{
+	unsigned long l_pending = 0;
+
+	for (byte i = 0; i < _count; i++)
+		l_pending += _modules[i].queued;
+
+	return l_pending;
+}
+
+// Sends the next queued commands, waits up to waitMs for data and reads every module. Returns the commands completed.
+// A module whose command completes is given its next command in the same pass.
+unsigned int LoRamDotManager::Service(int waitMs)
+{
+	unsigned int l_completed = 0;
+
+	for (byte i = 0; i < _count; i++)
+		StartNext(i);
+
+	Wait(waitMs);
+
+	for (byte i = 0; i < _count; i++)
+	{
+		if (Complete(i))
+		{
+			l_completed++;
+			StartNext(i);
+		}
+	}
+
+	return l_completed;
+}
+
+// Services the modules until no command is pending or timeout ms pass. Returns the commands completed.
+unsigned long LoRamDotManager::Run(unsigned long timeout)
+{
+	unsigned long l_start = millis();
+	unsigned long l_completed = 0;
+
+	while (Pending() > 0 && millis() - l_start < timeout)
+		l_completed += Service();
+
+	return l_completed;
+}
+
+// Clears the counters and starts timing the throughput.
+void LoRamDotManager::ResetStatistics()
+{
+	for (byte i = 0; i < _count; i++)
+		_modules[i].statistics = LoRamDotManagerStatistics();
+
+	_started = millis();
+}
+
+// Returns the counters of all modules.
+LoRamDotManagerStatistics LoRamDotManager::Statistics()
+{
+	LoRamDotManagerStatistics l_total;
+
+	for (byte i = 0; i < _count; i++)
+	{
+		l_total.commands += _modules[i].statistics.commands;
+		l_total.failures += _modules[i].statistics.failures;
+		l_total.bytesWritten += _modules[i].statistics.bytesWritten;
+		l_total.bytesRead += _modules[i].statistics.bytesRead;
+	}
+
+	l_total.elapsed = millis() - _started;
+
+	return l_total;
+}
+
+// Returns the counters of one module.
+LoRamDotManagerStatistics LoRamDotManager::Statistics(byte module)
+{
+	LoRamDotManagerStatistics l_statistics;
+
+	if (module < _count)
+		l_statistics = _modules[module].statistics;
+
+	l_statistics.elapsed = millis() - _started;
+
+	return l_statistics;
+}
+
+// Returns the commands completed per second by all modules since ResetStatistics().
+float LoRamDotManager::CommandsPerSecond()
+{
+	LoRamDotManagerStatistics l_total = Statistics();
+
+	return (l_total.elapsed > 0) ? l_total.commands * 1000.0f / l_total.elapsed : 0;
+}
+
+// Returns the bytes written and read per second by all modules since ResetStatistics().
+float LoRamDotManager::BytesPerSecond()
+{
+	LoRamDotManagerStatistics l_total = Statistics();
+
+	return (l_total.elapsed > 0) ? ((float)l_total.bytesWritten + l_total.bytesRead) * 1000.0f / l_total.elapsed : 0;
+}
+
+// Sends the module's next queued command if it is idle.
+// A module busy with a command started outside the manager is left until that command completes.
+void LoRamDotManager::StartNext(byte module)
+{
+	ManagedModule *l_module = &_modules[module];
+
+	if (l_module->running || l_module->queued == 0)
+		return;
+
+	const char *l_command = l_module->queue[l_module->head];
+
+	if (l_module->mDot->BeginCommand(l_command))
+	{
+		l_module->running = true;
+		l_module->statistics.bytesWritten += strlen(l_command) + 2;
+	}
+}
+
+// Reads the module and finishes its command if it completed. Returns true if it did.
+// Modules without a command in progress are still read, so their events are seen.
+boolean LoRamDotManager::Complete(byte module)
+{
+	ManagedModule *l_module = &_modules[module];
+	byte l_state = l_module->mDot->Poll();
+
+	if (!l_module->running || l_state == COMMAND_STATE_WAITING)
+		return false;
+
+	String l_response = l_module->mDot->LastResponse();
+	int l_statusId = l_module->mDot->LastCommandStatusId();
+
+	l_module->running = false;
+	l_module->head = (l_module->head + 1) % LORAMDOT_MANAGER_QUEUE;
+	l_module->queued--;
+	l_module->statistics.commands++;
+	l_module->statistics.bytesRead += l_response.length();
+
+	if (l_statusId != COMMAND_STATUS_ID_OK)
+		l_module->statistics.failures++;
+
+	if (_callback != NULL)
+		_callback(module, l_statusId, l_response.c_str());
+
+	return true;
+}
+
+// Waits in poll() until a module with a command in progress has data or waitMs pass.
+// A module whose queued command could not start because it is busy with a command started outside the manager is
+// waited on too, so Run() sleeps until that command completes. The wait is cut to a millisecond while a module
+// without a descriptor has a command in progress, and to MANAGER_WAIT_SLICE so timeouts are noticed. Nothing is
+// waited for when no command is in progress.
+void LoRamDotManager::Wait(int waitMs)
+{
+	struct pollfd l_fds[LORAMDOT_MANAGER_MODULES];
+	nfds_t l_count = 0;
+	boolean l_running = false;
+
+	if (waitMs > MANAGER_WAIT_SLICE)
+		waitMs = MANAGER_WAIT_SLICE;
+
+	for (byte i = 0; i < _count; i++)
+	{
+		if (!_modules[i].running && (_modules[i].queued == 0 || _modules[i].mDot->CommandState() != COMMAND_STATE_WAITING))
+			continue;
+
+		l_running = true;
+
+		// Data already read into the stream's buffer would not wake poll()
+		if (_modules[i].mDot->SerialStream().available() > 0)
+			return;
+
+		if (_modules[i].fd < 0)
+		{
+			if (waitMs > 1)
+				waitMs = 1;
+		}
+		else
+		{
+			l_fds[l_count].fd = _modules[i].fd;
+			l_fds[l_count].events = POLLIN;
+			l_fds[l_count].revents = 0;
+			l_count++;
+		}
+	}
+
+	if (!l_running || waitMs <= 0)
+		return;
+
+	poll(l_fds, l_count, waitMs);
+}
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotManager.h
+//
+// Drives many mDots from one host (Linux) thread. Each module has its own queue of AT commands, and a command is
+// sent to a module as soon as its previous command completes, so one slow module (a join, an uplink waiting for
+// its receive windows) never holds up the others. Commands run through LoRamDot::BeginCommand()/Poll(), and the
+// manager sleeps in poll() on the modules' file descriptors until one of them has data, so a LoRamDotSerialPort
+// given to it should not wait itself (setWait(0)). Total throughput grows with the number of modules.
+//
+//		g++ -std=gnu++11 -DARDUINO=10800 -Iextras/host -I. LORAMDOT.cpp extras/host/Arduino.cpp extras/host/LoRamDotManager.cpp app.cpp
+
+#ifndef _LORAMDOTMANAGER_h
+	#define _LORAMDOTMANAGER_h
+
+#include "Arduino.h"
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_MANAGER_MODULES
+	#define LORAMDOT_MANAGER_MODULES 32					// Modules managed
+#endif
+
+#ifndef LORAMDOT_MANAGER_QUEUE
+	#define LORAMDOT_MANAGER_QUEUE 8					// Commands queued per module
+#endif
+
+const unsigned int MANAGER_COMMAND_SIZE = 520;			// Longest command line (AT+SENDB with 242 bytes in hex)
+const int MANAGER_WAIT_SLICE = 10;						// Longest poll() wait (ms), so command timeouts and the failure line settle time are noticed
+
+typedef void (*ManagerCallback)(byte module, int statusId, const char *response);	// Called when a module's command completes, with its status ID and response
+
+// Counters of the commands completed by one module or all of them.
+struct LoRamDotManagerStatistics
+{
+	uint32_t commands = 0;								// Commands completed
+	uint32_t failures = 0;								// Commands that failed or timed out
+	uint32_t bytesWritten = 0;							// Command bytes written (with the line ending)
+	uint32_t bytesRead = 0;								// Response bytes received (trimmed)
+	unsigned long elapsed = 0;							// Milliseconds since ResetStatistics()
+};
+
+// Owns up to LORAMDOT_MANAGER_MODULES mDots and runs a command pipeline for each.
+class LoRamDotManager
+{
+public:
+	LoRamDotManager();
+
+	int Add(LoRamDot &mDot, int fd = -1);				// Adds a module and returns its number (-1 if full). fd: Descriptor of its serial port, waited on with poll()
+														// (-1: none, e.g. LoRamDotSimulator; the manager then checks the module every millisecond).
+	byte Count();										// Returns the number of modules.
+	LoRamDot &Module(byte module);						// Returns a module's LoRamDot.
+	void setCallback(ManagerCallback callback);			// Sets the function called when a command completes. NULL disables the callback.
+
+	boolean Queue(byte module, const char *command);	// Queues a command line (e.g. "AT+SEND=hello") for a module. Returns false if its queue is full or the line too long.
+	boolean QueueAll(const char *command);				// Queues a command line for every module. Returns false if any queue was full.
+	byte Pending(byte module);							// Returns the commands queued or in progress on a module.
+	unsigned long Pending();							// Returns the commands queued or in progress on all modules.
+
+	unsigned int Service(int waitMs = MANAGER_WAIT_SLICE);	// Sends the next queued commands, waits up to waitMs for data and reads every module. Returns the commands completed.
+	unsigned long Run(unsigned long timeout);			// Services the modules until no command is pending or timeout ms pass. Returns the commands completed.
+
+	void ResetStatistics();								// Clears the counters and starts timing the throughput.
+	LoRamDotManagerStatistics Statistics();				// Returns the counters of all modules.
+	LoRamDotManagerStatistics Statistics(byte module);	// Returns the counters of one module.
+	float CommandsPerSecond();							// Returns the commands completed per second by all modules since ResetStatistics().
+	float BytesPerSecond();								// Returns the bytes written and read per second by all modules since ResetStatistics().
+
+private:
+	// A module and its command pipeline
+	struct ManagedModule
+	{
+		LoRamDot *mDot;
+		int fd;											// Serial port descriptor (-1: none)
+		char queue[LORAMDOT_MANAGER_QUEUE][MANAGER_COMMAND_SIZE + 1];	// Queued command lines, oldest at head
+		byte head;
+		byte queued;
+		boolean running;								// A command from the queue is in progress
+		LoRamDotManagerStatistics statistics;
+	};
+
+	ManagedModule _modules[LORAMDOT_MANAGER_MODULES];
+	byte _count = 0;
+	ManagerCallback _callback = NULL;
+	unsigned long _started = 0;							// millis() at ResetStatistics()
+
+	void StartNext(byte module);						// Sends the module's next queued command if it is idle
+	boolean Complete(byte module);						// Reads the module and finishes its command if it completed. Returns true if it did.
+	void Wait(int waitMs);								// Waits in poll() until a module with a command in progress (queued or not) has data or waitMs pass
+};
+
+#endif
@@ -0,0 +1,277 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "LoRamDotSerialPort.h"
+
+// Returns the termios speed of a baud rate (B0 if it is not supported).
+static speed_t TermiosSpeed(unsigned long baudRate)
+{
+	switch (baudRate)
+	{
+	case SERIAL_SPEED_1200: return B1200;
+	case SERIAL_SPEED_2400: return B2400;
+	case SERIAL_SPEED_4800: return B4800;
+	case SERIAL_SPEED_9600: return B9600;
+	case SERIAL_SPEED_19200: return B19200;
+	case SERIAL_SPEED_38400: return B38400;
+	case SERIAL_SPEED_57600: return B57600;
+	case SERIAL_SPEED_115200: return B115200;
+	case SERIAL_SPEED_230400: return B230400;
+	case SERIAL_SPEED_460800: return B460800;
+	case SERIAL_SPEED_921600: return B921600;
+	default: return B0;
+	}
+}
+
+// Serial Port Constructor
+LoRamDotSerialPort::LoRamDotSerialPort()
+{
+
+}
+
+// Serial Port Destructor
+LoRamDotSerialPort::~LoRamDotSerialPort()
+{
+	end();
+}
+
+// Opens a tty and sets it to raw 8N1 at baudRate. Returns false if it cannot.
+boolean LoRamDotSerialPort::begin(const char *path, unsigned long baudRate)
+{
+	end();
+
+	int l_fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+	if (l_fd < 0)
+		return false;
+
+	if (!begin(l_fd, baudRate))
+	{
+		close(l_fd);
+		return false;
+	}
+
+	_owned = true;
+
+	return true;
+}
+
+// Uses an open tty descriptor (e.g. a pseudo-terminal), which end() does not close.
+// The descriptor is made non-blocking and set to raw 8N1 at baudRate. Returns false if it is not a tty or the rate is not supported.
+boolean LoRamDotSerialPort::begin(int fd, unsigned long baudRate)
+{
+	end();
+
+	struct termios l_termios;
+
+	if (TermiosSpeed(baudRate) == B0 || tcgetattr(fd, &l_termios) != 0)
+		return false;
+
+	// Raw bytes: no line editing, echo, signals or character translation; reads return what has arrived
+	cfmakeraw(&l_termios);
+	l_termios.c_cflag |= CLOCAL | CREAD;
+	l_termios.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	l_termios.c_cc[VMIN] = 0;
+	l_termios.c_cc[VTIME] = 0;
+
+	if (tcsetattr(fd, TCSANOW, &l_termios) != 0)
+		return false;
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	_fd = fd;
+	_owned = false;
+
+	if (!setBaudRate(baudRate))
+	{
+		_fd = -1;
+		return false;
+	}
+
+	tcflush(_fd, TCIFLUSH);
+
+	return true;
+}
+
+// Closes the tty (if begin() opened it) and discards the data read.
+void LoRamDotSerialPort::end()
+{
+	if (_fd >= 0 && _owned)
+		close(_fd);
+
+	_fd = -1;
+	_owned = false;
+	_head = 0;
+	_length = 0;
+}
+
+// Changes the rate (SERIAL_SPEED_*). Returns false if it is not supported.
+// Suits LoRamDot::NegotiateBaudRate() through a BaudRateCallback that calls it.
+boolean LoRamDotSerialPort::setBaudRate(unsigned long baudRate)
+{
+	speed_t l_speed = TermiosSpeed(baudRate);
+	struct termios l_termios;
+
+	if (_fd < 0 || l_speed == B0 || tcgetattr(_fd, &l_termios) != 0)
+		return false;
+
+	cfsetispeed(&l_termios, l_speed);
+	cfsetospeed(&l_termios, l_speed);
+
+	return tcsetattr(_fd, TCSADRAIN, &l_termios) == 0;
+}
+
+// Turns RTS/CTS flow control on or off (see LoRamDot::HardWareFlowControl()).
+boolean LoRamDotSerialPort::setFlowControl(boolean enabled)
+{
+	struct termios l_termios;
+
+	if (_fd < 0 || tcgetattr(_fd, &l_termios) != 0)
+		return false;
+
+	if (enabled)
+		l_termios.c_cflag |= CRTSCTS;
+	else
+		l_termios.c_cflag &= ~CRTSCTS;
+
+	return tcsetattr(_fd, TCSADRAIN, &l_termios) == 0;
+}
+
+// Sets how long available() waits in poll() when no data has arrived (0: never waits, e.g. with LoRamDotManager).
+// A short wait lets the library's blocking commands sleep until the response arrives rather than spin.
+void LoRamDotSerialPort::setWait(int ms)
+{
+	_wait = (ms < 0) ? 0 : ms;
+}
+
+// Sets how long write() waits for a full output queue to drain (e.g. CTS held low) before giving up.
+void LoRamDotSerialPort::setWriteTimeout(int ms)
+{
+	_writeTimeout = (ms < 0) ? 0 : ms;
+}
+
+// Returns the tty descriptor (-1 if not open), e.g. for LoRamDotManager::Add().
+int LoRamDotSerialPort::Descriptor()
+{
+	return _fd;
+}
+
+// Waits up to ms (-1: forever) for data. Returns true if data is available.
+boolean LoRamDotSerialPort::Wait(int ms)
+{
+	return _length > 0 || Fill(ms) > 0;
+}
+
+// Returns the bytes that can be read, waiting up to the setWait() time if there are none.
+int LoRamDotSerialPort::available()
+{
+	if (_length == 0)
+		Fill(_wait);
+
+	return (int)_length;
+}
+
+int LoRamDotSerialPort::read()
+{
+	if (_length == 0 && Fill(0) == 0)
+		return -1;
+
+	_length--;
+
+	return _buffer[_head++];
+}
+
+int LoRamDotSerialPort::peek()
+{
+	if (_length == 0 && Fill(0) == 0)
+		return -1;
+
+	return _buffer[_head];
+}
+
+size_t LoRamDotSerialPort::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+// Writes the buffer with as few write() calls as the tty accepts. Returns the bytes written, fewer if the
+// tty accepted nothing for the setWriteTimeout() time.
+// When the tty's output queue is full the rest is written as it drains. If it does not drain in time (e.g. flow
+// control is on and the mDot holds CTS low) the rest is dropped rather than blocking the caller forever.
+size_t LoRamDotSerialPort::write(const uint8_t *buffer, size_t size)
+{
+	size_t l_written = 0;
+
+	if (_fd < 0)
+		return 0;
+
+	while (l_written < size)
+	{
+		ssize_t l_count = ::write(_fd, buffer + l_written, size - l_written);
+
+		if (l_count > 0)
+			l_written += (size_t)l_count;
+		else if (l_count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			struct pollfd l_poll = { _fd, POLLOUT, 0 };
+
+			if (poll(&l_poll, 1, _writeTimeout) == 0)
+				break;
+		}
+		else if (l_count < 0 && errno == EINTR)
+			continue;
+		else
+			break;
+	}
+
+	return l_written;
+}
+
+// Waits until the written data has been sent (tcdrain()).
+void LoRamDotSerialPort::flush()
+{
+	if (_fd >= 0)
+		tcdrain(_fd);
+}
+
+// Reads what has arrived into the empty buffer, waiting up to waitMs. Returns the bytes buffered.
+size_t LoRamDotSerialPort::Fill(int waitMs)
+{
+	if (_fd < 0)
+		return 0;
+
+	_head = 0;
+
+	ssize_t l_count = ::read(_fd, _buffer, sizeof(_buffer));
+
+	if (l_count <= 0 && waitMs != 0)
+	{
+		struct pollfd l_poll = { _fd, POLLIN, 0 };
+
+		if (poll(&l_poll, 1, waitMs) > 0)
+			l_count = ::read(_fd, _buffer, sizeof(_buffer));
+	}
+
+	_length = (l_count > 0) ? (size_t)l_count : 0;
+
+	return _length;
+}
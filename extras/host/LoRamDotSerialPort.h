@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotSerialPort.h
+//
+// A Stream over a POSIX tty (e.g. /dev/ttyUSB0 or /dev/ttyACM0) so LoRamDot runs natively on Linux with a real
+// mDot. The port is set to raw 8N1 at one of the SERIAL_SPEED_* rates with termios. Reads fill a buffer with one
+// read() call and writes go to the descriptor in one write() call, instead of a system call per byte. While
+// nothing has arrived, available() waits for data in poll() (setWait()) so the library's blocking commands sleep
+// instead of spinning.
+//
+//		g++ -std=gnu++11 -DARDUINO=10800 -Iextras/host -I. LORAMDOT.cpp extras/host/Arduino.cpp extras/host/LoRamDotSerialPort.cpp app.cpp
+
+#ifndef _LORAMDOTSERIALPORT_h
+	#define _LORAMDOTSERIALPORT_h
+
+#include "Arduino.h"
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_SERIAL_PORT_BUFFER_SIZE
+	#define LORAMDOT_SERIAL_PORT_BUFFER_SIZE 4096		// Bytes read from the tty at once
+#endif
+
+const int SERIAL_PORT_WAIT = 1;							// Milliseconds available() waits in poll() for data by default
+const int SERIAL_PORT_WRITE_TIMEOUT = 1000;				// Milliseconds write() waits for the tty to accept more data by default
+
+// Stream over a tty file descriptor.
+class LoRamDotSerialPort : public Stream
+{
+public:
+	LoRamDotSerialPort();
+	~LoRamDotSerialPort();
+
+	boolean begin(const char *path, unsigned long baudRate = SERIAL_SPEED_115200);	// Opens a tty and sets it to raw 8N1 at baudRate. Returns false if it cannot.
+	boolean begin(int fd, unsigned long baudRate = SERIAL_SPEED_115200);	// Uses an open tty descriptor (e.g. a pseudo-terminal), which end() does not close.
+	void end();											// Closes the tty (if begin() opened it) and discards the data read.
+	boolean setBaudRate(unsigned long baudRate);		// Changes the rate (SERIAL_SPEED_*). Returns false if it is not supported.
+	boolean setFlowControl(boolean enabled);			// Turns RTS/CTS flow control on or off (see LoRamDot::HardWareFlowControl()).
+	void setWait(int ms);								// Sets how long available() waits in poll() when no data has arrived (0: never waits, e.g. with LoRamDotManager).
+	void setWriteTimeout(int ms);						// Sets how long write() waits for a full output queue to drain (e.g. CTS held low) before giving up.
+	int Descriptor();									// Returns the tty descriptor (-1 if not open), e.g. for LoRamDotManager::Add().
+	boolean Wait(int ms);								// Waits up to ms (-1: forever) for data. Returns true if data is available.
+
+	// Stream
+	int available();									// Returns the bytes that can be read, waiting up to the setWait() time if there are none.
+	int read();
+	int peek();
+	size_t write(uint8_t c);
+	size_t write(const uint8_t *buffer, size_t size);	// Writes the buffer with as few write() calls as the tty accepts. Returns the bytes written, fewer if the
+														// tty accepted nothing for the setWriteTimeout() time.
+	using Print::write;
+	void flush();										// Waits until the written data has been sent (tcdrain()).
+
+private:
+	int _fd = -1;
+	boolean _owned = false;								// begin() opened the descriptor, so end() closes it
+	int _wait = SERIAL_PORT_WAIT;						// Milliseconds available() waits for data
+	int _writeTimeout = SERIAL_PORT_WRITE_TIMEOUT;		// Milliseconds write() waits for the tty to accept data
+	uint8_t _buffer[LORAMDOT_SERIAL_PORT_BUFFER_SIZE];	// Data read, unread bytes from _head
+	size_t _head = 0;
+	size_t _length = 0;									// Bytes in _buffer
+
+	size_t Fill(int waitMs);							// Reads what has arrived into the empty buffer, waiting up to waitMs. Returns the bytes buffered.
+};
+
+#endif
@@ -0,0 +1,1085 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <strings.h>
+
+#include "LoRamDotSimulator.h"
+#include "LoRamDotAirtime.h"
+
+// Largest payload (bytes) for each data rate (from LORAMDOT.cpp)
+static const byte SIMULATOR_MAX_PAYLOAD_US_AU[] = { 11, 53, 129, 242, 242 };
+static const byte SIMULATOR_MAX_PAYLOAD_EU[] = { 51, 51, 51, 115, 242, 242, 242, 50 };
+
+static const char SIMULATOR_BANNER[] = "\r\nMultiTech Systems mDot (simulated)\r\nFirmware: 3.0.0\r\n";
+
+// Returns the value of a hex digit or -1 if c is not a hex digit.
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	return -1;
+}
+
+// Simulator Constructor
+// band: FREQUENCY_BAND_US_AU (FB_US915) or FREQUENCY_BAND_EU (FB_EU868)
+LoRamDotSimulator::LoRamDotSimulator(byte band) : _band(band)
+{
+	_dutyCycle = (band == FREQUENCY_BAND_EU) ? 100 : 1;
+	_lastCommand[0] = '\0';
+
+	Defaults();
+
+	memcpy(_saved, _settings, sizeof(_settings));
+	_savedCount = _settingCount;
+	_uartBaud = GetNumber("IPR", 115200);
+}
+
+/////////////////////////////////////////////
+// Stream
+/////////////////////////////////////////////
+
+// Receives a command byte. Commands are run when the carriage return arrives.
+size_t LoRamDotSimulator::write(uint8_t c)
+{
+	c = Garble(c);
+
+	if (_dataMode)
+	{
+		if (c != '\n' || !_dataLineEnd)
+			ReceiveData(c);
+
+		_dataLineEnd = false;
+		return 1;
+	}
+
+	if (c == '\r')
+	{
+		_line[_lineLength] = '\0';
+		RunCommand();
+		_lineLength = 0;
+	}
+	else if (c != '\n' && _lineLength < SIMULATOR_LINE_SIZE)
+	{
+		_line[_lineLength++] = (char)c;
+	}
+
+	return 1;
+}
+
+size_t LoRamDotSimulator::write(const uint8_t *buffer, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		write(buffer[i]);
+
+	return size;
+}
+
+// Returns the response bytes that have arrived (after the latency and baud pacing).
+int LoRamDotSimulator::available()
+{
+	UpdateDataMode();
+
+	unsigned long l_now = micros();
+
+	while (_outputArrived < _outputTail && (long)(l_now - _arrival[_outputArrived]) >= 0)
+		_outputArrived++;
+
+	return (int)(_outputArrived - _outputHead);
+}
+
+int LoRamDotSimulator::read()
+{
+	if (available() == 0)
+		return -1;
+
+	int l_byte = _output[_outputHead++];
+
+	if (_outputHead == _outputTail)
+	{
+		_outputHead = 0;
+		_outputArrived = 0;
+		_outputTail = 0;
+	}
+
+	return l_byte;
+}
+
+int LoRamDotSimulator::peek()
+{
+	if (available() == 0)
+		return -1;
+
+	return _output[_outputHead];
+}
+
+// Queues bytes that arrive from readyMicros on, paced at the baud rate.
+void LoRamDotSimulator::Queue(const char *text, unsigned int length, unsigned long readyMicros)
+{
+	// Move the unread bytes to the start to make room
+	if (_outputTail + length > LORAMDOT_SIMULATOR_OUTPUT_SIZE && _outputHead > 0)
+	{
+		unsigned int l_unread = _outputTail - _outputHead;
+
+		memmove(_output, _output + _outputHead, l_unread);
+		memmove(_arrival, _arrival + _outputHead, l_unread * sizeof(_arrival[0]));
+		_outputArrived -= _outputHead;
+		_outputTail = l_unread;
+		_outputHead = 0;
+	}
+
+	// A serial link cannot send a byte before the previous one
+	if (_outputTail > _outputHead && (long)(_lastArrival - readyMicros) > 0)
+		readyMicros = _lastArrival;
+
+	for (unsigned int i = 0; i < length && _outputTail < LORAMDOT_SIMULATOR_OUTPUT_SIZE; i++)
+	{
+		readyMicros += _byteMicros;
+
+		_output[_outputTail] = Garble((uint8_t)text[i]);
+		_arrival[_outputTail] = readyMicros;
+		_outputTail++;
+	}
+
+	_lastArrival = readyMicros;
+}
+
+/////////////////////////////////////////////
+// Configuration
+/////////////////////////////////////////////
+
+// Paces the responses at baud (10 bits per byte). 0 (default) delivers them at once.
+void LoRamDotSimulator::setBaudRate(unsigned long baud)
+{
+	_byteMicros = (baud == 0) ? 0 : 10000000UL / baud;
+}
+
+// Sets the time every command takes before its response starts (default 0).
+void LoRamDotSimulator::setLatency(unsigned long ms)
+{
+	_latency = ms;
+}
+
+// Sets the latency of one command (e.g. "AT+JOIN"). Returns false if the table is full.
+boolean LoRamDotSimulator::setLatency(const char *command, unsigned long ms)
+{
+	// The table holds the name without "AT" or "AT+"
+	if (strncasecmp(command, "AT", 2) == 0)
+		command += 2;
+	if (*command == '+')
+		command++;
+
+	for (byte i = 0; i < _latencyCount; i++)
+	{
+		if (strcasecmp(_latencyCommands[i], command) == 0)
+		{
+			_latencies[i] = ms;
+			return true;
+		}
+	}
+
+	if (_latencyCount == LORAMDOT_SIMULATOR_LATENCIES || strlen(command) > SIMULATOR_NAME_SIZE)
+		return false;
+
+	strcpy(_latencyCommands[_latencyCount], command);
+	_latencies[_latencyCount++] = ms;
+
+	return true;
+}
+
+// Adds the packet's time on air (and the receive windows with TX wait) to AT+SEND/AT+SENDB.
+void LoRamDotSimulator::setAirtimeLatency(boolean enabled)
+{
+	_airtimeLatency = enabled;
+}
+
+// Sets the off time factor after each uplink (1 none, 100 for 1%).
+void LoRamDotSimulator::setDutyCycle(unsigned int dutyCycle)
+{
+	_dutyCycle = (dutyCycle < 1) ? 1 : dutyCycle;
+}
+
+// Sets the rate of the host's serial port and paces the responses at it. While it differs from the mDot's rate
+// (AT+IPR, applied at restart) every byte is garbled in both directions. 0 (default) never garbles.
+void LoRamDotSimulator::setHostBaudRate(unsigned long baud)
+{
+	_hostBaud = baud;
+
+	setBaudRate(baud);
+}
+
+// Garbles bytes (SIMULATOR_OVERSPEED_ERRORS per thousand) while the mDot runs faster than baud. 0 (default): no limit.
+void LoRamDotSimulator::setBaudRateLimit(unsigned long baud)
+{
+	_baudLimit = baud;
+}
+
+// Returns the mDot's baud rate (the AT+IPR setting at the last restart).
+unsigned long LoRamDotSimulator::BaudRate()
+{
+	return _uartBaud;
+}
+
+// Seeds the error injection generator (default 1).
+void LoRamDotSimulator::setSeed(unsigned long seed)
+{
+	_seed = seed;
+}
+
+// Commands answered with ERROR (per thousand).
+void LoRamDotSimulator::setErrorRate(unsigned int perMille)
+{
+	_errorRate = perMille;
+}
+
+// Commands that are never answered (per thousand).
+void LoRamDotSimulator::setDropRate(unsigned int perMille)
+{
+	_dropRate = perMille;
+}
+
+// Responses with one changed byte (per thousand).
+void LoRamDotSimulator::setCorruptRate(unsigned int perMille)
+{
+	_corruptRate = perMille;
+}
+
+// The next count join attempts fail.
+void LoRamDotSimulator::setJoinFailures(byte count)
+{
+	_joinFailures = count;
+}
+
+// Queues a downlink delivered with the next uplink (one is held at a time).
+boolean LoRamDotSimulator::QueueDownlink(const uint8_t *data, size_t length)
+{
+	if (length > PAYLOAD_SIZE_MAX)
+		return false;
+
+	memcpy(_downlink, data, length);
+	_downlinkLength = length;
+	_downlinkQueued = true;
+
+	return true;
+}
+
+// Sets the RSSI (dBm) and SNR (tenths of a dB) of the downlinks received.
+void LoRamDotSimulator::setSignal(int rssi, int snrTenths)
+{
+	_rssi = rssi;
+	_snr = snrTenths;
+}
+
+// Sends unsolicited text (e.g. "RECV\r\n") after delayMs.
+void LoRamDotSimulator::Inject(const char *text, unsigned long delayMs)
+{
+	Queue(text, strlen(text), micros() + delayMs * 1000);
+}
+
+// Restarts the mDot: unsaved settings are lost and the start up banner is sent.
+// The session survives only if it was saved (AT+SS) with preserve session on (AT+PS=1).
+void LoRamDotSimulator::Restart()
+{
+	memcpy(_settings, _saved, sizeof(_settings));
+	_settingCount = _savedCount;
+	_uartBaud = GetNumber("IPR", 115200);
+
+	_joined = _sessionSaved && GetNumber("PS", 0) != 0;
+
+	if (_joined)
+		SetNumber("ULC", _savedCounter);
+	_lineLength = 0;
+	_dataMode = false;
+
+	Inject(SIMULATOR_BANNER);
+}
+
+/////////////////////////////////////////////
+// Serial Data Mode
+/////////////////////////////////////////////
+
+// Returns true while the simulated mDot is in serial data mode.
+boolean LoRamDotSimulator::DataMode()
+{
+	UpdateDataMode();
+
+	return _dataMode;
+}
+
+// Returns the CTS line: false while the mDot sleeps or its packet is full.
+boolean LoRamDotSimulator::ClearToSend()
+{
+	UpdateDataMode();
+
+	return !_dataMode || ((long)(millis() - _dataWake) >= 0 && _dataLength < MaxPayload());
+}
+
+// Returns the bytes sent as packets in serial data mode.
+unsigned long LoRamDotSimulator::DataBytes()
+{
+	return _dataBytes;
+}
+
+// Returns the bytes written in serial data mode while the mDot slept.
+unsigned long LoRamDotSimulator::DataLost()
+{
+	return _dataLost;
+}
+
+// Sends the packet once AT+WTO passes without a byte and sleeps through wake windows without data.
+void LoRamDotSimulator::UpdateDataMode()
+{
+	if (!_dataMode)
+		return;
+
+	unsigned long l_now = millis();
+	unsigned long l_wakeTimeout = GetNumber("WTO", 20);
+
+	if (_dataLength > 0 && (long)(l_now - (_dataLastByte + l_wakeTimeout)) >= 0)
+		SendData(_dataLastByte + l_wakeTimeout);
+
+	if (_dataLength == 0 && GetNumber("WM", 0) == 0)
+	{
+		unsigned long l_wakeDelay = GetNumber("WD", 100);
+
+		while ((long)(l_now - (_dataWake + l_wakeDelay)) >= 0)
+			_dataWake += l_wakeDelay + GetNumber("WI", 10) * 1000;
+	}
+}
+
+// Receives a byte in serial data mode. "+++" at the start of a packet escapes to AT command mode.
+void LoRamDotSimulator::ReceiveData(uint8_t c)
+{
+	UpdateDataMode();
+
+	if ((long)(millis() - _dataWake) < 0)
+	{
+		_dataLost++;
+		return;
+	}
+
+	_data[_dataLength++] = c;
+	_dataLastByte = millis();
+
+	if (_dataLength == 3 && memcmp(_data, "+++", 3) == 0)
+	{
+		_dataMode = false;
+		_dataLength = 0;
+		Inject("OK\r\n");
+	}
+	else if (_dataLength >= MaxPayload())
+		SendData(_dataLastByte);
+}
+
+// Sends the packet ended at closedAt and sleeps until the next wake.
+void LoRamDotSimulator::SendData(unsigned long closedAt)
+{
+	unsigned long l_extraMs = 0;
+	unsigned long l_airtime = LoRaWANTimeOnAir(_band, DataRate(), (byte)_dataLength, (byte)GetNumber("FEC", 1));
+
+	// Nothing is written to the serial port for the uplink itself
+	_responseLength = 0;
+
+	if (Send(_data, _dataLength, &l_extraMs))
+		_dataBytes += _dataLength;
+
+	_responseLength = 0;
+	_dataLength = 0;
+	_dataWake = closedAt + l_airtime + 2000 + ((GetNumber("WM", 0) == 0) ? GetNumber("WI", 10) * 1000 : 0);
+}
+
+/////////////////////////////////////////////
+// Inspection
+/////////////////////////////////////////////
+
+// Returns the number of commands received.
+unsigned long LoRamDotSimulator::Commands()
+{
+	return _commands;
+}
+
+// Returns the number of uplinks sent.
+unsigned long LoRamDotSimulator::Uplinks()
+{
+	return _uplinks;
+}
+
+// Returns true if the simulated mDot has joined the network.
+boolean LoRamDotSimulator::Joined()
+{
+	return _joined;
+}
+
+// Returns the last command line received (without the line ending).
+const char *LoRamDotSimulator::LastCommand()
+{
+	return _lastCommand;
+}
+
+// Copies the last uplink payload into buffer and returns its length.
+size_t LoRamDotSimulator::LastUplink(uint8_t *buffer, size_t capacity)
+{
+	size_t l_length = (_uplinkLength < capacity) ? _uplinkLength : capacity;
+
+	memcpy(buffer, _uplink, l_length);
+
+	return l_length;
+}
+
+// Returns the value of a setting (e.g. "TXDR") or NULL if it has none.
+const char *LoRamDotSimulator::Setting(const char *name)
+{
+	return GetSetting(name, NULL);
+}
+
+/////////////////////////////////////////////
+// Settings
+/////////////////////////////////////////////
+
+// Restores the factory settings.
+void LoRamDotSimulator::Defaults()
+{
+	_settingCount = 0;
+
+	SetSetting("E", "1");
+	SetSetting("TXDR", "DR0");
+	SetSetting("RXDR", "DR8");
+	SetSetting("PN", "1");
+	SetSetting("NJM", "1");
+	SetSetting("FSB", "0");
+	SetSetting("ACK", "0");
+	SetSetting("ADR", "0");
+	SetSetting("TXP", "11");
+	SetSetting("AP", "1");
+	SetSetting("JR", "2");
+	SetSetting("FEC", "1");
+	SetSetting("RXO", "0");
+	SetSetting("TXW", "1");
+	SetSetting("URC", "0");
+	SetSetting("PS", "0");
+	SetSetting("LCC", "0");
+	SetSetting("LCT", "0");
+	SetSetting("SMODE", "0");
+	SetSetting("IPR", "115200");
+	SetSetting("WM", "0");
+	SetSetting("WI", "10");
+	SetSetting("WD", "100");
+	SetSetting("WTO", "20");
+	SetSetting("WP", "8");
+	SetSetting("DC", "A");
+	SetSetting("NA", "00000000");
+	SetSetting("NI", "00-00-00-00-00-00-00-00");
+	SetSetting("NK", "00.00.00.00.00.00.00.00.00.00.00.00.00.00.00.00");
+}
+
+void LoRamDotSimulator::SetSetting(const char *name, const char *value)
+{
+	byte l_index = 0;
+
+	while (l_index < _settingCount && strcmp(_settings[l_index].name, name) != 0)
+		l_index++;
+
+	if (l_index == _settingCount)
+	{
+		if (_settingCount == LORAMDOT_SIMULATOR_SETTINGS)
+			return;
+
+		_settingCount++;
+	}
+
+	snprintf(_settings[l_index].name, sizeof(_settings[l_index].name), "%s", name);
+	snprintf(_settings[l_index].value, sizeof(_settings[l_index].value), "%s", value);
+}
+
+const char *LoRamDotSimulator::GetSetting(const char *name, const char *defaultValue)
+{
+	for (byte i = 0; i < _settingCount; i++)
+	{
+		if (strcmp(_settings[i].name, name) == 0)
+			return _settings[i].value;
+	}
+
+	return defaultValue;
+}
+
+long LoRamDotSimulator::GetNumber(const char *name, long defaultValue)
+{
+	const char *l_value = GetSetting(name, NULL);
+
+	return (l_value != NULL) ? atol(l_value) : defaultValue;
+}
+
+void LoRamDotSimulator::SetNumber(const char *name, unsigned long value)
+{
+	char l_value[12];
+
+	snprintf(l_value, sizeof(l_value), "%lu", value);
+	SetSetting(name, l_value);
+}
+
+// Returns the TX data rate (DR number) from "DRn", "SF_n"/"SFn" or "n".
+byte LoRamDotSimulator::DataRate()
+{
+	const char *l_value = GetSetting("TXDR", "DR0");
+
+	if (strncasecmp(l_value, "DR", 2) == 0)
+		return (byte)atoi(l_value + 2);
+
+	if (strncasecmp(l_value, "SF", 2) == 0)
+		l_value += (l_value[2] == '_') ? 3 : 2;
+
+	int l_spreadingFactor = atoi(l_value);
+
+	if (_band == FREQUENCY_BAND_EU)
+		return (l_spreadingFactor >= 7 && l_spreadingFactor <= 12) ? 12 - l_spreadingFactor : 0;
+
+	return (l_spreadingFactor >= 7 && l_spreadingFactor <= 10) ? 10 - l_spreadingFactor : 0;
+}
+
+// Returns the largest payload at the TX data rate.
+byte LoRamDotSimulator::MaxPayload()
+{
+	byte l_dataRate = DataRate();
+
+	if (_band == FREQUENCY_BAND_EU)
+		return (l_dataRate < sizeof(SIMULATOR_MAX_PAYLOAD_EU)) ? SIMULATOR_MAX_PAYLOAD_EU[l_dataRate] : 0;
+
+	return (l_dataRate < sizeof(SIMULATOR_MAX_PAYLOAD_US_AU)) ? SIMULATOR_MAX_PAYLOAD_US_AU[l_dataRate] : 0;
+}
+
+// Returns a repeatable pseudo random number from 0 to range - 1.
+unsigned long LoRamDotSimulator::Random(unsigned long range)
+{
+	// Numerical Recipes linear congruential generator
+	_seed = _seed * 1664525UL + 1013904223UL;
+
+	return (range == 0) ? 0 : ((_seed & 0xFFFFFFFFUL) >> 8) % range;
+}
+
+// Returns a byte as it arrives over the link: random at a baud rate the two ends do not share, and with
+// SIMULATOR_OVERSPEED_ERRORS per thousand changed above the baud rate limit.
+uint8_t LoRamDotSimulator::Garble(uint8_t c)
+{
+	if (_hostBaud != 0 && _hostBaud != _uartBaud)
+		return (uint8_t)Random(256);
+
+	if (_baudLimit != 0 && _uartBaud > _baudLimit && Random(1000) < SIMULATOR_OVERSPEED_ERRORS)
+		return c ^ 0x20;
+
+	return c;
+}
+
+// Returns the latency of a command (ms).
+unsigned long LoRamDotSimulator::Latency(const char *name)
+{
+	for (byte i = 0; i < _latencyCount; i++)
+	{
+		if (strcasecmp(_latencyCommands[i], name) == 0)
+			return _latencies[i];
+	}
+
+	return _latency;
+}
+
+/////////////////////////////////////////////
+// Commands
+/////////////////////////////////////////////
+
+// Appends a line to the response.
+void LoRamDotSimulator::Respond(const char *format, ...)
+{
+	va_list l_arguments;
+	unsigned int l_free = sizeof(_response) - _responseLength;
+
+	va_start(l_arguments, format);
+	int l_length = vsnprintf(_response + _responseLength, l_free, format, l_arguments);
+	va_end(l_arguments);
+
+	if (l_length < 0)
+		return;
+
+	_responseLength += ((unsigned int)l_length < l_free) ? l_length : l_free - 1;
+
+	RespondBytes((const uint8_t *)"\r\n", 2);
+}
+
+// Appends bytes to the response.
+void LoRamDotSimulator::RespondBytes(const uint8_t *data, size_t length)
+{
+	if (length > sizeof(_response) - _responseLength)
+		length = sizeof(_response) - _responseLength;
+
+	memcpy(_response + _responseLength, data, length);
+	_responseLength += length;
+}
+
+// Runs the command line received.
+void LoRamDotSimulator::RunCommand()
+{
+	if (_lineLength == 0)
+		return;
+
+	strcpy(_lastCommand, _line);
+	_commands++;
+	_responseLength = 0;
+
+	if (GetNumber("E", 1) != 0)
+		Respond("%s", _line);
+
+	unsigned int l_echoLength = _responseLength;
+
+	// Split AT[+]NAME[=value|?]
+	char l_name[SIMULATOR_NAME_SIZE + 1];
+	byte l_nameLength = 0;
+	char l_type = 0;
+	const char *l_value = "";
+	const char *l_text = _line + 2;
+
+	if (strncasecmp(_line, "AT", 2) != 0)
+		l_text = _line;
+	else if (*l_text == '+')
+		l_text++;
+
+	for (; *l_text != '\0' && *l_text != '=' && *l_text != '?'; l_text++)
+	{
+		if (l_nameLength < SIMULATOR_NAME_SIZE)
+			l_name[l_nameLength++] = (char)toupper((unsigned char)*l_text);
+	}
+
+	l_name[l_nameLength] = '\0';
+
+	if (*l_text != '\0')
+	{
+		l_type = *l_text;
+		l_value = l_text + 1;
+	}
+
+	unsigned long l_extraMs = 0;
+	boolean l_result;
+
+	if (Random(1000) < _dropRate)
+	{
+		// Only the echo is sent
+		Queue(_response, _responseLength, micros());
+		return;
+	}
+
+	if (strncasecmp(_line, "AT", 2) != 0)
+	{
+		Respond("Unknown command");
+		l_result = false;
+	}
+	else if (Random(1000) < _errorRate)
+	{
+		Respond("Injected error");
+		l_result = false;
+	}
+	else
+	{
+		l_result = Execute(l_name, l_type, l_value, &l_extraMs);
+	}
+
+	Respond("");
+	Respond(l_result ? "OK" : "ERROR");
+
+	// Change one byte after the echo
+	if (_responseLength > l_echoLength && Random(1000) < _corruptRate)
+		_response[l_echoLength + Random(_responseLength - l_echoLength)] ^= 0x20;
+
+	Queue(_response, _responseLength, micros() + (Latency(l_name) + l_extraMs) * 1000);
+
+	if (l_result && strcmp(l_name, "Z") == 0)
+		Restart();
+
+	if (l_result && strcmp(l_name, "SD") == 0)
+	{
+		_dataMode = true;
+		_dataLineEnd = true;
+		_dataLength = 0;
+		_dataWake = millis();
+	}
+
+	if (_announceDownlink)
+	{
+		_announceDownlink = false;
+		Inject("RECV\r\n");
+	}
+}
+
+// Writes a signal quadruple. tenths: The values are in tenths and printed with one decimal.
+static void SignalText(char *text, size_t size, int last, int minimum, int maximum, int average, boolean tenths)
+{
+	if (!tenths)
+	{
+		snprintf(text, size, "%d, %d, %d, %d", last, minimum, maximum, average);
+		return;
+	}
+
+	int l_values[4] = { last, minimum, maximum, average };
+	size_t l_length = 0;
+
+	for (byte i = 0; i < 4 && l_length < size; i++)
+	{
+		int l_value = l_values[i];
+
+		l_length += snprintf(text + l_length, size - l_length, "%s%s%d.%d", (i > 0) ? ", " : "", (l_value < 0) ? "-" : "",
+			abs(l_value) / 10, abs(l_value) % 10);
+	}
+}
+
+// Runs a command, filling the response. Returns false for ERROR.
+// type: '=' (set, value follows), '?' (query) or 0 (action).
+boolean LoRamDotSimulator::Execute(const char *name, char type, const char *value, unsigned long *extraMs)
+{
+	char l_text[SIMULATOR_VALUE_SIZE];
+
+	if (name[0] == '\0' || strcmp(name, "Z") == 0 || strcmp(name, "&W") == 0 || strcmp(name, "&F") == 0 || strcmp(name, "SLEEP") == 0
+		|| strcmp(name, "SD") == 0)
+	{
+		if (strcmp(name, "&W") == 0)
+		{
+			memcpy(_saved, _settings, sizeof(_settings));
+			_savedCount = _settingCount;
+		}
+		else if (strcmp(name, "&F") == 0)
+		{
+			Defaults();
+		}
+
+		return true;
+	}
+
+	if (strcmp(name, "I") == 0)
+	{
+		Respond("mDot simulator");
+		return true;
+	}
+	if (strcmp(name, "DI") == 0)
+	{
+		Respond("00-80-00-00-00-00-00-01");
+		return true;
+	}
+	if (strcmp(name, "FREQ") == 0)
+	{
+		Respond((_band == FREQUENCY_BAND_EU) ? "FB_EU868" : "FB_US915");
+		return true;
+	}
+	if (strcmp(name, "&V") == 0)
+	{
+		SettingsTable();
+		return true;
+	}
+	if (strcmp(name, "&S") == 0)
+	{
+		Respond("Join Attempts:  %lu", _joinAttempts);
+		Respond("Join Fails:     %lu", _joinFails);
+		Respond("Up Packets:     %lu", _uplinks);
+		Respond("Down Packets:   %lu", _downlinks);
+		Respond("Missed Acks:    0");
+		Respond("CRC Errors:     0");
+		return true;
+	}
+	if (strcmp(name, "&R") == 0)
+	{
+		_joinAttempts = _joinFails = _uplinks = _downlinks = 0;
+		_rssiSum = _snrSum = 0;
+		return true;
+	}
+	if (strcmp(name, "JOIN") == 0)
+	{
+		_joinAttempts++;
+
+		if (_joinFailures > 0)
+		{
+			_joinFailures--;
+			_joinFails++;
+			_joined = false;
+			Respond("Failed to join network");
+			return false;
+		}
+
+		_joined = true;
+		SetNumber("ULC", 1);
+		Respond("Successfully joined network");
+		return true;
+	}
+	if (strcmp(name, "NJS") == 0)
+	{
+		Respond("%d", _joined ? 1 : 0);
+		return true;
+	}
+	if (strcmp(name, "SS") == 0)
+	{
+		_sessionSaved = _joined;
+		_savedCounter = GetNumber("ULC", 1);
+		return true;
+	}
+	if (strcmp(name, "RS") == 0)
+	{
+		if (_sessionSaved)
+		{
+			_joined = true;
+			SetNumber("ULC", _savedCounter);
+		}
+		return true;
+	}
+	if (strcmp(name, "SEND") == 0 && type == '=')
+	{
+		return Send((const uint8_t *)value, strlen(value), extraMs);
+	}
+	if (strcmp(name, "SENDB") == 0 && type == '=')
+	{
+		uint8_t l_data[PAYLOAD_SIZE_MAX + 1];
+		size_t l_length = 0;
+
+		for (; value[0] != '\0'; value += 2)
+		{
+			if (HexValue(value[0]) < 0 || HexValue(value[1]) < 0 || l_length == sizeof(l_data))
+			{
+				Respond("Invalid hexadecimal data");
+				return false;
+			}
+
+			l_data[l_length++] = (uint8_t)((HexValue(value[0]) << 4) | HexValue(value[1]));
+		}
+
+		return Send(l_data, l_length, extraMs);
+	}
+	if (strcmp(name, "RECV") == 0)
+	{
+		_downlinkPending = false;
+
+		if (GetNumber("RXO", 0) == DATA_FORMAT_RAW)
+		{
+			Respond("");
+			RespondBytes(_downlink, _downlinkLength);
+			Respond("");
+		}
+		else if (_downlinkLength > 0)
+		{
+			char l_hex[PAYLOAD_SIZE_MAX * 2 + 1];
+
+			for (size_t i = 0; i < _downlinkLength; i++)
+				snprintf(l_hex + i * 2, 3, "%02X", _downlink[i]);
+
+			Respond("%s", l_hex);
+		}
+
+		return true;
+	}
+	if (strcmp(name, "DP") == 0)
+	{
+		Respond("%d", _downlinkPending ? 1 : 0);
+		return true;
+	}
+	if (strcmp(name, "TXN") == 0)
+	{
+		long l_wait = (long)(_nextTransmit - millis());
+
+		Respond("%ld", (l_wait > 0) ? l_wait : 0L);
+		return true;
+	}
+	if (strcmp(name, "SDR") == 0)
+	{
+		char l_rate[SIMULATOR_VALUE_SIZE];
+
+		DataRateText(l_rate, sizeof(l_rate));
+		Respond("%s", l_rate);
+		return true;
+	}
+	if (strcmp(name, "TOA") == 0 && type == '=')
+	{
+		Respond("%lu", LoRaWANTimeOnAir(_band, DataRate(), (byte)atoi(value), (byte)GetNumber("FEC", 1)));
+		return true;
+	}
+	if (strcmp(name, "RSSI") == 0 || strcmp(name, "SNR") == 0)
+	{
+		boolean l_snr = (strcmp(name, "SNR") == 0);
+
+		if (_downlinks == 0)
+			SignalText(l_text, sizeof(l_text), 0, 0, 0, 0, l_snr);
+		else if (l_snr)
+			SignalText(l_text, sizeof(l_text), _snr, _snrMin, _snrMax, (int)(_snrSum / (long)_downlinks), true);
+		else
+			SignalText(l_text, sizeof(l_text), _rssi, _rssiMin, _rssiMax, (int)(_rssiSum / (long)_downlinks), false);
+
+		Respond("%s", l_text);
+		return true;
+	}
+	if (strcmp(name, "PING") == 0 || strcmp(name, "NLC") == 0)
+	{
+		if (!_joined)
+		{
+			Respond("Network not joined");
+			return false;
+		}
+
+		if (strcmp(name, "PING") == 0)
+			Respond("%d,%s%d.%d", _rssi, (_snr < 0) ? "-" : "", abs(_snr) / 10, abs(_snr) % 10);
+		else
+			Respond("20,1");
+
+		return true;
+	}
+
+	// Any other setting is stored and returned by its query
+	if (type == '=')
+	{
+		SetSetting(name, value);
+		return true;
+	}
+
+	const char *l_setting = GetSetting(name, NULL);
+
+	if (l_setting == NULL)
+	{
+		Respond("Unknown command");
+		return false;
+	}
+
+	Respond("%s", l_setting);
+	return true;
+}
+
+// Sends an uplink and delivers a queued downlink.
+boolean LoRamDotSimulator::Send(const uint8_t *data, size_t length, unsigned long *extraMs)
+{
+	if (!_joined)
+	{
+		Respond("Network not joined");
+		return false;
+	}
+
+	if (length > MaxPayload())
+	{
+		Respond("Data exceeds datarate max payload");
+		return false;
+	}
+
+	if ((long)(_nextTransmit - millis()) > 0)
+	{
+		Respond("No channel available");
+		return false;
+	}
+
+	unsigned long l_airtime = LoRaWANTimeOnAir(_band, DataRate(), (byte)length, (byte)GetNumber("FEC", 1));
+
+	memcpy(_uplink, data, length);
+	_uplinkLength = length;
+	_uplinks++;
+	SetNumber("ULC", GetNumber("ULC", 1) + 1);
+	// The channel is free once the packet is on air (when timed) plus the duty cycle off time
+	_nextTransmit = millis() + (_airtimeLatency ? l_airtime : 0) + l_airtime * (_dutyCycle - 1);
+
+	// Receive windows end 2 seconds after the uplink
+	if (_airtimeLatency)
+		*extraMs = l_airtime + ((GetNumber("TXW", 1) != 0) ? 2000 : 0);
+
+	if (_downlinkQueued)
+	{
+		_downlinkQueued = false;
+		_downlinkPending = true;
+
+		_rssiMin = (_downlinks == 0 || _rssi < _rssiMin) ? _rssi : _rssiMin;
+		_rssiMax = (_downlinks == 0 || _rssi > _rssiMax) ? _rssi : _rssiMax;
+		_snrMin = (_downlinks == 0 || _snr < _snrMin) ? _snr : _snrMin;
+		_snrMax = (_downlinks == 0 || _snr > _snrMax) ? _snr : _snrMax;
+		_rssiSum += _rssi;
+		_snrSum += _snr;
+		_downlinks++;
+
+		_announceDownlink = (GetNumber("URC", 0) != 0);
+	}
+
+	return true;
+}
+
+// Writes the TX data rate as the mDot shows it (e.g. "DR0 - SF10BW125").
+void LoRamDotSimulator::DataRateText(char *text, size_t size)
+{
+	byte l_dataRate = DataRate();
+
+	if (LoRaWANBandwidth(_band, l_dataRate) == LORA_BANDWIDTH_FSK)
+		snprintf(text, size, "DR%d - FSK", l_dataRate);
+	else
+		snprintf(text, size, "DR%d - SF%dBW%lu", l_dataRate, LoRaWANSpreadingFactor(_band, l_dataRate), LoRaWANBandwidth(_band, l_dataRate) / 1000);
+}
+
+// Writes the AT&V table.
+void LoRamDotSimulator::SettingsTable()
+{
+	static const char *JOIN_MODES[] = { "MANUAL", "OTA", "AUTO_OTA", "PEER_TO_PEER" };
+	long l_joinMode = GetNumber("NJM", 1);
+	long l_ack = GetNumber("ACK", 0);
+	long l_linkCheckCount = GetNumber("LCC", 0);
+	long l_linkCheckThreshold = GetNumber("LCT", 0);
+	char l_text[SIMULATOR_VALUE_SIZE];
+
+	Respond("Device ID:          00:80:00:00:00:00:00:01");
+	Respond("Frequency Band:     %s", (_band == FREQUENCY_BAND_EU) ? "FB_EU868" : "FB_US915");
+	Respond("Frequency Sub Band: %s", GetSetting("FSB", "0"));
+	Respond("Public Network:     %s", GetNumber("PN", 1) ? "on" : "off");
+	Respond("Start Up Mode:      %s", GetNumber("SMODE", 0) ? "SERIAL_DATA" : "COMMAND");
+	Respond("Network Address:    %s", GetSetting("NA", "00000000"));
+	Respond("Network ID:         %s", GetSetting("NI", ""));
+	Respond("Network ID Passphrase: ");
+	Respond("Network Key:        %s", GetSetting("NK", ""));
+	Respond("Network Key Passphrase: ");
+	Respond("Network Join Mode:  %s", (l_joinMode >= 0 && l_joinMode <= 3) ? JOIN_MODES[l_joinMode] : "OTA");
+	Respond("Network Join Retries: %s", GetSetting("JR", "2"));
+	Respond("Preserve Session:   %s", GetNumber("PS", 0) ? "on" : "off");
+
+	if (l_linkCheckCount == 0)
+		Respond("Link Check Count:   off");
+	else
+		Respond("Link Check Count:   %ld packets", l_linkCheckCount);
+
+	if (l_linkCheckThreshold == 0)
+		Respond("Link Check Threshold: off");
+	else
+		Respond("Link Check Threshold: %ld", l_linkCheckThreshold);
+
+	Respond("Error Correction:   %s bytes", GetSetting("FEC", "1"));
+
+	if (l_ack == 0)
+		Respond("ACK Retries:        off");
+	else
+		Respond("ACK Retries:        %ld", l_ack);
+
+	Respond("Adaptive Data Rate: %s", GetNumber("ADR", 0) ? "on" : "off");
+	Respond("Command Echo:       %s", GetNumber("E", 1) ? "on" : "off");
+
+	DataRateText(l_text, sizeof(l_text));
+	Respond("Tx Data Rate:       %s", l_text);
+	Respond("Rx Data Rate:       %s", GetSetting("RXDR", "DR8"));
+	Respond("Tx Power:           %s", GetSetting("TXP", "11"));
+	Respond("Tx Wait:            %s", GetNumber("TXW", 1) ? "on" : "off");
+	Respond("Receive Output:     %s", (GetNumber("RXO", 0) == DATA_FORMAT_RAW) ? "RAW" : "HEXADECIMAL");
+	Respond("Serial Baud Rate:   %s", GetSetting("IPR", "115200"));
+	Respond("Wake Mode:          %s", GetNumber("WM", 0) ? "INTERRUPT" : "INTERVAL");
+	Respond("Wake Interval:      %s s", GetSetting("WI", "10"));
+	Respond("Wake Delay:         %s ms", GetSetting("WD", "100"));
+	Respond("Wake Timeout:       %s ms", GetSetting("WTO", "20"));
+	Respond("Wake Pin:           DI%s", GetSetting("WP", "8"));
+	Respond("Class:              %s", GetSetting("DC", "A"));
+	Respond("App Port:           %s", GetSetting("AP", "1"));
+	Respond("Maximum Size:       %d", MaxPayload());
+}
@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// LoRamDotSimulator.h
+//
+// A simulated mDot for running LoRamDot on a host (Linux) without hardware. It implements Stream, so it is
+// passed to LoRamDot::begin() in place of the serial port, and answers the AT commands the library sends
+// (AT+JOIN, AT+SEND, AT+SENDB, AT+RECV, AT&V, AT&S, AT+TXN, AT+SDR, AT+TOA, AT+RSSI, AT+SNR, settings, ...).
+//
+// Responses become readable after the command's latency and are then paced at the baud rate, like a real serial
+// link. Errors, dropped and corrupted responses are injected from a seeded generator so runs are repeatable.
+// Downlinks queued with QueueDownlink() are delivered with the next uplink.
+//
+//		g++ -std=gnu++11 -DARDUINO=10800 -Iextras/host -I. LORAMDOT.cpp extras/host/Arduino.cpp extras/host/LoRamDotSimulator.cpp app.cpp
+
+#ifndef _LORAMDOTSIMULATOR_h
+	#define _LORAMDOTSIMULATOR_h
+
+#include "Arduino.h"
+#include "LoRamDot.h"
+
+#ifndef LORAMDOT_SIMULATOR_OUTPUT_SIZE
+	#define LORAMDOT_SIMULATOR_OUTPUT_SIZE 8192			// Bytes of responses waiting to be read
+#endif
+
+#ifndef LORAMDOT_SIMULATOR_SETTINGS
+	#define LORAMDOT_SIMULATOR_SETTINGS 64				// Settings (AT+name=value) remembered
+#endif
+
+#ifndef LORAMDOT_SIMULATOR_LATENCIES
+	#define LORAMDOT_SIMULATOR_LATENCIES 16				// Commands with their own latency
+#endif
+
+const byte SIMULATOR_NAME_SIZE = 8;						// Longest setting or command name (e.g. "TXDR")
+const byte SIMULATOR_VALUE_SIZE = 64;					// Longest setting value (e.g. a 16 byte key with separators)
+const unsigned int SIMULATOR_LINE_SIZE = 600;			// Longest command line (AT+SENDB with 242 bytes)
+const unsigned int SIMULATOR_OVERSPEED_ERRORS = 20;		// Bytes garbled per thousand while the mDot runs faster than the baud rate limit
+
+// Simulated mDot implementing Stream.
+class LoRamDotSimulator : public Stream
+{
+public:
+	LoRamDotSimulator(byte band = FREQUENCY_BAND_US_AU);	// band: FREQUENCY_BAND_US_AU (FB_US915) or FREQUENCY_BAND_EU (FB_EU868)
+
+	// Stream
+	size_t write(uint8_t c);							// Receives a command byte. Commands are run when the carriage return arrives.
+	size_t write(const uint8_t *buffer, size_t size);
+	int available();									// Returns the response bytes that have arrived (after the latency and baud pacing).
+	int read();
+	int peek();
+
+	// Timing
+	void setBaudRate(unsigned long baud);				// Paces the responses at baud (10 bits per byte). 0 (default) delivers them at once.
+	void setLatency(unsigned long ms);					// Sets the time every command takes before its response starts (default 0).
+	boolean setLatency(const char *command, unsigned long ms);	// Sets the latency of one command (e.g. "AT+JOIN"). Returns false if the table is full.
+	void setAirtimeLatency(boolean enabled);			// Adds the packet's time on air (and the receive windows with TX wait) to AT+SEND/AT+SENDB.
+	void setDutyCycle(unsigned int dutyCycle);			// Sets the off time factor after each uplink (1 none, 100 for 1%). Default: 100 for EU, 1 for US/AU.
+
+	// Serial link
+	void setHostBaudRate(unsigned long baud);			// Sets the rate of the host's serial port and paces the responses at it. While it differs from the mDot's
+														// rate (AT+IPR, applied at restart) every byte is garbled in both directions. 0 (default) never garbles.
+	void setBaudRateLimit(unsigned long baud);			// Garbles bytes (SIMULATOR_OVERSPEED_ERRORS per thousand) while the mDot runs faster than baud. 0 (default): no limit.
+	unsigned long BaudRate();							// Returns the mDot's baud rate (the AT+IPR setting at the last restart).
+
+	// Error injection
+	void setSeed(unsigned long seed);					// Seeds the error injection generator (default 1).
+	void setErrorRate(unsigned int perMille);			// Commands answered with ERROR (per thousand).
+	void setDropRate(unsigned int perMille);			// Commands that are never answered (per thousand).
+	void setCorruptRate(unsigned int perMille);			// Responses with one changed byte (per thousand).
+	void setJoinFailures(byte count);					// The next count join attempts fail.
+
+	// Network
+	boolean QueueDownlink(const uint8_t *data, size_t length);	// Queues a downlink delivered with the next uplink (one is held at a time).
+	void setSignal(int rssi, int snrTenths);			// Sets the RSSI (dBm) and SNR (tenths of a dB) of the downlinks received.
+	void Inject(const char *text, unsigned long delayMs = 0);	// Sends unsolicited text (e.g. "RECV\r\n") after delayMs.
+	void Restart();										// Restarts the mDot: unsaved settings are lost and the start up banner is sent.
+
+	// Serial data mode (AT+SD until +++). Packets end after AT+WTO without a byte or when full. The mDot then sleeps
+	// for the time on air, the receive windows and (AT+WM=0) AT+WI seconds, and listens for AT+WD after waking.
+	boolean DataMode();									// Returns true while the simulated mDot is in serial data mode.
+	boolean ClearToSend();								// Returns the CTS line: false while the mDot sleeps or its packet is full.
+	unsigned long DataBytes();							// Returns the bytes sent as packets in serial data mode.
+	unsigned long DataLost();							// Returns the bytes written in serial data mode while the mDot slept.
+
+	// Inspection
+	unsigned long Commands();							// Returns the number of commands received.
+	unsigned long Uplinks();							// Returns the number of uplinks sent.
+	boolean Joined();									// Returns true if the simulated mDot has joined the network.
+	const char *LastCommand();							// Returns the last command line received (without the line ending).
+	size_t LastUplink(uint8_t *buffer, size_t capacity);	// Copies the last uplink payload into buffer and returns its length.
+	const char *Setting(const char *name);				// Returns the value of a setting (e.g. "TXDR") or NULL if it has none.
+
+private:
+	// Settings (current and saved with AT&W)
+	struct SimulatorSetting
+	{
+		char name[SIMULATOR_NAME_SIZE + 1];
+		char value[SIMULATOR_VALUE_SIZE + 1];
+	};
+
+	SimulatorSetting _settings[LORAMDOT_SIMULATOR_SETTINGS];
+	SimulatorSetting _saved[LORAMDOT_SIMULATOR_SETTINGS];
+	byte _settingCount = 0;
+	byte _savedCount = 0;
+	byte _band;
+
+	// Command line received
+	char _line[SIMULATOR_LINE_SIZE + 1];
+	unsigned int _lineLength = 0;
+	char _lastCommand[SIMULATOR_LINE_SIZE + 1];
+	unsigned long _commands = 0;
+
+	// Responses waiting to be read, each byte with the micros() it arrives at
+	uint8_t _output[LORAMDOT_SIMULATOR_OUTPUT_SIZE];
+	unsigned long _arrival[LORAMDOT_SIMULATOR_OUTPUT_SIZE];
+	unsigned int _outputHead = 0;						// Next byte read
+	unsigned int _outputArrived = 0;					// Bytes before this index have arrived
+	unsigned int _outputTail = 0;						// Next byte written
+	unsigned long _lastArrival = 0;						// Arrival of the last byte written
+
+	// Timing
+	unsigned long _byteMicros = 0;						// Time to send one byte at the baud rate (0: no pacing)
+	unsigned long _latency = 0;							// Default command latency (ms)
+	char _latencyCommands[LORAMDOT_SIMULATOR_LATENCIES][SIMULATOR_NAME_SIZE + 1];
+	unsigned long _latencies[LORAMDOT_SIMULATOR_LATENCIES];
+	byte _latencyCount = 0;
+	boolean _airtimeLatency = false;
+	unsigned int _dutyCycle;
+	unsigned long _nextTransmit = 0;					// millis() when the next uplink may be sent
+
+	// Serial link
+	unsigned long _hostBaud = 0;						// Rate of the host's serial port (0: always matches)
+	unsigned long _baudLimit = 0;						// Fastest rate the link carries without errors (0: no limit)
+	unsigned long _uartBaud = 0;						// Rate the mDot is using
+
+	// Error injection
+	unsigned long _seed = 1;
+	unsigned int _errorRate = 0;
+	unsigned int _dropRate = 0;
+	unsigned int _corruptRate = 0;
+	byte _joinFailures = 0;
+
+	// Network
+	boolean _joined = false;
+	boolean _sessionSaved = false;
+	unsigned long _savedCounter = 0;					// Uplink counter (AT+ULC) saved with the session
+	uint8_t _uplink[PAYLOAD_SIZE_MAX];
+	size_t _uplinkLength = 0;
+	uint8_t _downlink[PAYLOAD_SIZE_MAX];
+	size_t _downlinkLength = 0;
+	boolean _downlinkQueued = false;
+	boolean _downlinkPending = false;					// Delivered and not yet read with AT+RECV
+	boolean _announceDownlink = false;					// Send RECV after the current response (AT+URC=1)
+	int _rssi = -60;
+	int _snr = 75;
+	int _rssiMin = 0, _rssiMax = 0, _snrMin = 0, _snrMax = 0;
+	long _rssiSum = 0, _snrSum = 0;
+	unsigned long _joinAttempts = 0, _joinFails = 0, _uplinks = 0, _downlinks = 0;
+
+	// Serial data mode
+	boolean _dataMode = false;
+	boolean _dataLineEnd = false;						// The LF ending the AT+SD line is still to come
+	uint8_t _data[PAYLOAD_SIZE_MAX];					// Packet being filled
+	size_t _dataLength = 0;
+	unsigned long _dataLastByte = 0;					// millis() when the last byte of the packet arrived
+	unsigned long _dataWake = 0;						// millis() when the mDot wakes (or woke) to read data
+	unsigned long _dataBytes = 0, _dataLost = 0;
+
+	// Response being built by the current command
+	char _response[LORAMDOT_SIMULATOR_OUTPUT_SIZE];
+	unsigned int _responseLength = 0;
+
+	void Defaults();									// Restores the factory settings
+	void SetSetting(const char *name, const char *value);
+	const char *GetSetting(const char *name, const char *defaultValue);
+	long GetNumber(const char *name, long defaultValue);
+	void SetNumber(const char *name, unsigned long value);
+	byte DataRate();									// Returns the TX data rate (DR number)
+	byte MaxPayload();									// Returns the largest payload at the TX data rate
+	unsigned long Random(unsigned long range);			// Returns a repeatable pseudo random number from 0 to range - 1
+	uint8_t Garble(uint8_t c);							// Returns a byte as it arrives over the link (garbled at a wrong or too fast baud rate)
+	unsigned long Latency(const char *name);			// Returns the latency of a command (ms)
+
+	void Respond(const char *format, ...);				// Appends a line to the response
+	void RespondBytes(const uint8_t *data, size_t length);	// Appends bytes to the response
+	void Queue(const char *text, unsigned int length, unsigned long readyMicros);	// Queues bytes that arrive from readyMicros on, paced at the baud rate
+	void RunCommand();									// Runs the command line received
+	boolean Execute(const char *name, char type, const char *value, unsigned long *extraMs);	// Runs a command, filling the response. Returns false for ERROR.
+	boolean Send(const uint8_t *data, size_t length, unsigned long *extraMs);	// Sends an uplink and delivers a queued downlink
+	void DataRateText(char *text, size_t size);			// Writes the TX data rate as the mDot shows it (e.g. "DR0 - SF10BW125")
+	void SettingsTable();								// Writes the AT&V table
+	void UpdateDataMode();								// Sends the packet once AT+WTO passes without a byte and sleeps through wake windows without data
+	void ReceiveData(uint8_t c);						// Receives a byte in serial data mode
+	void SendData(unsigned long closedAt);				// Sends the packet ended at closedAt and sleeps until the next wake
+};
+
+#endif
@@ -0,0 +1,289 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// benchmark.cpp
+//
+// Host benchmark of the library's hot paths (command round trips, SendBinary, response accumulation and parsing).
+// Each benchmark reports the wall time per call (mean, median, 99th percentile), the CPU time per call, the heap
+// allocations and bytes allocated per call and, for the receive benchmarks, the response throughput in MB/s.
+// Results are written as one JSON object per line so runs can be compared by a script.
+//
+//		g++ -std=gnu++11 -O2 -DARDUINO=10800 -Iextras/host -I. extras/host/benchmark.cpp LORAMDOT.cpp extras/host/Arduino.cpp extras/host/LoRamDotSimulator.cpp -o benchmark
+//		./benchmark [iterations]		(default 2000)
+//
+// The command benchmarks run against LoRamDotSimulator with no latency or baud pacing, so they measure the library
+// and the simulator. The receive benchmarks replay a fixed response from memory (ReplayStream) so they measure
+// the library's response accumulation and parsing alone.
+
+#include <time.h>
+
+#include "LoRamDotSimulator.h"
+
+/////////////////////////////////////////////
+// Heap Allocation Counting
+/////////////////////////////////////////////
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+static bool g_counting = false;							// Count allocations (only while a measured call runs)
+static unsigned long g_allocations = 0;					// Allocations counted (malloc, calloc, realloc)
+static unsigned long g_allocatedBytes = 0;				// Bytes requested by the allocations counted
+
+extern "C" void *malloc(size_t size)
+{
+	if (g_counting)
+	{
+		g_allocations++;
+		g_allocatedBytes += size;
+	}
+
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+	if (g_counting)
+	{
+		g_allocations++;
+		g_allocatedBytes += count * size;
+	}
+
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+	if (g_counting)
+	{
+		g_allocations++;
+		g_allocatedBytes += size;
+	}
+
+	return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer)
+{
+	__libc_free(pointer);
+}
+
+/////////////////////////////////////////////
+// Replay Stream
+/////////////////////////////////////////////
+
+// Answers every command line with the same response, served from memory.
+class ReplayStream : public Stream
+{
+public:
+	void setResponse(const char *response, size_t length)
+	{
+		_response = response;
+		_length = length;
+		_position = length;
+	}
+
+	size_t write(uint8_t c)
+	{
+		// The response starts once the command line ends
+		if (c == '\n')
+			_position = 0;
+
+		return 1;
+	}
+
+	int available() { return (int)(_length - _position); }
+	int read() { return (_position < _length) ? (uint8_t)_response[_position++] : -1; }
+	int peek() { return (_position < _length) ? (uint8_t)_response[_position] : -1; }
+
+private:
+	const char *_response = "";
+	size_t _length = 0;
+	size_t _position = 0;
+};
+
+/////////////////////////////////////////////
+// Measurement
+/////////////////////////////////////////////
+
+// Returns a clock in nanoseconds.
+static unsigned long long Nanoseconds(clockid_t clock)
+{
+	struct timespec l_now;
+
+	clock_gettime(clock, &l_now);
+
+	return (unsigned long long)l_now.tv_sec * 1000000000ULL + l_now.tv_nsec;
+}
+
+static int CompareTimes(const void *left, const void *right)
+{
+	unsigned long long l_left = *(const unsigned long long *)left;
+	unsigned long long l_right = *(const unsigned long long *)right;
+
+	return (l_left < l_right) ? -1 : (l_left > l_right) ? 1 : 0;
+}
+
+typedef bool (*BenchmarkCall)();
+
+// Runs call iterations times (after a warm up) and writes the results as a JSON line.
+// responseBytes: Bytes of response each call receives (0 when the throughput is not meaningful).
+static bool Measure(const char *name, BenchmarkCall call, unsigned long iterations, size_t responseBytes)
+{
+	static unsigned long long s_times[1000000];
+
+	if (iterations > sizeof(s_times) / sizeof(s_times[0]))
+		iterations = sizeof(s_times) / sizeof(s_times[0]);
+
+	for (unsigned long i = 0; i < iterations / 10 + 1; i++)
+	{
+		if (!call())
+		{
+			fprintf(stderr, "%s failed\n", name);
+			return false;
+		}
+	}
+
+	unsigned long long l_wallTotal = 0;
+	unsigned long long l_cpuStart = Nanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+
+	g_allocations = 0;
+	g_allocatedBytes = 0;
+
+	for (unsigned long i = 0; i < iterations; i++)
+	{
+		unsigned long long l_start = Nanoseconds(CLOCK_MONOTONIC);
+
+		g_counting = true;
+		bool l_result = call();
+		g_counting = false;
+
+		s_times[i] = Nanoseconds(CLOCK_MONOTONIC) - l_start;
+		l_wallTotal += s_times[i];
+
+		if (!l_result)
+		{
+			fprintf(stderr, "%s failed\n", name);
+			return false;
+		}
+	}
+
+	unsigned long long l_cpuTotal = Nanoseconds(CLOCK_PROCESS_CPUTIME_ID) - l_cpuStart;
+
+	qsort(s_times, iterations, sizeof(s_times[0]), CompareTimes);
+
+	double l_wallMean = (double)l_wallTotal / iterations;
+
+	printf("{\"benchmark\":\"%s\",\"iterations\":%lu,\"wall_ns_mean\":%.0f,\"wall_ns_p50\":%llu,\"wall_ns_p99\":%llu,"
+		"\"cpu_ns_per_call\":%.0f,\"allocations_per_call\":%.2f,\"bytes_allocated_per_call\":%.1f",
+		name, iterations, l_wallMean, s_times[iterations / 2], s_times[(iterations * 99) / 100],
+		(double)l_cpuTotal / iterations, (double)g_allocations / iterations, (double)g_allocatedBytes / iterations);
+
+	if (responseBytes > 0)
+		printf(",\"response_bytes\":%lu,\"mb_per_s\":%.2f", (unsigned long)responseBytes, responseBytes / l_wallMean * 1000.0);
+
+	printf("}\n");
+	fflush(stdout);
+
+	return true;
+}
+
+/////////////////////////////////////////////
+// Benchmarks
+/////////////////////////////////////////////
+
+static LoRamDotSimulator g_simulator(FREQUENCY_BAND_US_AU);
+static LoRamDot g_simulated(g_simulator);
+static ReplayStream g_replay;
+static LoRamDot g_replayed(g_replay);
+
+static uint8_t g_payload[PAYLOAD_SIZE_MAX];
+static uint8_t g_received[PAYLOAD_SIZE_MAX];
+static LoRamDotSnapshot g_snapshot;
+static LoRamDotSignal g_signal;
+
+static bool CommandAT() { return g_simulated.SendCommand("AT"); }
+static bool CommandQuery() { return g_simulated.ReadSignalStrength(g_signal); }
+static bool SendString() { return g_simulated.Send("Hello World"); }
+static bool SendBinary242() { return g_simulated.SendBinary(g_payload, sizeof(g_payload)); }
+static bool ReceiveBuffer() { return g_simulated.ReceiveOnce(g_received, sizeof(g_received)) == sizeof(g_received); }
+static bool SettingsString() { return g_simulated.SettingsAndStatus().length() > 0; }
+static bool SettingsSnapshot() { return g_simulated.ReadSnapshot(g_snapshot) && g_snapshot.fields > 0; }
+static bool ReplayCommand() { return g_replayed.SendCommand("AT"); }
+static bool ReplaySnapshot() { return g_replayed.ReadSnapshot(g_snapshot) && g_snapshot.fields > 0; }
+
+int main(int argc, char *argv[])
+{
+	unsigned long l_iterations = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000;
+
+	if (l_iterations == 0)
+		l_iterations = 1;
+
+	for (size_t i = 0; i < sizeof(g_payload); i++)
+		g_payload[i] = (uint8_t)i;
+
+	// Joined at DR4 (242 byte payloads) with no duty cycle so every send succeeds
+	g_simulator.setDutyCycle(1);
+	g_simulated.setTimeout(1000);
+	g_simulated.TXDataRate("DR4");
+	g_simulated.Join();
+	g_simulator.QueueDownlink(g_payload, sizeof(g_payload));
+	g_simulated.SendBinary(g_payload, 1);
+
+	bool l_ok = Measure("SendCommand/AT", CommandAT, l_iterations, 0);
+	l_ok &= Measure("ReadSignalStrength/AT+RSSI", CommandQuery, l_iterations, 0);
+	l_ok &= Measure("Send/11B", SendString, l_iterations, 0);
+	l_ok &= Measure("SendBinary/242B", SendBinary242, l_iterations, 0);
+	l_ok &= Measure("ReceiveOnce/242B", ReceiveBuffer, l_iterations, 0);
+	l_ok &= Measure("SettingsAndStatus/AT&V", SettingsString, l_iterations, 0);
+	l_ok &= Measure("ReadSnapshot/AT&V", SettingsSnapshot, l_iterations, 0);
+
+	// Response accumulation: 8 KB of 64 character lines
+	static char s_bulk[8192 + 16];
+	size_t l_length = 0;
+
+	while (l_length + 66 <= 8192)
+	{
+		for (int i = 0; i < 64; i++)
+			s_bulk[l_length + i] = "0123456789ABCDEF"[i & 15];
+
+		l_length += 64;
+
+		s_bulk[l_length++] = '\r';
+		s_bulk[l_length++] = '\n';
+	}
+
+	l_length += snprintf(s_bulk + l_length, sizeof(s_bulk) - l_length, "\r\nOK\r\n");
+
+	g_replayed.setTimeout(1000);
+	g_replay.setResponse(s_bulk, l_length);
+	l_ok &= Measure("ReceiveResponse/8KB", ReplayCommand, l_iterations, l_length);
+
+	// Snapshot parsing of the simulator's AT&V table
+	static char s_table[LORAMDOT_SIMULATOR_OUTPUT_SIZE];
+	LoRamDotSimulator l_source(FREQUENCY_BAND_US_AU);
+
+	l_source.write((const uint8_t *)"AT&V\r\n", 6);
+
+	for (l_length = 0; l_source.available() > 0 && l_length < sizeof(s_table); l_length++)
+		s_table[l_length] = (char)l_source.read();
+
+	g_replay.setResponse(s_table, l_length);
+	l_ok &= Measure("ReadSnapshot/parse", ReplaySnapshot, l_iterations, l_length);
+
+	return l_ok ? 0 : 1;
+}
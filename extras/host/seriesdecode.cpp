@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// seriesdecode.cpp
+//
+// Host side decompressor for uplinks built with LoRamDotSeriesEncoder. Prints one sample per line.
+//
+//		g++ -std=c++11 -I../.. seriesdecode.cpp ../../LoRamDotSeries.cpp -o seriesdecode
+//		./seriesdecode cc2100020000000100	(hex payload as received from the network server)
+//		./seriesdecode -n cc21000200000100	(-n: the encoder was created without run-length encoding)
+
+#include <stdio.h>
+#include <string.h>
+
+#include "LoRamDotSeries.h"
+
+// Returns the value of a hex digit or -1 if c is not a hex digit.
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	bool l_runLength = true;
+	int l_arg = 1;
+
+	if (l_arg < argc && strcmp(argv[l_arg], "-n") == 0)
+	{
+		l_runLength = false;
+		l_arg++;
+	}
+
+	if (l_arg >= argc)
+	{
+		fprintf(stderr, "Usage: %s [-n] <hex payload>\n", argv[0]);
+		return 2;
+	}
+
+	uint8_t l_payload[LORAMDOT_SERIES_BUFFER_SIZE];
+	size_t l_length = 0;
+	int l_high = -1;
+
+	// Separators (spaces, colons) between the bytes are ignored
+	for (const char *l_text = argv[l_arg]; *l_text != '\0'; l_text++)
+	{
+		int l_nibble = HexValue(*l_text);
+
+		if (l_nibble < 0)
+			continue;
+
+		if (l_high < 0)
+		{
+			l_high = l_nibble;
+		}
+		else
+		{
+			if (l_length == sizeof(l_payload))
+			{
+				fprintf(stderr, "Payload longer than %d bytes\n", LORAMDOT_SERIES_BUFFER_SIZE);
+				return 1;
+			}
+
+			l_payload[l_length++] = (uint8_t)((l_high << 4) | l_nibble);
+			l_high = -1;
+		}
+	}
+
+	LoRamDotSeriesDecoder l_decoder(l_payload, l_length, l_runLength);
+	int32_t l_value;
+
+	while (l_decoder.Next(&l_value))
+		printf("%ld\n", (long)l_value);
+
+	return 0;
+}
@@ -0,0 +1,847 @@
+/*
+Copyright (c) 2016 Shaun Price.  All right reserved.
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+// test.cpp
+//
+// Host tests of the library and its helper classes, run against LoRamDotSimulator. Responses the simulator cannot
+// produce are replayed from a script (ScriptStream). Each failed check is printed with its line, and the exit status
+// is the number of failures.
+//
+//		g++ -std=gnu++11 -DARDUINO=10800 -Iextras/host -I. extras/host/test.cpp LORAMDOT.cpp LoRamDotScheduler.cpp LoRamDotAggregator.cpp LoRamDotSeries.cpp LoRamDotJoiner.cpp LoRamDotLinkWindow.cpp LoRamDotDataWriter.cpp extras/host/Arduino.cpp extras/host/LoRamDotSimulator.cpp extras/host/LoRamDotManager.cpp extras/host/LoRamDotSerialPort.cpp -lutil -o test
+//		./test
+
+#include "LoRamDotSimulator.h"
+#include "LoRamDotAirtime.h"
+#include "LoRamDotAggregator.h"
+#include "LoRamDotScheduler.h"
+#include "LoRamDotLinkWindow.h"
+#include "LoRamDotPayload.h"
+#include "LoRamDotSeries.h"
+#include "LoRamDotJoiner.h"
+#include "LoRamDotDataWriter.h"
+#include "LoRamDotManager.h"
+#include "LoRamDotSerialPort.h"
+#include <pty.h>
+#include <unistd.h>
+
+static unsigned int g_checks = 0;						// Checks made
+static unsigned int g_failures = 0;						// Checks that failed
+
+#define CHECK(condition) Check((condition), #condition, __LINE__)
+
+// Counts a check and prints it if it failed.
+static void Check(bool passed, const char *text, int line)
+{
+	g_checks++;
+
+	if (!passed)
+	{
+		g_failures++;
+		printf("test.cpp:%d: check failed: %s\n", line, text);
+	}
+}
+
+/////////////////////////////////////////////
+// Scripted Responses
+/////////////////////////////////////////////
+
+// A Stream that answers every command line with the next scripted response, delivered all at once.
+class ScriptStream : public Stream
+{
+public:
+	void Add(const char *response) { if (_count < 8) _responses[_count++] = response; }
+
+	int available() { return (int)(_length - _position); }
+	int read() { return (_position < _length) ? (uint8_t)_buffer[_position++] : -1; }
+	int peek() { return (_position < _length) ? (uint8_t)_buffer[_position] : -1; }
+	size_t write(uint8_t c)
+	{
+		// The response follows the carriage return ending the command line
+		if (c == '\r' && _next < _count)
+		{
+			_length = strlen(_responses[_next]);
+			_position = 0;
+			memcpy(_buffer, _responses[_next++], _length);
+		}
+
+		return 1;
+	}
+	using Print::write;
+
+private:
+	const char *_responses[8];
+	byte _count = 0;
+	byte _next = 0;
+	char _buffer[4096];
+	size_t _length = 0;
+	size_t _position = 0;
+};
+
+/////////////////////////////////////////////
+// Tests
+/////////////////////////////////////////////
+
+// Responses end at a line that is exactly OK, however they are split, and keep their last bytes when longer than the ring buffer.
+static void TestResponseBuffer()
+{
+	ScriptStream l_script;
+	LoRamDot l_mDot(l_script);
+	String l_response;
+
+	l_mDot.setTimeout(500);
+
+	// A line that only starts or ends with OK does not end the response
+	l_script.Add("AT+X\r\nBOOK\r\nOKAY\r\n\r\nOK\r\n");
+	CHECK(l_mDot.SendCommand("AT+X", &l_response));
+	CHECK(l_response.indexOf("BOOK") >= 0 && l_response.indexOf("OKAY") >= 0);
+	CHECK(l_mDot.LastCommandStatusId() == COMMAND_STATUS_ID_OK);
+
+	// A response longer than the ring buffer keeps its last bytes and is still terminated
+	static char l_long[3000];
+	char *l_end = l_long + sprintf(l_long, "AT+Z\r\n");
+
+	for (int i = 0; i < 200; i++)
+		l_end += sprintf(l_end, "line %03d\r\n", i);
+	strcpy(l_end, "\r\nOK\r\n");
+
+	l_script.Add(l_long);
+	CHECK(l_mDot.SendCommand("AT+Z", &l_response));
+	CHECK(l_response.length() <= LORAMDOT_RESPONSE_BUFFER_SIZE);
+	CHECK(l_response.indexOf("line 199") >= 0);
+	CHECK(l_response.indexOf("line 000") < 0);
+
+	// Responses split across many reads by the baud pacing end at the same terminator
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_paced(l_simulator);
+
+	l_simulator.setBaudRate(SERIAL_SPEED_115200);
+	l_paced.setTimeout(1000);
+	CHECK(l_paced.SendCommand("AT&V", &l_response));
+	CHECK(l_response.indexOf("Receive Output") >= 0);
+	CHECK(l_paced.SendCommand("AT"));
+}
+
+// ERROR ends a response with its detail, and a join failure line fails the join without waiting for the timeout.
+static void TestFailureTerminators()
+{
+	ScriptStream l_script;
+	LoRamDot l_mDot(l_script);
+
+	l_mDot.setTimeout(500);
+
+	// ERROR fails the command with the line before it as the detail
+	l_script.Add("AT+Y\r\nInvalid parameter\r\n\r\nERROR\r\n");
+	CHECK(!l_mDot.SendCommand("AT+Y"));
+	CHECK(l_mDot.LastCommandStatusId() == COMMAND_STATUS_ID_ERROR);
+	CHECK(l_mDot.LastResponse().indexOf("Invalid parameter") >= 0);
+
+	// A join failure line without the ERROR that normally follows it fails the join within the settle time
+	l_script.Add("AT+JOIN\r\nFailed to join network\r\n");
+	unsigned long l_start = millis();
+	CHECK(!l_mDot.Join());
+	CHECK(millis() - l_start < 500);
+	CHECK(l_mDot.LastCommandStatusId() == COMMAND_STATUS_ID_ERROR);
+
+	// An error injected by the simulator ends the command at ERROR, and the next command succeeds
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_simulated(l_simulator);
+
+	l_simulated.setTimeout(500);
+	l_simulator.setErrorRate(1000);
+	CHECK(!l_simulated.SendCommand("AT"));
+	CHECK(l_simulated.LastCommandStatusId() == COMMAND_STATUS_ID_ERROR);
+	l_simulator.setErrorRate(0);
+	CHECK(l_simulated.SendCommand("AT"));
+}
+
+// ReceiveOnce() decodes the hex output into the buffer and drops bytes beyond its capacity.
+static void TestReceiveOnce()
+{
+	ScriptStream l_script;
+	LoRamDot l_mDot(l_script);
+	uint8_t l_buffer[8];
+
+	l_mDot.setTimeout(500);
+
+	// The echo line holds hex digits ('A') but is not decoded; lower case digits are
+	l_script.Add("AT+RECV\r\nDEADbeef01\r\n\r\nOK\r\n");
+	CHECK(l_mDot.ReceiveOnce(l_buffer, sizeof(l_buffer)) == 5);
+	CHECK(l_buffer[0] == 0xDE && l_buffer[1] == 0xAD && l_buffer[2] == 0xBE && l_buffer[3] == 0xEF && l_buffer[4] == 0x01);
+
+	memset(l_buffer, 0, sizeof(l_buffer));
+	l_script.Add("AT+RECV\r\n0102030405\r\n\r\nOK\r\n");
+	CHECK(l_mDot.ReceiveOnce(l_buffer, 3) == 3);
+	CHECK(l_buffer[0] == 1 && l_buffer[2] == 3 && l_buffer[3] == 0);
+
+	// A downlink delivered by the simulator with an uplink
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_sim(l_simulator);
+	const uint8_t l_downlink[] = { 0x00, 0x7F, 0x80, 0xFF };
+	const uint8_t l_uplink[] = { 1, 2 };
+
+	l_sim.setTimeout(500);
+	CHECK(l_sim.Join());
+	CHECK(l_simulator.QueueDownlink(l_downlink, sizeof(l_downlink)));
+	CHECK(l_sim.SendBinary(l_uplink, sizeof(l_uplink)));
+	CHECK(l_sim.ReceiveOnce(l_buffer, sizeof(l_buffer)) == sizeof(l_downlink));
+	CHECK(memcmp(l_buffer, l_downlink, sizeof(l_downlink)) == 0);
+}
+
+// The aggregator reads an unknown data rate before packing, repacks when the data rate is lowered and reports the
+// records that no longer fit.
+static void TestAggregator()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+	LoRamDotAggregator l_aggregator(l_mDot);
+	uint8_t l_record[4] = { 1, 2, 3, 4 };
+	uint8_t l_uplink[256];
+
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.Join());
+
+	// DR0 on US915 carries 11 bytes: two records per uplink
+	for (int i = 0; i < 5; i++)
+		CHECK(l_aggregator.Add(l_record, sizeof(l_record)));
+	CHECK(l_mDot.CurrentDataRate() == 0);
+	CHECK(l_aggregator.Flush());
+	CHECK(l_aggregator.Records() == 0);
+	CHECK(l_simulator.Uplinks() == 3);
+	CHECK(l_simulator.LastUplink(l_uplink, sizeof(l_uplink)) == 4);
+
+	// Packed for DR3 (242 bytes) but sent at DR0: the records are repacked into uplinks that fit
+	LoRamDot l_other(l_simulator);
+	unsigned long l_uplinks = l_simulator.Uplinks();
+
+	CHECK(l_mDot.TXDataRate("DR3"));
+	for (int i = 0; i < 10; i++)
+		CHECK(l_aggregator.Add(l_record, sizeof(l_record)));
+	CHECK(l_other.TXDataRate("DR0"));
+	CHECK(l_aggregator.Flush());
+	CHECK(l_mDot.CurrentDataRate() == 0);
+	CHECK(l_simulator.Uplinks() - l_uplinks == 5);
+	CHECK(l_aggregator.Records() == 0);
+	CHECK(l_aggregator.Dropped() == 0);
+
+	// A record that no longer fits any uplink is dropped and reported, and the records after it are still sent
+	uint8_t l_large[20] = { 0 };
+
+	l_uplinks = l_simulator.Uplinks();
+	CHECK(l_mDot.TXDataRate("DR3"));
+	CHECK(l_aggregator.Add(l_large, sizeof(l_large)));
+	CHECK(l_aggregator.Add(l_record, sizeof(l_record)));
+	CHECK(l_other.TXDataRate("DR0"));
+	CHECK(!l_aggregator.Flush());
+	CHECK(l_aggregator.Dropped() == 1);
+	CHECK(l_aggregator.Records() == 0);
+	CHECK(l_simulator.Uplinks() - l_uplinks == 1);
+	CHECK(l_simulator.LastUplink(l_uplink, sizeof(l_uplink)) == sizeof(l_record));
+}
+
+// Polls the scheduler until it stops waiting.
+static byte PollScheduler(LoRamDotScheduler &scheduler)
+{
+	byte l_state;
+
+	while ((l_state = scheduler.Poll()) == SCHEDULER_WAITING)
+		delay(1);
+
+	return l_state;
+}
+
+// Failed uplinks are backed off, dropped when they no longer fit, or resynchronized with the mDot's duty cycle.
+static void TestScheduler()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+	LoRamDotScheduler l_scheduler(l_mDot);
+	uint8_t l_record[20] = { 1 };
+
+	l_mDot.setTimeout(500);
+	l_scheduler.setBackoff(100, 400);
+
+	// Not joined: the uplink stays queued and no command is sent during the back off
+	CHECK(l_scheduler.Queue(l_record, 5));
+	CHECK(l_scheduler.Poll() == SCHEDULER_FAILED);
+	CHECK(l_scheduler.NextTransmit() > 50);
+
+	unsigned long l_commands = l_simulator.Commands();
+
+	for (int i = 0; i < 20; i++)
+		CHECK(l_scheduler.Poll() == SCHEDULER_WAITING);
+	CHECK(l_simulator.Commands() == l_commands);
+
+	CHECK(l_mDot.Join());
+	CHECK(PollScheduler(l_scheduler) == SCHEDULER_SENT);
+	CHECK(l_scheduler.Pending() == 0);
+
+	// The data rate is lowered behind the library's back (as ADR would): the uplink that no longer fits is dropped
+	LoRamDot l_other(l_simulator);
+
+	CHECK(l_mDot.TXDataRate("DR3"));
+	CHECK(l_scheduler.Queue(l_record, 20));
+	CHECK(l_scheduler.Queue(l_record, 3));
+	CHECK(l_other.TXDataRate("DR0"));
+	CHECK(PollScheduler(l_scheduler) == SCHEDULER_DROPPED);
+	CHECK(l_mDot.CurrentDataRate() == 0);
+	CHECK(PollScheduler(l_scheduler) == SCHEDULER_SENT);
+	CHECK(l_scheduler.Pending() == 0);
+
+	// Repeated failures drop the uplink after setMaximumFailures()
+	LoRamDotSimulator l_failing;
+	LoRamDot l_failingDot(l_failing);
+	LoRamDotScheduler l_failingScheduler(l_failingDot);
+
+	l_failingDot.setTimeout(500);
+	l_failingScheduler.setBackoff(1, 1);
+	l_failingScheduler.setMaximumFailures(2);
+	CHECK(l_failingScheduler.Queue(l_record, 5));
+	CHECK(PollScheduler(l_failingScheduler) == SCHEDULER_FAILED);
+	CHECK(PollScheduler(l_failingScheduler) == SCHEDULER_DROPPED);
+	CHECK(l_failingScheduler.Pending() == 0);
+
+	// EU868: the mDot's own duty cycle refuses the second uplink and the scheduler waits for its next channel
+	LoRamDotSimulator l_europe(FREQUENCY_BAND_EU);
+	LoRamDot l_europeDot(l_europe);
+	LoRamDotScheduler l_europeScheduler(l_europeDot);
+
+	l_europeDot.setFrequencyBand(FREQUENCY_BAND_EU);
+	l_europeDot.setTimeout(500);
+	CHECK(l_europeDot.Join());
+	CHECK(l_europeDot.TXDataRate("DR5"));
+	l_europeScheduler.setSubBands(1, DUTY_CYCLE_NONE);
+	CHECK(l_europeScheduler.Queue(l_record, 5));
+	CHECK(l_europeScheduler.Queue(l_record, 5));
+	CHECK(l_europeScheduler.Poll() == SCHEDULER_SENT);
+	CHECK(PollScheduler(l_europeScheduler) == SCHEDULER_FAILED);
+	CHECK(l_europeScheduler.NextTransmit() > 0);
+	CHECK(l_europeScheduler.Pending() == 1);
+
+	// More one byte uplinks than a byte can count are all queued and sent (at DR4 on four sub-bands, so the airtime
+	// charged to the channels stays short)
+	LoRamDotScheduler l_short(l_mDot);
+	unsigned int l_queued = 0;
+	unsigned int l_sent = 0;
+
+	CHECK(l_mDot.TXDataRate("DR4"));
+	l_short.setSubBands(LORAMDOT_SCHEDULER_SUB_BANDS, DUTY_CYCLE_NONE);
+	while (l_short.Queue(l_record, 1))
+		l_queued++;
+	CHECK(l_queued == LORAMDOT_SCHEDULER_QUEUE_SIZE / 2);
+	CHECK(l_short.Pending() == l_queued);
+
+	while (l_sent <= l_queued && PollScheduler(l_short) == SCHEDULER_SENT)
+		l_sent++;
+	CHECK(l_sent == l_queued);
+	CHECK(l_short.Pending() == 0);
+	CHECK(l_short.Poll() == SCHEDULER_IDLE);
+}
+
+// The local airtime model matches the datasheet formula and the mDot's AT+TOA.
+static void TestAirtime()
+{
+	// Evaluated at compile time: SF7/125kHz and SF12/125kHz (low data rate optimisation) with a 23 byte PHY payload
+	static_assert(LoRaWANTimeOnAir(FREQUENCY_BAND_EU, 5, 10) == 62, "EU868 DR5 airtime");
+	static_assert(LoRaWANTimeOnAir(FREQUENCY_BAND_EU, 0, 10) == 1483, "EU868 DR0 airtime");
+
+	CHECK(LoRaWANTimeOnAir(FREQUENCY_BAND_US_AU, 0, 11) > LoRaWANTimeOnAir(FREQUENCY_BAND_US_AU, 3, 11));
+	CHECK(LoRaWANTimeOnAir(FREQUENCY_BAND_US_AU, 4, 0) < LoRaWANTimeOnAir(FREQUENCY_BAND_US_AU, 4, 100));
+
+	// TimeOnAir() sends AT+TOA; EstimateTimeOnAir() only asks the mDot while the data rate is unknown
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+	unsigned long l_commands;
+
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.TimeOnAir(10) == LoRaWANTimeOnAir(FREQUENCY_BAND_US_AU, 0, 10));
+	CHECK(strncmp(l_simulator.LastCommand(), "AT+TOA=10", 9) == 0);
+
+	l_commands = l_simulator.Commands();
+	CHECK(l_mDot.EstimateTimeOnAir(10) == LoRaWANTimeOnAir(FREQUENCY_BAND_US_AU, 0, 10));
+	CHECK(l_simulator.Commands() == l_commands + 1);
+
+	CHECK(l_mDot.TXDataRate("DR3"));
+	l_commands = l_simulator.Commands();
+	CHECK(l_mDot.EstimateTimeOnAir(50) == l_mDot.TimeOnAir(50));
+	CHECK(l_simulator.Commands() == l_commands + 1);
+}
+
+// RSSI and SNR readings are parsed from the mDot's output and summarised by a link window.
+static void TestLinkQuality()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+	LoRamDotSignal l_rssi;
+	LoRamDotSignal l_snr;
+	const uint8_t l_downlink[] = { 1 };
+	const uint8_t l_uplink[] = { 1 };
+
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.Join());
+
+	// Two downlinks: the last, minimum, maximum and average follow them
+	l_simulator.setSignal(-100, -55);
+	CHECK(l_simulator.QueueDownlink(l_downlink, sizeof(l_downlink)));
+	CHECK(l_mDot.SendBinary(l_uplink, sizeof(l_uplink)));
+	l_simulator.setSignal(-80, 75);
+	CHECK(l_simulator.QueueDownlink(l_downlink, sizeof(l_downlink)));
+	CHECK(l_mDot.SendBinary(l_uplink, sizeof(l_uplink)));
+
+	CHECK(l_mDot.ReadSignalStrength(l_rssi));
+	CHECK(l_rssi.last == -80 && l_rssi.minimum == -100 && l_rssi.maximum == -80 && l_rssi.average == -90);
+	CHECK(l_mDot.ReadSignalToNoiseRatio(l_snr));
+	CHECK(l_snr.last == 75 && l_snr.minimum == -55 && l_snr.maximum == 75 && l_snr.average == 10);
+
+	// A window holds the newest samples only; a rising signal has a positive trend
+	LoRamDotLinkWindow l_window;
+
+	CHECK(l_window.Count() == 0 && l_window.Mean() == 0);
+	l_window.Add(l_rssi);
+	CHECK(l_window.Count() == 1 && l_window.Last() == -80);
+
+	l_window.Clear();
+	for (int i = 0; i < LORAMDOT_LINK_WINDOW_SIZE + 10; i++)
+		l_window.Add((int16_t)(-120 + i));
+	CHECK(l_window.Count() == LORAMDOT_LINK_WINDOW_SIZE);
+	CHECK(l_window.Last() == -120 + LORAMDOT_LINK_WINDOW_SIZE + 9);
+	CHECK(abs(l_window.Mean() - (-120 + 10 + LORAMDOT_LINK_WINDOW_SIZE / 2)) <= 1);
+	CHECK(l_window.Trend() > 0.99f && l_window.Trend() < 1.01f);
+	CHECK(l_window.Percentile(0) <= -110 && l_window.Percentile(100) >= l_window.Last() - LINK_WINDOW_RSSI_WIDTH);
+}
+
+typedef LoRamDotPayload<
+	LoRamDotField<10, 10, 1, -40>,						// Temperature -40.0 to 62.3 C in 0.1 C
+	LoRamDotField<7>,									// Humidity 0 to 100 %
+	LoRamDotField<1>> Reading;							// Door open
+
+// Payload records round trip, values are clamped to their fields and the padding bits are cleared.
+static void TestPayload()
+{
+	uint8_t l_buffer[3 * Reading::BYTES];
+	float l_temperature;
+	float l_humidity;
+	int l_door;
+
+	CHECK(Reading::BYTES == 3);
+
+	// The padding bits are zero even in a buffer that was not cleared
+	memset(l_buffer, 0xFF, sizeof(l_buffer));
+	Reading::Encode(l_buffer, 21.5f, 55, 1);
+	CHECK((l_buffer[Reading::BYTES - 1] & 0x3F) == 0);
+	CHECK(Reading::Decode(l_buffer, Reading::BYTES, l_temperature, l_humidity, l_door));
+	CHECK(l_temperature > 21.45f && l_temperature < 21.55f);
+	CHECK(l_humidity == 55 && l_door == 1);
+
+	// Values out of range are clamped to the field
+	Reading::Encode(l_buffer, -100.0f, 200, 0);
+	CHECK(Reading::Decode(l_buffer, Reading::BYTES, l_temperature, l_humidity, l_door));
+	CHECK(l_temperature < -39.95f && l_humidity == 127 && l_door == 0);
+	CHECK(!Reading::Decode(l_buffer, Reading::BYTES - 1, l_temperature, l_humidity, l_door));
+
+	// Records packed back to back
+	memset(l_buffer, 0, sizeof(l_buffer));
+	for (int i = 0; i < 3; i++)
+		Reading::EncodeAt(l_buffer, i, 10.0f * i, 10 * i, i & 1);
+	for (int i = 0; i < 3; i++)
+	{
+		CHECK(Reading::DecodeAt(l_buffer, sizeof(l_buffer), i, l_temperature, l_humidity, l_door));
+		CHECK(l_temperature > 10.0f * i - 0.05f && l_temperature < 10.0f * i + 0.05f);
+		CHECK(l_humidity == 10 * i && l_door == (i & 1));
+	}
+}
+
+// Series round trip with and without run-length encoding, and a full uplink refuses the next sample.
+static void TestSeries()
+{
+	// A series with runs, jumps and the extremes of int32_t, with and without run-length encoding
+	const int32_t l_samples[] = { 100, 101, 102, 103, 104, 104, 104, 90, -5000, 2147483647, -2147483647 - 1, 0, 0, 0 };
+	const size_t l_count = sizeof(l_samples) / sizeof(l_samples[0]);
+
+	for (int runLength = 0; runLength < 2; runLength++)
+	{
+		LoRamDotSeriesEncoder l_encoder(runLength == 1);
+		int32_t l_value;
+		size_t l_read = 0;
+
+		l_encoder.Begin(LORAMDOT_SERIES_BUFFER_SIZE);
+		for (size_t i = 0; i < l_count; i++)
+			CHECK(l_encoder.Add(l_samples[i]));
+		CHECK(l_encoder.Count() == l_count);
+
+		LoRamDotSeriesDecoder l_decoder(l_encoder.Data(), l_encoder.Length(), runLength == 1);
+
+		while (l_decoder.Next(&l_value))
+		{
+			CHECK(l_read < l_count && l_value == l_samples[l_read]);
+			l_read++;
+		}
+		CHECK(l_read == l_count);
+	}
+
+	// An uplink that is full refuses the next sample
+	LoRamDotSeriesEncoder l_small;
+
+	l_small.Begin(11);
+	size_t l_added = 0;
+
+	while (l_added < 100 && l_small.Add((int32_t)(l_added * l_added * 1000)))
+		l_added++;
+	CHECK(l_added < 100 && l_small.Count() == l_added && l_small.Length() <= 11);
+}
+
+static LoRamDot *g_eventDot;							// mDot the event callbacks send commands to
+static byte g_events[EVENT_COUNT];						// Events raised
+static int g_nestedStatusId = -1;						// Status ID of the command sent from the downlink callback
+
+// Counts the event and sends a command, as a sketch might on a downlink.
+static void OnDownlink(byte event, const char *)
+{
+	g_events[event]++;
+	g_eventDot->SendCommand("AT");
+	g_nestedStatusId = g_eventDot->LastCommandStatusId();
+}
+
+// Counts the event.
+static void OnEvent(byte event, const char *)
+{
+	g_events[event]++;
+}
+
+// Event lines are dispatched between and during commands, and a command sent from a callback mid-response is BUSY.
+static void TestEvents()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+
+	g_eventDot = &l_mDot;
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.Join());
+	l_mDot.setEventCallback(EVENT_DOWNLINK, OnDownlink);
+	l_mDot.setEventCallback(EVENT_RESET, OnEvent);
+	l_mDot.setEventCallback(EVENT_UNSOLICITED, OnEvent);
+
+	// Between commands the callback may run a command of its own
+	l_simulator.Inject("RECV\r\n");
+	l_mDot.Poll();
+	CHECK(g_events[EVENT_DOWNLINK] == 1);
+	CHECK(g_nestedStatusId == COMMAND_STATUS_ID_OK);
+
+	// While a response is awaited the nested command is refused and the outer command still completes
+	LoRamDotSignal l_signal;
+
+	l_simulator.setLatency(20);
+	l_simulator.Inject("RECV\r\n", 5);
+	CHECK(l_mDot.ReadSignalStrength(l_signal));
+	CHECK(g_events[EVENT_DOWNLINK] == 2);
+	CHECK(g_nestedStatusId == COMMAND_STATUS_ID_BUSY);
+	CHECK(l_mDot.LastCommandStatusId() == COMMAND_STATUS_ID_OK);
+	l_simulator.setLatency(0);
+
+	// The start up banner and other lines outside a command
+	l_simulator.Restart();
+	l_simulator.Inject("hello\r\n");
+	delay(5);
+	l_mDot.Poll();
+	CHECK(g_events[EVENT_RESET] == 1);
+	CHECK(g_events[EVENT_UNSOLICITED] >= 1);
+}
+
+// Commands are timed by class by default, and setTimeout() goes back to one timeout for every command.
+static void TestTimeouts()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+
+	CHECK(l_mDot.CommandTimeout(TIMEOUT_CLASS_QUICK) == TIMEOUT_QUICK);
+	CHECK(l_mDot.CommandTimeout(TIMEOUT_CLASS_JOIN) > TIMEOUT_QUICK);
+
+	l_mDot.setTimeout(15000);
+	CHECK(l_mDot.CommandTimeout(TIMEOUT_CLASS_QUICK) == 15000);
+	CHECK(l_mDot.CommandTimeout(TIMEOUT_CLASS_JOIN) == 15000);
+
+	l_mDot.setTimeoutProfiles(true);
+	CHECK(l_mDot.CommandTimeout(TIMEOUT_CLASS_QUICK) == TIMEOUT_QUICK);
+}
+
+// SerialSpeed() accepts every SERIAL_SPEED_* rate, which hold rates above 65535 on every board.
+static void TestSerialSpeeds()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+
+	static_assert(SERIAL_SPEED_921600 == 921600UL, "SERIAL_SPEED_* must not truncate");
+
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.SerialSpeed(SERIAL_SPEED_230400));
+	CHECK(strcmp(l_simulator.Setting("IPR"), "230400") == 0);
+	CHECK(l_mDot.SerialSpeed(SERIAL_SPEED_230500));
+	CHECK(!l_mDot.SerialSpeed(230500));
+	CHECK(l_mDot.LastCommandStatusId() == COMMAND_STATUS_INPUT_OUT_OF_RANGE);
+	CHECK(l_mDot.DebugSerialSpeed(SERIAL_SPEED_921600));
+	CHECK(!l_mDot.DebugSerialSpeed(SERIAL_SPEED_1200));
+}
+
+// The joiner waits out the join duty cycle after a failure, steps to the next data rate and restores the data rate
+// in effect before it started once joined.
+static void TestJoiner()
+{
+	LoRamDotSimulator l_simulator(FREQUENCY_BAND_US_AU);
+	LoRamDot l_mDot(l_simulator);
+	LoRamDotJoiner l_joiner(l_mDot);
+	byte l_state;
+
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.TXDataRate("DR2"));
+	l_simulator.setJoinFailures(1);
+	l_joiner.setStartSpread(0);
+	l_joiner.setBackoff(1, 1);
+	l_joiner.setDataRates(4, 3);
+	l_joiner.setAttemptsPerStep(1);
+	CHECK(l_joiner.Start());
+	CHECK(l_joiner.DataRate() == 4);
+
+	while ((l_state = l_joiner.Poll()) == JOINER_JOINING || (l_state == JOINER_WAITING && l_joiner.Attempts() == 0))
+		delay(1);
+
+	// The first request failed at DR4: the next one waits for the 1% join duty cycle, far beyond the 1 ms back off
+	CHECK(l_state == JOINER_WAITING);
+	CHECK(l_joiner.Attempts() == 1);
+	CHECK(l_joiner.DataRate() == 3);
+	CHECK(l_joiner.NextAttempt() > 1000);
+
+	while ((l_state = l_joiner.Poll()) != JOINER_JOINED && l_state != JOINER_FAILED)
+		delay(1);
+
+	CHECK(l_state == JOINER_JOINED);
+	CHECK(l_joiner.Attempts() == 2);
+	CHECK(l_joiner.DataRate() == 3);
+	CHECK(l_simulator.Joined());
+	CHECK(strcmp(l_simulator.Setting("TXDR"), "DR2") == 0);
+	CHECK(l_mDot.CurrentDataRate() == 2);
+
+	// Giving up after the maximum attempts
+	LoRamDotSimulator l_europe(FREQUENCY_BAND_EU);
+	LoRamDot l_europeDot(l_europe);
+	LoRamDotJoiner l_europeJoiner(l_europeDot);
+
+	l_europeDot.setTimeout(500);
+	l_europe.setJoinFailures(10);
+	l_europeJoiner.setStartSpread(0);
+	l_europeJoiner.setBackoff(1, 1);
+	l_europeJoiner.setDataRates(5, 5);
+	l_europeJoiner.setMaximumAttempts(2);
+	CHECK(l_europeJoiner.Start());
+
+	while ((l_state = l_europeJoiner.Poll()) != JOINER_JOINED && l_state != JOINER_FAILED)
+		delay(1);
+
+	CHECK(l_state == JOINER_FAILED);
+	CHECK(l_europeJoiner.Attempts() == 2);
+	CHECK(!l_europe.Joined());
+}
+
+static LoRamDotSimulator *g_dataModeSimulator;			// Simulated mDot whose CTS line the data writer reads
+
+// Reads the simulated CTS line.
+static boolean SimulatorClearToSend()
+{
+	return g_dataModeSimulator->ClearToSend();
+}
+
+// Never allows data, as a CTS line held deasserted.
+static boolean NeverClearToSend()
+{
+	return false;
+}
+
+// The data writer refuses serial data mode with ADR on, streams packets while CTS allows and bounds End() when CTS
+// stays deasserted.
+static void TestDataWriter()
+{
+	LoRamDotSimulator l_simulator;
+	LoRamDot l_mDot(l_simulator);
+	LoRamDotDataWriter l_writer(l_mDot);
+	uint8_t l_data[100];
+
+	g_dataModeSimulator = &l_simulator;
+	l_mDot.setTimeout(500);
+	CHECK(l_mDot.Join());
+	CHECK(l_mDot.TXDataRate("DR3"));
+	CHECK(l_mDot.WakeMode(1));
+
+	CHECK(l_mDot.AdaptiveDataRate(true));
+	CHECK(!l_writer.Begin());
+	CHECK(!l_simulator.DataMode());
+	CHECK(l_mDot.AdaptiveDataRate(false));
+
+	// One packet is written, sent and followed by the escape back to AT command mode
+	for (size_t i = 0; i < sizeof(l_data); i++)
+		l_data[i] = (uint8_t)i;
+
+	unsigned long l_uplinks = l_simulator.Uplinks();
+
+	l_writer.setClearToSend(SimulatorClearToSend);
+	CHECK(l_writer.Begin());
+	CHECK(l_simulator.DataMode());
+	CHECK(l_writer.PacketSize() == 242);
+	CHECK(l_writer.write(l_data, sizeof(l_data)) == sizeof(l_data));
+	CHECK(l_writer.End());
+	CHECK(!l_simulator.DataMode());
+	CHECK(l_writer.Packets() == 1);
+	CHECK(l_simulator.DataBytes() == sizeof(l_data));
+	CHECK(l_simulator.Uplinks() == l_uplinks + 1);
+	CHECK(l_mDot.SendCommand("AT"));
+
+	// CTS held deasserted: End() drops the data after a wake cycle, still escapes and returns false
+	l_writer.setClearToSend(NeverClearToSend);
+	CHECK(l_writer.Begin());
+	CHECK(l_writer.print("hello") == 5);
+	CHECK(!l_writer.End());
+	CHECK(l_writer.Pending() == 0);
+	CHECK(!l_simulator.DataMode());
+	CHECK(l_mDot.SendCommand("AT"));
+}
+
+static unsigned int g_managerCompleted;					// Commands reported to the manager callback
+
+// Counts the commands the manager completes.
+static void OnManagerComplete(byte, int, const char *)
+{
+	g_managerCompleted++;
+}
+
+// The manager runs queued commands on several modules, counts them and completes a command queued behind one the
+// application started itself.
+static void TestManager()
+{
+	LoRamDotSimulator l_simulators[3];
+	LoRamDot l_first(l_simulators[0]);
+	LoRamDot l_second(l_simulators[1]);
+	LoRamDot l_third(l_simulators[2]);
+	LoRamDotManager l_manager;
+
+	CHECK(l_manager.Add(l_first) == 0);
+	CHECK(l_manager.Add(l_second) == 1);
+	CHECK(l_manager.Add(l_third) == 2);
+	CHECK(l_manager.Count() == 3);
+	l_manager.setCallback(OnManagerComplete);
+	g_managerCompleted = 0;
+
+	l_manager.ResetStatistics();
+	CHECK(l_manager.QueueAll("AT"));
+	CHECK(l_manager.QueueAll("ATI"));
+	CHECK(l_manager.Queue(1, "AT+BOGUS"));
+	CHECK(l_manager.Pending() == 7);
+	CHECK(l_manager.Pending(1) == 3);
+	CHECK(l_manager.Run(5000) == 7);
+	CHECK(l_manager.Pending() == 0);
+	CHECK(g_managerCompleted == 7);
+
+	LoRamDotManagerStatistics l_statistics = l_manager.Statistics();
+	CHECK(l_statistics.commands == 7);
+	CHECK(l_statistics.failures == 1);
+	CHECK(l_statistics.bytesWritten > 0);
+	CHECK(l_statistics.bytesRead > 0);
+	CHECK(l_manager.Statistics(1).commands == 3);
+	CHECK(l_manager.Statistics(1).failures == 1);
+	CHECK(l_manager.Statistics(0).failures == 0);
+
+	// A module busy with a command started outside the manager finishes it before the queued one
+	l_simulators[0].setLatency(300);
+	l_first.setTimeout(2000);
+	CHECK(l_first.BeginCommand("AT"));
+	CHECK(l_manager.Queue(0, "AT"));
+	CHECK(l_manager.Run(5000) == 1);
+	CHECK(l_manager.Pending(0) == 0);
+	CHECK(l_manager.Statistics(0).commands == 3);
+	CHECK(l_manager.Statistics(0).failures == 0);
+}
+
+// The serial port runs over a pseudo-terminal: a write/read round trip, available() waiting, rejected rates and a
+// write to a tty that stops accepting data returning instead of blocking.
+static void TestSerialPort()
+{
+	int l_master;
+	int l_slave;
+	LoRamDotSerialPort l_port;
+	char l_text[16];
+
+	CHECK(openpty(&l_master, &l_slave, NULL, NULL, NULL) == 0);
+	CHECK(!l_port.begin(l_slave, 12345));
+	CHECK(l_port.Descriptor() == -1);
+	CHECK(l_port.begin(l_slave, SERIAL_SPEED_115200));
+	CHECK(l_port.Descriptor() == l_slave);
+
+	// Written through the port, read from the other end
+	CHECK(l_port.print("AT\r\n") == 4);
+	CHECK(read(l_master, l_text, sizeof(l_text)) == 4);
+	CHECK(memcmp(l_text, "AT\r\n", 4) == 0);
+
+	// available() waits up to the setWait() time when nothing has arrived
+	l_port.setWait(100);
+	unsigned long l_start = millis();
+	CHECK(l_port.available() == 0);
+	CHECK(millis() - l_start >= 90);
+
+	CHECK(write(l_master, "OK\r\n", 4) == 4);
+	CHECK(l_port.Wait(1000));
+	CHECK(l_port.available() == 4);
+	CHECK(l_port.peek() == 'O');
+	CHECK(l_port.read() == 'O' && l_port.read() == 'K' && l_port.read() == '\r' && l_port.read() == '\n');
+	CHECK(l_port.available() == 0);
+
+	CHECK(!l_port.setBaudRate(12345));
+	CHECK(l_port.setBaudRate(SERIAL_SPEED_230400));
+	CHECK(l_port.setBaudRate(SERIAL_SPEED_9600));
+
+	// Nothing reads the other end, so the tty's output queue fills and write() gives up after the timeout
+	static uint8_t l_block[1 << 20];
+
+	l_port.setWriteTimeout(100);
+	l_start = millis();
+	CHECK(l_port.write(l_block, sizeof(l_block)) < sizeof(l_block));
+	CHECK(millis() - l_start < 2000);
+
+	l_port.end();
+	CHECK(l_port.Descriptor() == -1);
+	close(l_slave);
+	close(l_master);
+}
+
+int main()
+{
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	TestResponseBuffer();
+	TestFailureTerminators();
+	TestReceiveOnce();
+	TestAggregator();
+	TestScheduler();
+	TestAirtime();
+	TestLinkQuality();
+	TestPayload();
+	TestSeries();
+	TestEvents();
+	TestTimeouts();
+	TestSerialSpeeds();
+	TestJoiner();
+	TestDataWriter();
+	TestManager();
+	TestSerialPort();
+
+	printf("%u checks, %u failed\n", g_checks, g_failures);
+
+	return (g_failures > 255) ? 255 : (int)g_failures;
+}